@@ -60,7 +60,6 @@ static device_config_t g_device_config;
 #define GPS_ENABLED true  // Enabled - no SD card conflict
 
 static QueueHandle_t xQueueAIFrame = NULL;
-static QueueHandle_t xQueueHttpFrame = NULL;
 
 // NTP time synchronization - replaces hardcoded time
 #include "esp_sntp.h"
@@ -293,9 +292,8 @@ extern "C" void app_main()
 
     // Create queues (reduced size for memory optimization)
     xQueueAIFrame = xQueueCreate(2, sizeof(camera_fb_t *));
-    xQueueHttpFrame = xQueueCreate(2, sizeof(camera_fb_t *));
     
-    if (!xQueueAIFrame || !xQueueHttpFrame) {
+    if (!xQueueAIFrame) {
         ESP_LOGE(TAG, "Queue creation failed");
         return;
     }
@@ -383,8 +381,8 @@ extern "C" void app_main()
         ESP_LOGE(TAG, "Power management failed: %s", esp_err_to_name(power_ret));
     }
 
-    // Register camera (3 buffers for stable frame capture)
-    register_camera(PIXFORMAT_RGB565, FRAMESIZE_QVGA, 3, xQueueAIFrame);
+    // Register camera (frames are shared between detector and /capture)
+    register_camera(WHO_CAMERA_PIXFORMAT, FRAMESIZE_QVGA, CONFIG_CAMERA_FB_COUNT, xQueueAIFrame);
     ESP_LOGI(TAG, "Camera OK");
 
     if (!power_mgmt_is_trip_time()) {
@@ -411,7 +409,7 @@ extern "C" void app_main()
     ESP_LOGI(TAG, "📊 Free heap before face recognition: %d bytes", free_before);
     
     // Face recognition ENABLED
-    register_human_face_recognition(xQueueAIFrame, NULL, NULL, xQueueHttpFrame, true);
+    register_human_face_recognition(xQueueAIFrame, NULL, NULL, NULL, true);
     ESP_LOGI(TAG, "✅ Face recognition ENABLED");
     
     // Log memory after
@@ -421,7 +419,7 @@ extern "C" void app_main()
     // Register HTTP server (optimized for low memory)
     // Check if we have enough memory for HTTP server
     if (free_after > 50000) {  // Need at least 50KB free
-        register_httpd(xQueueHttpFrame, NULL, true);
+        register_httpd(NULL, NULL, true);
         ESP_LOGI(TAG, "HTTP server OK");
     } else {
         ESP_LOGW(TAG, "⚠️ Insufficient memory for HTTP server (%d bytes free)", free_after);
@@ -432,7 +430,7 @@ extern "C" void app_main()
     ESP_LOGI(TAG, "");
     ESP_LOGI(TAG, "═══════════════════════════════════════════════════════");
     ESP_LOGI(TAG, "  🎥 FACE DETECTION SYSTEM READY");
-    ESP_LOGI(TAG, "  📷 Camera: QVGA (320x240), 3 buffers");
+    ESP_LOGI(TAG, "  📷 Camera: QVGA (320x240), %d buffers", CONFIG_CAMERA_FB_COUNT);
     ESP_LOGI(TAG, "  🧠 Detection: MSR01 + MNP01 (relaxed thresholds)");
     ESP_LOGI(TAG, "  📊 Free heap: %d bytes", esp_get_free_heap_size());
     // Start monitoring tasks
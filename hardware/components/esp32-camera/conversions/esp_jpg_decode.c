@@ -14,19 +14,9 @@
 #include "esp_jpg_decode.h"
 
 #include "esp_system.h"
-#if ESP_IDF_VERSION_MAJOR >= 4 // IDF 4+
-#if CONFIG_IDF_TARGET_ESP32 // ESP32/PICO-D4
-#include "esp32/rom/tjpgd.h"
-#elif CONFIG_IDF_TARGET_ESP32S2
+// The component's own copy on every target, not the ROM one: only it can
+// skip the MCUs outside esp_jpg_decode_rect()'s rectangle.
 #include "tjpgd.h"
-#elif CONFIG_IDF_TARGET_ESP32S3
-#include "esp32s3/rom/tjpgd.h"
-#else
-#error Target CONFIG_IDF_TARGET is not supported
-#endif
-#else // ESP32 Before IDF 4.0
-#include "rom/tjpgd.h"
-#endif
 
 #if defined(ARDUINO_ARCH_ESP32) && defined(CONFIG_ARDUHAL_ESP_LOG)
 #include "esp32-hal-log.h"
@@ -82,16 +72,19 @@ static uint32_t _jpg_read(JDEC *decoder, uint8_t *buf, uint32_t len)
     if (len) {
         len = jpeg->reader(jpeg->arg, jpeg->index, buf, len);
         if (!len) {
-            ESP_LOGE(TAG, "Read Fail at %u/%u", jpeg->index, jpeg->len);
+            ESP_LOGE(TAG, "Read Fail at %u/%u", (unsigned)jpeg->index, (unsigned)jpeg->len);
         }
         jpeg->index += len;
     }
     return len;
 }
 
-esp_err_t esp_jpg_decode(size_t len, jpg_scale_t scale, jpg_reader_cb reader, jpg_writer_cb writer, void * arg)
+// 3100 bytes with 32-bit LONGs and pointers, tjpgd's tables grow on 64-bit hosts.
+#define JPG_WORK_SIZE (3100 * sizeof(long) / 4)
+
+static esp_err_t jpg_decode(size_t len, jpg_scale_t scale, const JRECT *rect, jpg_reader_cb reader, jpg_writer_cb writer, void * arg)
 {
-    static uint8_t work[3100];
+    static uint8_t work[JPG_WORK_SIZE];
     JDEC decoder;
     esp_jpg_decoder_t jpeg;
 
@@ -102,7 +95,7 @@ esp_err_t esp_jpg_decode(size_t len, jpg_scale_t scale, jpg_reader_cb reader, jp
     jpeg.scale = scale;
     jpeg.index = 0;
 
-    JRESULT jres = jd_prepare(&decoder, _jpg_read, work, 3100, &jpeg);
+    JRESULT jres = jd_prepare(&decoder, _jpg_read, work, JPG_WORK_SIZE, &jpeg);
     if(jres != JDR_OK){
         ESP_LOGE(TAG, "JPG Header Parse Failed! %s", jd_errors[jres]);
         return ESP_FAIL;
@@ -114,7 +107,18 @@ esp_err_t esp_jpg_decode(size_t len, jpg_scale_t scale, jpg_reader_cb reader, jp
     //output start
     writer(arg, 0, 0, output_width, output_height, NULL);
     //output write
-    jres = jd_decomp(&decoder, _jpg_write, (uint8_t)jpeg.scale);
+    if (rect) {
+        JRECT r = *rect;
+        if (r.right >= decoder.width) {
+            r.right = decoder.width - 1;
+        }
+        if (r.bottom >= decoder.height) {
+            r.bottom = decoder.height - 1;
+        }
+        jres = jd_decomp_rect(&decoder, _jpg_write, (uint8_t)jpeg.scale, &r);
+    } else {
+        jres = jd_decomp(&decoder, _jpg_write, (uint8_t)jpeg.scale);
+    }
     //output end
     writer(arg, output_width, output_height, output_width, output_height, NULL);
 
@@ -130,3 +134,16 @@ esp_err_t esp_jpg_decode(size_t len, jpg_scale_t scale, jpg_reader_cb reader, jp
     return ESP_OK;
 }
 
+esp_err_t esp_jpg_decode(size_t len, jpg_scale_t scale, jpg_reader_cb reader, jpg_writer_cb writer, void * arg)
+{
+    return jpg_decode(len, scale, NULL, reader, writer, arg);
+}
+
+esp_err_t esp_jpg_decode_rect(size_t len, jpg_scale_t scale, uint16_t x, uint16_t y, uint16_t w, uint16_t h, jpg_reader_cb reader, jpg_writer_cb writer, void * arg)
+{
+    if (!w || !h) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    JRECT rect = { .left = x, .right = x + w - 1, .top = y, .bottom = y + h - 1 };
+    return jpg_decode(len, scale, &rect, reader, writer, arg);
+}
@@ -36,6 +36,21 @@ typedef bool (* jpg_writer_cb)(void * arg, uint16_t x, uint16_t y, uint16_t w, u
 
 esp_err_t esp_jpg_decode(size_t len, jpg_scale_t scale, jpg_reader_cb reader, jpg_writer_cb writer, void * arg);
 
+/**
+ * @brief Like esp_jpg_decode(), but only the MCUs intersecting a rectangle
+ *        are transformed and passed to the writer, and decoding stops after
+ *        the last MCU row of the rectangle. The writer still gets the full
+ *        scaled image size at start and scaled image coordinates, and has to
+ *        clip the MCU blocks to the rectangle itself.
+ *
+ * @param x, y, w, h  rectangle in unscaled pixels, clipped to the image
+ *
+ * @return ESP_OK, ESP_ERR_INVALID_ARG for an empty rectangle,
+ *         ESP_FAIL when the data cannot be decoded or the rectangle is
+ *         outside the image
+ */
+esp_err_t esp_jpg_decode_rect(size_t len, jpg_scale_t scale, uint16_t x, uint16_t y, uint16_t w, uint16_t h, jpg_reader_cb reader, jpg_writer_cb writer, void * arg);
+
 #ifdef __cplusplus
 }
 #endif
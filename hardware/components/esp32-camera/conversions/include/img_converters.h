@@ -123,6 +123,27 @@ bool fmt2rgb888(const uint8_t *src_buf, size_t src_len, pixformat_t format, uint
 
 bool jpg2rgb565(const uint8_t *src, size_t src_len, uint8_t * out, jpg_scale_t scale);
 
+/**
+ * @brief Decode a rectangle of a JPEG image, scaled, into an RGB565 or RGB888
+ *        buffer. Only the MCUs intersecting the rectangle are transformed and
+ *        the rest of the image after its last MCU row is not decoded at all,
+ *        e.g. for a 1/4 detector input plus a full resolution face crop.
+ *
+ * @param src       Source buffer in JPEG format
+ * @param src_len   Length in bytes of the source buffer
+ * @param x         Left of the rectangle, in unscaled pixels
+ * @param y         Top of the rectangle, in unscaled pixels
+ * @param w         Width of the rectangle, in unscaled pixels
+ * @param h         Height of the rectangle, in unscaled pixels
+ * @param scale     Output scale, the rectangle is divided by 1 << scale
+ * @param format    PIXFORMAT_RGB565 (camera byte order) or PIXFORMAT_RGB888
+ *                  (B G R bytes, like fmt2rgb888() and esp-dl images)
+ * @param out       Output buffer, (w >> scale) * (h >> scale) pixels, row by row
+ *
+ * @return true on success, false when the rectangle is not inside the image
+ */
+bool jpg2rgb_rect(const uint8_t *src, size_t src_len, uint16_t x, uint16_t y, uint16_t w, uint16_t h, jpg_scale_t scale, pixformat_t format, uint8_t * out);
+
 #ifdef __cplusplus
 }
 #endif
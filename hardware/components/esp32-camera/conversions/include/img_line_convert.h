@@ -0,0 +1,76 @@
+#ifndef _IMG_LINE_CONVERT_H_
+#define _IMG_LINE_CONVERT_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Pixel run converters shared by to_jpg, to_bmp and the face pipeline.
+ *
+ * Byte orders in memory:
+ *  - rgb565: camera order, RRRRRGGG GGGBBBBB (high byte first)
+ *  - rgb888: R G B, what the JPEG encoder takes and the decoder produces
+ *  - bgr888: B G R, PIXFORMAT_RGB888 frames, BMP pixels and esp-dl images
+ *  - yuv422: Y0 U Y1 V, colors as yuv2rgb() computes them
+ *
+ * RGB565 runs are converted one pixel at a time. line_rgb888_to_rgb565()
+ * stores two pixels per 32-bit word when the destination is word aligned,
+ * the YUV422 converters load a pixel pair per word when the source is.
+ * Source and destination must not overlap. YUV422 runs must have an even
+ * pixel count.
+ */
+
+/**
+ * @brief RGB565 to R G B bytes.
+ *
+ * @param src    n pixels of RGB565
+ * @param dst    3 * n bytes
+ * @param n      pixel count
+ */
+void line_rgb565_to_rgb888(const uint8_t *src, uint8_t *dst, size_t n);
+
+/**
+ * @brief RGB565 to B G R bytes.
+ */
+void line_rgb565_to_bgr888(const uint8_t *src, uint8_t *dst, size_t n);
+
+/**
+ * @brief R G B bytes to RGB565, dropping the low bits of each channel.
+ */
+void line_rgb888_to_rgb565(const uint8_t *src, uint8_t *dst, size_t n);
+
+/**
+ * @brief RGB565 to gray, (38 R + 75 G + 15 B) >> 7 like
+ *        dl::image::convert_pixel_rgb565_to_gray().
+ */
+void line_rgb565_to_gray(const uint8_t *src, uint8_t *dst, size_t n);
+
+/**
+ * @brief YUV422 to R G B bytes.
+ */
+void line_yuv422_to_rgb888(const uint8_t *src, uint8_t *dst, size_t n);
+
+/**
+ * @brief YUV422 to B G R bytes.
+ */
+void line_yuv422_to_bgr888(const uint8_t *src, uint8_t *dst, size_t n);
+
+/**
+ * @brief YUV422 to RGB565.
+ */
+void line_yuv422_to_rgb565(const uint8_t *src, uint8_t *dst, size_t n);
+
+/**
+ * @brief YUV422 to its Y plane.
+ */
+void line_yuv422_to_y(const uint8_t *src, uint8_t *dst, size_t n);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _IMG_LINE_CONVERT_H_ */
@@ -67,6 +67,14 @@ namespace jpge {
 
     static int32 m_last_quality = 0;
     static int32 m_quantization_tables[2][64];
+    // j / q as (j * recip) >> shift, exact for 0 <= j < 32768. Cached with the tables.
+    static uint32 m_quantization_recip[2][64];
+    static uint8 m_quantization_shift[2][64];
+
+    // Sensor YUV is BT.601 video range (Y 16-235, Cb/Cr 16-240), JFIF is full range.
+    static bool m_yuv_initialized = false;
+    static uint8 m_yuv_luma[256];
+    static uint8 m_yuv_chroma[256];
 
     static bool m_huff_initialized = false;
     static uint m_huff_codes[4][256];
@@ -106,7 +114,21 @@ namespace jpge {
         }
     }
 
-    // Forward DCT - DCT derived from jfdctint.
+    static void init_yuv_tables() {
+        for (int i = 0; i < 256; i++) {
+            m_yuv_luma[i] = clamp(((i - 16) * 76309 + 32768) >> 16);          // 255 / 219
+            m_yuv_chroma[i] = clamp(128 + (((i - 128) * 74606 + 32768) >> 16)); // 255 / 224
+        }
+    }
+
+    static inline uint bit_count(uint i) {
+        return i ? 32 - __builtin_clz(i) : 0;
+    }
+
+    // Forward DCT - DCT derived from jfdctint. Integer only, 12 16x16-bit
+    // multiplies per row or column and no divides, about an eighth of the
+    // encode time. A jfdctfst (AAN) DCT would save half the multiplies but
+    // lose precision and change every encoded frame, so it is kept as is.
     enum { CONST_BITS = 13, ROW_BITS = 2 };
 #define DCT_DESCALE(x, n) (((x) + (((int32)1) << ((n) - 1))) >> (n))
 #define DCT_MUL(var, c) (static_cast<int16>(var) * static_cast<int32>(c))
@@ -376,28 +398,78 @@ namespace jpge {
         }
     }
 
-    void jpeg_encoder::load_quantized_coefficients(int component_num)
+    // RGB565 channels top out at 248 (R, B) and 252 (G): Y, Cb and Cr stay in 0-255 unclamped.
+    static inline void rgb565_to_YCC(const uint8 *pSrc, int32 &y, int32 &cb, int32 &cr)
     {
-        int32 *q = m_quantization_tables[component_num > 0];
-        int16 *pDst = m_coefficient_array;
-        for (int i = 0; i < 64; i++)
+        const int r = pSrc[0] & 0xF8, g = ((pSrc[0] & 0x07) << 5) | ((pSrc[1] & 0xE0) >> 3), b = (pSrc[1] & 0x1F) << 3;
+        y = (r * YR + g * YG + b * YB + 32768) >> 16;
+        cb += 128 + ((r * CB_R + g * CB_G + b * CB_B + 32768) >> 16);
+        cr += 128 + ((r * CR_R + g * CR_G + b * CR_B + 32768) >> 16);
+    }
+
+    // One 16x16 MCU, the same samples RGB_to_YCC() and load_block_8_8() / load_block_16_8()
+    // produce from RGB888 scanlines. pRows: the 16 source rows, pCols: byte offsets of the
+    // 16 columns, both repeating the last row / column past the image edge.
+    void jpeg_encoder::load_mcu_rgb565(const uint8 *const *pRows, const int *pCols)
+    {
+        sample_array_t *pCb = m_mcu_blocks + 4 * 64, *pCr = m_mcu_blocks + 5 * 64;
+        for (int i = 0; i < 16; i += 2)
         {
-            sample_array_t j = m_sample_array[s_zag[i]];
-            if (j < 0)
+            const uint8 *pSrc1 = pRows[i + 0], *pSrc2 = pRows[i + 1];
+            sample_array_t *pY = m_mcu_blocks + (i >> 3) * 128 + (i & 7) * 8;
+            for (int j = 0; j < 16; j += 2)
             {
-                if ((j = -j + (*q >> 1)) < *q)
-                    *pDst++ = 0;
-                else
-                    *pDst++ = static_cast<int16>(-(j / *q));
+                sample_array_t *pDst = pY + (j >> 3) * 64 + (j & 7);
+                int32 y, cb = 0, cr = 0;
+                rgb565_to_YCC(pSrc1 + pCols[j + 0], y, cb, cr); pDst[0] = y - 128;
+                rgb565_to_YCC(pSrc1 + pCols[j + 1], y, cb, cr); pDst[1] = y - 128;
+                rgb565_to_YCC(pSrc2 + pCols[j + 0], y, cb, cr); pDst[8] = y - 128;
+                rgb565_to_YCC(pSrc2 + pCols[j + 1], y, cb, cr); pDst[9] = y - 128;
+                // Rounding alternates between 0 and 2 like load_block_16_8().
+                const int c = (i >> 1) * 8 + (j >> 1), bias = ((i ^ j) & 2);
+                pCb[c] = ((cb + bias) >> 2) - 128;
+                pCr[c] = ((cr + bias) >> 2) - 128;
             }
-            else
+        }
+    }
+
+    // One 16x16 MCU straight from YUV422: Y is kept, U and V are averaged over row pairs.
+    // No trip through RGB, so no clamping of out of gamut colors either.
+    void jpeg_encoder::load_mcu_yuv422(const uint8 *const *pRows, const int *pCols)
+    {
+        sample_array_t *pCb = m_mcu_blocks + 4 * 64, *pCr = m_mcu_blocks + 5 * 64;
+        for (int i = 0; i < 16; i += 2)
+        {
+            const uint8 *pSrc1 = pRows[i + 0], *pSrc2 = pRows[i + 1];
+            sample_array_t *pY = m_mcu_blocks + (i >> 3) * 128 + (i & 7) * 8;
+            for (int j = 0; j < 16; j += 2)
             {
-                if ((j = j + (*q >> 1)) < *q)
-                    *pDst++ = 0;
-                else
-                    *pDst++ = static_cast<int16>((j / *q));
+                sample_array_t *pDst = pY + (j >> 3) * 64 + (j & 7);
+                pDst[0] = m_yuv_luma[pSrc1[pCols[j + 0]]] - 128;
+                pDst[1] = m_yuv_luma[pSrc1[pCols[j + 1]]] - 128;
+                pDst[8] = m_yuv_luma[pSrc2[pCols[j + 0]]] - 128;
+                pDst[9] = m_yuv_luma[pSrc2[pCols[j + 1]]] - 128;
+                // The pair holding column j: Y0 U Y1 V, 4 byte aligned.
+                const int p = pCols[j] & ~3, c = (i >> 1) * 8 + (j >> 1), bias = ((i ^ j) >> 1) & 1;
+                pCb[c] = m_yuv_chroma[(pSrc1[p + 1] + pSrc2[p + 1] + bias) >> 1] - 128;
+                pCr[c] = m_yuv_chroma[(pSrc1[p + 3] + pSrc2[p + 3] + bias) >> 1] - 128;
             }
-            q++;
+        }
+    }
+
+    void jpeg_encoder::load_quantized_coefficients(int component_num, const sample_array_t *pSamples)
+    {
+        const int32 *q = m_quantization_tables[component_num > 0];
+        const uint32 *recip = m_quantization_recip[component_num > 0];
+        const uint8 *shift = m_quantization_shift[component_num > 0];
+        int16 *pDst = m_coefficient_array;
+        for (int i = 0; i < 64; i++)
+        {
+            // Rounded division of the magnitude, as (|j| + q / 2) / q.
+            sample_array_t j = pSamples[s_zag[i]];
+            uint32 a = static_cast<uint32>(j < 0 ? -j : j) + (q[i] >> 1);
+            int16 v = static_cast<int16>((a * recip[i]) >> shift[i]);
+            *pDst++ = j < 0 ? -v : v;
         }
     }
 
@@ -427,11 +499,7 @@ namespace jpge {
             temp1 = -temp1; temp2--;
         }
 
-        nbits = 0;
-        while (temp1)
-        {
-            nbits++; temp1 >>= 1;
-        }
+        nbits = bit_count(temp1);
 
         put_bits(codes[0][nbits], code_sizes[0][nbits]);
         if (nbits) put_bits(temp2 & ((1 << nbits) - 1), nbits);
@@ -452,9 +520,7 @@ namespace jpge {
                     temp1 = -temp1;
                     temp2--;
                 }
-                nbits = 1;
-                while (temp1 >>= 1)
-                    nbits++;
+                nbits = bit_count(temp1);
                 j = (run_len << 4) + nbits;
                 put_bits(codes[1][j], code_sizes[1][j]);
                 put_bits(temp2 & ((1 << nbits) - 1), nbits);
@@ -467,8 +533,13 @@ namespace jpge {
 
     void jpeg_encoder::code_block(int component_num)
     {
-        DCT2D(m_sample_array);
-        load_quantized_coefficients(component_num);
+        code_block(component_num, m_sample_array);
+    }
+
+    void jpeg_encoder::code_block(int component_num, sample_array_t *pSamples)
+    {
+        DCT2D(pSamples);
+        load_quantized_coefficients(component_num, pSamples);
         code_coefficients_pass_two(component_num);
     }
 
@@ -560,6 +631,21 @@ namespace jpge {
         }
     }
 
+    // Reciprocals of a quantization table: recip = ceil(2^shift / q) with 2^shift >= 65536 * q
+    // leaves an error below 1 / q for any j < 32768, and j * recip fits 32 bits.
+    static void compute_quant_recip(uint32 *pRecip, uint8 *pShift, const int32 *pQ)
+    {
+        for (int i = 0; i < 64; i++)
+        {
+            const uint32 q = pQ[i];
+            uint shift = 16;
+            while ((1u << (shift - 16)) < q)
+                shift++;
+            pShift[i] = static_cast<uint8>(shift);
+            pRecip[i] = static_cast<uint32>(((1ull << shift) + q - 1) / q);
+        }
+    }
+
     // Higher-level methods.
     bool jpeg_encoder::jpg_open(int p_x_res, int p_y_res, int src_channels)
     {
@@ -607,16 +693,30 @@ namespace jpge {
         m_image_bpl_mcu  = m_image_x_mcu * m_num_components;
         m_mcus_per_row   = m_image_x_mcu / m_mcu_x;
 
-        if ((m_mcu_lines[0] = static_cast<uint8*>(jpge_malloc(m_image_bpl_mcu * m_mcu_y))) == NULL) {
-            return false;
+        if (m_frame_format >= 0) {
+            // process_frame() codes one MCU at a time: 6 blocks instead of 16 converted lines.
+            if ((m_mcu_blocks = static_cast<sample_array_t*>(jpge_malloc(6 * 64 * sizeof(sample_array_t)))) == NULL) {
+                return false;
+            }
+        } else {
+            if ((m_mcu_lines[0] = static_cast<uint8*>(jpge_malloc(m_image_bpl_mcu * m_mcu_y))) == NULL) {
+                return false;
+            }
+            for (int i = 1; i < m_mcu_y; i++)
+                m_mcu_lines[i] = m_mcu_lines[i-1] + m_image_bpl_mcu;
         }
-        for (int i = 1; i < m_mcu_y; i++)
-            m_mcu_lines[i] = m_mcu_lines[i-1] + m_image_bpl_mcu;
 
         if(m_last_quality != m_params.m_quality){
             m_last_quality = m_params.m_quality;
             compute_quant_table(m_quantization_tables[0], s_std_lum_quant);
             compute_quant_table(m_quantization_tables[1], s_std_croma_quant);
+            compute_quant_recip(m_quantization_recip[0], m_quantization_shift[0], m_quantization_tables[0]);
+            compute_quant_recip(m_quantization_recip[1], m_quantization_shift[1], m_quantization_tables[1]);
+        }
+
+        if(m_frame_format == PIXEL_YUV422 && !m_yuv_initialized){
+            m_yuv_initialized = true;
+            init_yuv_tables();
         }
 
         if(!m_huff_initialized){
@@ -674,6 +774,8 @@ namespace jpge {
     void jpeg_encoder::clear()
     {
         m_mcu_lines[0] = NULL;
+        m_mcu_blocks = NULL;
+        m_frame_format = -1;
         m_pass_num = 0;
         m_all_stream_writes_succeeded = true;
     }
@@ -697,9 +799,21 @@ namespace jpge {
         return jpg_open(width, height, src_channels);
     }
 
+    bool jpeg_encoder::init(output_stream *pStream, int width, int height, pixel_format_t format, const params &comp_params)
+    {
+        deinit();
+        if (((!pStream) || (width < 1) || (height < 1)) || (!comp_params.check()) || (comp_params.m_subsampling != H2V2)) return false;
+        if ((format != PIXEL_RGB565) && ((format != PIXEL_YUV422) || (width & 1))) return false;
+        m_pStream = pStream;
+        m_params = comp_params;
+        m_frame_format = format;
+        return jpg_open(width, height, 3);
+    }
+
     void jpeg_encoder::deinit()
     {
         jpge_free(m_mcu_lines[0]);
+        jpge_free(m_mcu_blocks);
         clear();
     }
 
@@ -720,4 +834,33 @@ namespace jpge {
         return m_all_stream_writes_succeeded;
     }
 
+    bool jpeg_encoder::process_frame(const void* pImage)
+    {
+        if ((m_pass_num != 2) || (m_frame_format < 0) || (!pImage)) {
+            return false;
+        }
+        const uint8 *pSrc = static_cast<const uint8*>(pImage);
+        const int bpl = m_image_x * 2;
+        const uint8 *rows[16];
+        int cols[16];
+        for (int mcu_y = 0; (mcu_y < m_image_y_mcu) && m_all_stream_writes_succeeded; mcu_y += 16)
+        {
+            for (int i = 0; i < 16; i++)
+                rows[i] = pSrc + JPGE_MIN(mcu_y + i, m_image_y - 1) * bpl;
+            for (int mcu_x = 0; mcu_x < m_image_x_mcu; mcu_x += 16)
+            {
+                for (int i = 0; i < 16; i++)
+                    cols[i] = JPGE_MIN(mcu_x + i, m_image_x - 1) * 2;
+                if (m_frame_format == PIXEL_RGB565)
+                    load_mcu_rgb565(rows, cols);
+                else
+                    load_mcu_yuv422(rows, cols);
+                code_block(0, m_mcu_blocks + 0 * 64); code_block(0, m_mcu_blocks + 1 * 64);
+                code_block(0, m_mcu_blocks + 2 * 64); code_block(0, m_mcu_blocks + 3 * 64);
+                code_block(1, m_mcu_blocks + 4 * 64); code_block(2, m_mcu_blocks + 5 * 64);
+            }
+        }
+        return m_all_stream_writes_succeeded && process_end_of_image() && m_all_stream_writes_succeeded;
+    }
+
 } // namespace jpge
@@ -0,0 +1,159 @@
+#include <stdint.h>
+#include "img_line_convert.h"
+#include "yuv.h"
+
+// Word loads below take the first byte of a run from the low bits of the
+// word: all targets are little-endian.
+#define IS_WORD_ALIGNED(p) ((((uintptr_t)(p)) & 3) == 0)
+
+enum {
+    OUT_RGB888,
+    OUT_BGR888,
+    OUT_RGB565,
+};
+
+static inline uint8_t clamp8(int v)
+{
+    return (uint8_t)((v & ~0xFF) ? (~v >> 31) : v);
+}
+
+static inline void put_pixel(uint8_t *dst, uint32_t r, uint32_t g, uint32_t b, const int out)
+{
+    if(out == OUT_RGB888) {
+        dst[0] = r;
+        dst[1] = g;
+        dst[2] = b;
+    } else if(out == OUT_BGR888) {
+        dst[0] = b;
+        dst[1] = g;
+        dst[2] = r;
+    } else {
+        dst[0] = (r & 0xF8) | (g >> 5);
+        dst[1] = ((g & 0x1C) << 3) | (b >> 3);
+    }
+}
+
+// One RGB565 pixel from its high and low byte, channels scaled to 8 bits.
+static inline void put_rgb565(uint8_t *dst, uint32_t hb, uint32_t lb, const int out)
+{
+    put_pixel(dst, hb & 0xF8, ((hb & 0x07) << 5) | ((lb & 0xE0) >> 3), (lb & 0x1F) << 3, out);
+}
+
+// Byte at a time: word loads measured no faster for RGB565 sources.
+static inline void rgb565_to_888(const uint8_t *src, uint8_t *dst, size_t n, const int out)
+{
+    for(size_t i = 0; i < n; i++, src += 2, dst += 3) {
+        put_rgb565(dst, src[0], src[1], out);
+    }
+}
+
+void line_rgb565_to_rgb888(const uint8_t *src, uint8_t *dst, size_t n)
+{
+    rgb565_to_888(src, dst, n, OUT_RGB888);
+}
+
+void line_rgb565_to_bgr888(const uint8_t *src, uint8_t *dst, size_t n)
+{
+    rgb565_to_888(src, dst, n, OUT_BGR888);
+}
+
+void line_rgb888_to_rgb565(const uint8_t *src, uint8_t *dst, size_t n)
+{
+    size_t i = 0;
+    if(IS_WORD_ALIGNED(dst)) {
+        uint32_t *w = (uint32_t *)dst;
+        for(; i + 4 <= n; i += 4, src += 12, w += 2) {
+            uint32_t p0 = ((src[0] & 0xF8) | (src[1] >> 5)) | (((src[1] & 0x1C) << 3) | (src[2] >> 3)) << 8;
+            uint32_t p1 = ((src[3] & 0xF8) | (src[4] >> 5)) | (((src[4] & 0x1C) << 3) | (src[5] >> 3)) << 8;
+            uint32_t p2 = ((src[6] & 0xF8) | (src[7] >> 5)) | (((src[7] & 0x1C) << 3) | (src[8] >> 3)) << 8;
+            uint32_t p3 = ((src[9] & 0xF8) | (src[10] >> 5)) | (((src[10] & 0x1C) << 3) | (src[11] >> 3)) << 8;
+            w[0] = p0 | (p1 << 16);
+            w[1] = p2 | (p3 << 16);
+        }
+        dst = (uint8_t *)w;
+    }
+    for(; i < n; i++, src += 3, dst += 2) {
+        put_pixel(dst, src[0], src[1], src[2], OUT_RGB565);
+    }
+}
+
+static inline uint8_t gray565(uint32_t hb, uint32_t lb)
+{
+    uint32_t g = ((hb & 0x07) << 5) | ((lb & 0xE0) >> 3);
+    // At most 250, no clamp needed.
+    return (uint8_t)(((hb & 0xF8) * 38 + g * 75 + ((lb & 0x1F) << 3) * 15) >> 7);
+}
+
+void line_rgb565_to_gray(const uint8_t *src, uint8_t *dst, size_t n)
+{
+    for(size_t i = 0; i < n; i++, src += 2) {
+        *dst++ = gray565(src[0], src[1]);
+    }
+}
+
+// Two pixels sharing U and V: the chroma terms are looked up once.
+static inline void put_yuv_pair(uint8_t *dst, uint32_t y0, uint32_t u, uint32_t y1, uint32_t v, const int out)
+{
+    const int step = out == OUT_RGB565 ? 2 : 3;
+    const int r = yuv_table[v].vVr;
+    const int g = yuv_table[u].vUg + yuv_table[v].vVg;
+    const int b = yuv_table[u].vUb;
+    int y = yuv_table[y0].vY;
+    put_pixel(dst, clamp8(y + r), clamp8(y + g), clamp8(y + b), out);
+    y = yuv_table[y1].vY;
+    put_pixel(dst + step, clamp8(y + r), clamp8(y + g), clamp8(y + b), out);
+}
+
+static inline void yuv422_to(const uint8_t *src, uint8_t *dst, size_t n, const int out)
+{
+    const int step = out == OUT_RGB565 ? 2 : 3;
+    size_t i = 0;
+    if(IS_WORD_ALIGNED(src)) {
+        const uint32_t *w = (const uint32_t *)src;
+        for(; i + 4 <= n; i += 4, w += 2, dst += 4 * step) {
+            uint32_t a = w[0];
+            uint32_t c = w[1];
+            put_yuv_pair(dst, a & 0xFF, (a >> 8) & 0xFF, (a >> 16) & 0xFF, a >> 24, out);
+            put_yuv_pair(dst + 2 * step, c & 0xFF, (c >> 8) & 0xFF, (c >> 16) & 0xFF, c >> 24, out);
+        }
+        src = (const uint8_t *)w;
+    }
+    for(; i + 2 <= n; i += 2, src += 4, dst += 2 * step) {
+        put_yuv_pair(dst, src[0], src[1], src[2], src[3], out);
+    }
+}
+
+void line_yuv422_to_rgb888(const uint8_t *src, uint8_t *dst, size_t n)
+{
+    yuv422_to(src, dst, n, OUT_RGB888);
+}
+
+void line_yuv422_to_bgr888(const uint8_t *src, uint8_t *dst, size_t n)
+{
+    yuv422_to(src, dst, n, OUT_BGR888);
+}
+
+void line_yuv422_to_rgb565(const uint8_t *src, uint8_t *dst, size_t n)
+{
+    yuv422_to(src, dst, n, OUT_RGB565);
+}
+
+void line_yuv422_to_y(const uint8_t *src, uint8_t *dst, size_t n)
+{
+    size_t i = 0;
+    if(IS_WORD_ALIGNED(src)) {
+        const uint32_t *w = (const uint32_t *)src;
+        for(; i + 4 <= n; i += 4, w += 2, dst += 4) {
+            uint32_t a = w[0];
+            uint32_t c = w[1];
+            dst[0] = a;
+            dst[1] = a >> 16;
+            dst[2] = c;
+            dst[3] = c >> 16;
+        }
+        src = (const uint8_t *)w;
+    }
+    for(; i < n; i++, src += 2) {
+        *dst++ = src[0];
+    }
+}
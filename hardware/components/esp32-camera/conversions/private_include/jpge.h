@@ -40,6 +40,10 @@ namespace jpge
             // 3 = H2V2 subsampling (YCbCr 4x1x1, 6 blocks per MCU-- very common)
             subsampling_t m_subsampling;
     };
+
+    // Packed camera pixels jpeg_encoder::process_frame() reads without an RGB scanline in between.
+    // PIXEL_RGB565: high byte first (RRRRRGGG GGGBBBBB). PIXEL_YUV422: Y0 U Y1 V, BT.601 video range.
+    enum pixel_format_t { PIXEL_RGB565 = 0, PIXEL_YUV422 = 1 };
     
     // Output stream abstract class - used by the jpeg_encoder class to write to the output stream.
     // put_buf() is generally called with len==JPGE_OUT_BUF_SIZE bytes, but for headers it'll be called with smaller amounts.
@@ -64,12 +68,23 @@ namespace jpge
             // Returns false on out of memory or if a stream write fails.
             bool init(output_stream *pStream, int width, int height, int src_channels, const params &comp_params = params());
 
+            // Initializes the compressor for process_frame(): each 16x16 MCU is converted and
+            // subsampled straight from the frame, no scanline or MCU line buffers are allocated.
+            // Only H2V2 subsampling is supported, and even widths for YUV422.
+            // Returns false on out of memory or if a stream write fails.
+            bool init(output_stream *pStream, int width, int height, pixel_format_t format, const params &comp_params = params());
+
             // Call this method with each source scanline.
             // width * src_channels bytes per scanline is expected (RGB or Y format).
             // You must call with NULL after all scanlines are processed to finish compression.
             // Returns false on out of memory or if a stream write fails.
             bool process_scanline(const void* pScanline);
 
+            // Compresses a whole frame of the format given to init(), width * 2 bytes per row,
+            // and finishes the image. Takes the place of the process_scanline() calls.
+            // Returns false if a stream write fails.
+            bool process_frame(const void* pImage);
+
             // Deinitializes the compressor, freeing any allocated memory. May be called at any time.
             void deinit();
 
@@ -89,7 +104,9 @@ namespace jpge
             int m_image_bpl_xlt, m_image_bpl_mcu;
             int m_mcus_per_row;
             int m_mcu_x, m_mcu_y;
+            int m_frame_format; // pixel_format_t of process_frame(), -1 when fed scanlines
             uint8 *m_mcu_lines[16];
+            sample_array_t *m_mcu_blocks; // Y0 Y1 Y2 Y3 Cb Cr of the MCU process_frame() is coding
             uint8 m_mcu_y_ofs;
             sample_array_t m_sample_array[64];
             int16 m_coefficient_array[64];
@@ -120,15 +137,18 @@ namespace jpge
             void emit_sos();
 
             void compute_quant_table(int32 *dst, const int16 *src);
-            void load_quantized_coefficients(int component_num);
+            void load_quantized_coefficients(int component_num, const sample_array_t *pSamples);
 
             void load_block_8_8_grey(int x);
             void load_block_8_8(int x, int y, int c);
             void load_block_16_8(int x, int c);
             void load_block_16_8_8(int x, int c);
+            void load_mcu_rgb565(const uint8 *const *pRows, const int *pCols);
+            void load_mcu_yuv422(const uint8 *const *pRows, const int *pCols);
 
             void code_coefficients_pass_two(int component_num);
             void code_block(int component_num);
+            void code_block(int component_num, sample_array_t *pSamples);
 
             void process_mcu_row();
             bool process_end_of_image();
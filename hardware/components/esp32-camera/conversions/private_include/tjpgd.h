@@ -90,6 +90,7 @@ struct JDEC {
 /* TJpgDec API functions */
 JRESULT jd_prepare (JDEC*, UINT(*)(JDEC*,BYTE*,UINT), void*, UINT, void*);
 JRESULT jd_decomp (JDEC*, UINT(*)(JDEC*,void*,JRECT*), BYTE);
+JRESULT jd_decomp_rect (JDEC*, UINT(*)(JDEC*,void*,JRECT*), BYTE, const JRECT*);
 
 
 #ifdef __cplusplus
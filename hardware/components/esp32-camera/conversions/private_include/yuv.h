@@ -20,6 +20,17 @@ extern "C" {
 
 #include <stdint.h>
 
+typedef struct {
+        int16_t vY;
+        int16_t vVr;
+        int16_t vVg;
+        int16_t vUg;
+        int16_t vUb;
+} yuv_table_row;
+
+// Per component contributions, indexed by the Y, U or V byte.
+extern const yuv_table_row yuv_table[256];
+
 void yuv2rgb(uint8_t y, uint8_t u, uint8_t v, uint8_t *r, uint8_t *g, uint8_t *b);
 
 #ifdef __cplusplus
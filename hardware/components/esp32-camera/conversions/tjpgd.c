@@ -479,7 +479,8 @@ void block_idct (
 
 static
 JRESULT mcu_load (
-	JDEC* jd		/* Pointer to the decompressor object */
+	JDEC* jd,		/* Pointer to the decompressor object */
+	UINT idct		/* 0: only advance the stream and DC values (MCU is not output) */
 )
 {
 	LONG *tmp = (LONG*)jd->workbuf;	/* Block working buffer for de-quantize and IDCT */
@@ -542,10 +543,12 @@ JRESULT mcu_load (
 			}
 		} while (++i < 64);		/* Next AC element */
 
-		if (JD_USE_SCALE && jd->scale == 3)
-			*bp = (*tmp / 256) + 128;	/* If scale ratio is 1/8, IDCT can be ommited and only DC element is used */
-		else
-			block_idct(tmp, bp);		/* Apply IDCT and store the block to the MCU buffer */
+		if (idct) {
+			if (JD_USE_SCALE && jd->scale == 3)
+				*bp = (*tmp / 256) + 128;	/* If scale ratio is 1/8, IDCT can be ommited and only DC element is used */
+			else
+				block_idct(tmp, bp);		/* Apply IDCT and store the block to the MCU buffer */
+		}
 
 		bp += 64;				/* Next block */
 	}
@@ -935,12 +938,35 @@ JRESULT jd_decomp (
 	BYTE scale								/* Output de-scaling factor (0 to 3) */
 )
 {
-	UINT x, y, mx, my;
+	JRECT rect;
+
+
+	rect.left = 0; rect.right = jd->width - 1;
+	rect.top = 0; rect.bottom = jd->height - 1;
+	return jd_decomp_rect(jd, outfunc, scale, &rect);
+}
+
+
+
+
+/*-----------------------------------------------------------------------*/
+/* Decompress the MCUs intersecting a rectangle of the JPEG picture      */
+/*-----------------------------------------------------------------------*/
+
+JRESULT jd_decomp_rect (
+	JDEC* jd,								/* Initialized decompression object */
+	UINT (*outfunc)(JDEC*, void*, JRECT*),	/* RGB output function */
+	BYTE scale,								/* Output de-scaling factor (0 to 3) */
+	const JRECT* rect						/* Area to output, in unscaled pixels */
+)
+{
+	UINT x, y, mx, my, in;
 	WORD rst, rsc;
 	JRESULT rc;
 
 
 	if (scale > (JD_USE_SCALE ? 3 : 0)) return JDR_PAR;
+	if (rect->left > rect->right || rect->top > rect->bottom) return JDR_PAR;
 	jd->scale = scale;
 
 	mx = jd->msx * 8; my = jd->msy * 8;			/* Size of the MCU (pixel) */
@@ -949,15 +975,18 @@ JRESULT jd_decomp (
 	rst = rsc = 0;
 
 	rc = JDR_OK;
-	for (y = 0; y < jd->height; y += my) {		/* Vertical loop of MCUs */
+	for (y = 0; y < jd->height && y <= rect->bottom; y += my) {	/* Vertical loop of MCUs, up to the last row in the rectangle */
 		for (x = 0; x < jd->width; x += mx) {	/* Horizontal loop of MCUs */
 			if (jd->nrst && rst++ == jd->nrst) {	/* Process restart interval if enabled */
 				rc = restart(jd, rsc++);
 				if (rc != JDR_OK) return rc;
 				rst = 1;
 			}
-			rc = mcu_load(jd);					/* Load an MCU (decompress huffman coded stream and apply IDCT) */
+			/* Every MCU has to be decoded for the DC values, only those in the rectangle are transformed */
+			in = y + my > rect->top && x <= rect->right && x + mx > rect->left;
+			rc = mcu_load(jd, in);				/* Load an MCU (decompress huffman coded stream and apply IDCT) */
 			if (rc != JDR_OK) return rc;
+			if (!in) continue;
 			rc = mcu_output(jd, outfunc, x, y);	/* Output the MCU (color space conversion, scaling and output) */
 			if (rc != JDR_OK) return rc;
 		}
@@ -16,7 +16,7 @@
 #include "img_converters.h"
 #include "soc/efuse_reg.h"
 #include "esp_heap_caps.h"
-#include "yuv.h"
+#include "img_line_convert.h"
 #include "sdkconfig.h"
 #include "esp_jpg_decode.h"
 
@@ -70,6 +70,15 @@ typedef struct {
         uint8_t *output;
 } rgb_jpg_decoder;
 
+typedef struct {
+        rgb_jpg_decoder jpeg;   // first: _jpg_read() takes it as its arg
+        uint16_t left;          // output rectangle, in scaled pixels
+        uint16_t top;
+        uint16_t image_width;   // scaled image size, from the write start
+        uint16_t image_height;
+        pixformat_t format;
+} rect_jpg_decoder;
+
 static void *_malloc(size_t size)
 {
     return heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
@@ -167,8 +176,53 @@ static bool _rgb565_write(void * arg, uint16_t x, uint16_t y, uint16_t w, uint16
     return true;
 }
 
+//output rectangle, blocks clipped to it
+static bool _rect_write(void * arg, uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint8_t *data)
+{
+    rect_jpg_decoder * rect = (rect_jpg_decoder *)arg;
+    if(!data){
+        if(x == 0 && y == 0){
+            //write start
+            rect->image_width = w;
+            rect->image_height = h;
+        }
+        return true;
+    }
+
+    int right = rect->left + rect->jpeg.width;
+    int bottom = rect->top + rect->jpeg.height;
+    int l = x > rect->left ? x : rect->left;
+    int t = y > rect->top ? y : rect->top;
+    int r = x + w < right ? x + w : right;
+    int b = y + h < bottom ? y + h : bottom;
+    if(l >= r || t >= b) {
+        return true;
+    }
+
+    size_t bpp = rect->format == PIXFORMAT_RGB565 ? 2 : 3;
+    size_t ow = rect->jpeg.width * bpp;
+    uint8_t *o = rect->jpeg.output + (t - rect->top) * ow + (l - rect->left) * bpp;
+    data += ((t - y) * w + (l - x)) * 3;
+    for(int iy = t; iy < b; iy++) {
+        if(rect->format == PIXFORMAT_RGB565) {
+            // Camera byte order, like RGB565 frames from the sensor.
+            line_rgb888_to_rgb565(data, o, r - l);
+        } else {
+            // B G R, like fmt2rgb888() and esp-dl images.
+            for(int ix = 0; ix < (r - l) * 3; ix += 3) {
+                o[ix] = data[ix+2];
+                o[ix+1] = data[ix+1];
+                o[ix+2] = data[ix];
+            }
+        }
+        data += w * 3;
+        o += ow;
+    }
+    return true;
+}
+
 //input buffer
-static uint32_t _jpg_read(void * arg, size_t index, uint8_t *buf, size_t len)
+static size_t _jpg_read(void * arg, size_t index, uint8_t *buf, size_t len)
 {
     rgb_jpg_decoder * jpeg = (rgb_jpg_decoder *)arg;
     if(buf) {
@@ -207,6 +261,41 @@ bool jpg2rgb565(const uint8_t *src, size_t src_len, uint8_t * out, jpg_scale_t s
     return true;
 }
 
+bool jpg2rgb_rect(const uint8_t *src, size_t src_len, uint16_t x, uint16_t y, uint16_t w, uint16_t h, jpg_scale_t scale, pixformat_t format, uint8_t * out)
+{
+    if(format != PIXFORMAT_RGB565 && format != PIXFORMAT_RGB888) {
+        ESP_LOGE(TAG, "Rect output format %d is not supported", format);
+        return false;
+    }
+
+    rect_jpg_decoder rect;
+    rect.jpeg.width = w >> scale;
+    rect.jpeg.height = h >> scale;
+    rect.jpeg.input = src;
+    rect.jpeg.output = out;
+    rect.jpeg.data_offset = 0;
+    rect.left = x >> scale;
+    rect.top = y >> scale;
+    rect.image_width = 0;
+    rect.image_height = 0;
+    rect.format = format;
+    if(!rect.jpeg.width || !rect.jpeg.height) {
+        return false;
+    }
+
+    // Scaled pixels never straddle MCUs: decode the unscaled pixels behind the output.
+    if(esp_jpg_decode_rect(src_len, scale, rect.left << scale, rect.top << scale, rect.jpeg.width << scale, rect.jpeg.height << scale,
+                           _jpg_read, _rect_write, (void*)&rect) != ESP_OK){
+        return false;
+    }
+    if(rect.left + rect.jpeg.width > rect.image_width || rect.top + rect.jpeg.height > rect.image_height) {
+        ESP_LOGE(TAG, "Rect %ux%u at %u,%u is outside the %ux%u image", rect.jpeg.width, rect.jpeg.height,
+                 rect.left, rect.top, rect.image_width, rect.image_height);
+        return false;
+    }
+    return true;
+}
+
 bool jpg2bmp(const uint8_t *src, size_t src_len, uint8_t ** out, size_t * out_len)
 {
 
@@ -255,16 +344,7 @@ bool fmt2rgb888(const uint8_t *src_buf, size_t src_len, pixformat_t format, uint
     } else if(format == PIXFORMAT_RGB888) {
         memcpy(rgb_buf, src_buf, src_len);
     } else if(format == PIXFORMAT_RGB565) {
-        int i;
-        uint8_t hb, lb;
-        pix_count = src_len / 2;
-        for(i=0; i<pix_count; i++) {
-            hb = *src_buf++;
-            lb = *src_buf++;
-            *rgb_buf++ = (lb & 0x1F) << 3;
-            *rgb_buf++ = (hb & 0x07) << 5 | (lb & 0xE0) >> 3;
-            *rgb_buf++ = hb & 0xF8;
-        }
+        line_rgb565_to_bgr888(src_buf, rgb_buf, src_len / 2);
     } else if(format == PIXFORMAT_GRAYSCALE) {
         int i;
         uint8_t b;
@@ -276,26 +356,7 @@ bool fmt2rgb888(const uint8_t *src_buf, size_t src_len, pixformat_t format, uint
             *rgb_buf++ = b;
         }
     } else if(format == PIXFORMAT_YUV422) {
-        pix_count = src_len / 2;
-        int i, maxi = pix_count / 2;
-        uint8_t y0, y1, u, v;
-        uint8_t r, g, b;
-        for(i=0; i<maxi; i++) {
-            y0 = *src_buf++;
-            u = *src_buf++;
-            y1 = *src_buf++;
-            v = *src_buf++;
-
-            yuv2rgb(y0, u, v, &r, &g, &b);
-            *rgb_buf++ = b;
-            *rgb_buf++ = g;
-            *rgb_buf++ = r;
-
-            yuv2rgb(y1, u, v, &r, &g, &b);
-            *rgb_buf++ = b;
-            *rgb_buf++ = g;
-            *rgb_buf++ = r;
-        }
+        line_yuv422_to_bgr888(src_buf, rgb_buf, (src_len / 4) * 2);
     }
     return true;
 }
@@ -313,7 +374,7 @@ bool fmt2bmp(uint8_t *src, size_t src_len, uint16_t width, uint16_t height, pixf
     size_t out_size = (pix_count * 3) + BMP_HEADER_LEN;
     uint8_t * out_buf = (uint8_t *)_malloc(out_size);
     if(!out_buf) {
-        ESP_LOGE(TAG, "_malloc failed! %u", out_size);
+        ESP_LOGE(TAG, "_malloc failed! %u", (unsigned)out_size);
         return false;
     }
 
@@ -343,15 +404,7 @@ bool fmt2bmp(uint8_t *src, size_t src_len, uint16_t width, uint16_t height, pixf
     if(format == PIXFORMAT_RGB888) {
         memcpy(rgb_buf, src_buf, pix_count*3);
     } else if(format == PIXFORMAT_RGB565) {
-        int i;
-        uint8_t hb, lb;
-        for(i=0; i<pix_count; i++) {
-            hb = *src_buf++;
-            lb = *src_buf++;
-            *rgb_buf++ = (lb & 0x1F) << 3;
-            *rgb_buf++ = (hb & 0x07) << 5 | (lb & 0xE0) >> 3;
-            *rgb_buf++ = hb & 0xF8;
-        }
+        line_rgb565_to_bgr888(src_buf, rgb_buf, pix_count);
     } else if(format == PIXFORMAT_GRAYSCALE) {
         int i;
         uint8_t b;
@@ -362,25 +415,7 @@ bool fmt2bmp(uint8_t *src, size_t src_len, uint16_t width, uint16_t height, pixf
             *rgb_buf++ = b;
         }
     } else if(format == PIXFORMAT_YUV422) {
-        int i, maxi = pix_count / 2;
-        uint8_t y0, y1, u, v;
-        uint8_t r, g, b;
-        for(i=0; i<maxi; i++) {
-            y0 = *src_buf++;
-            u = *src_buf++;
-            y1 = *src_buf++;
-            v = *src_buf++;
-
-            yuv2rgb(y0, u, v, &r, &g, &b);
-            *rgb_buf++ = b;
-            *rgb_buf++ = g;
-            *rgb_buf++ = r;
-
-            yuv2rgb(y1, u, v, &r, &g, &b);
-            *rgb_buf++ = b;
-            *rgb_buf++ = g;
-            *rgb_buf++ = r;
-        }
+        line_yuv422_to_bgr888(src_buf, rgb_buf, (pix_count / 2) * 2);
     }
     *out = out_buf;
     *out_len = out_size;
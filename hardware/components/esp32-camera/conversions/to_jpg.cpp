@@ -19,7 +19,6 @@
 #include "esp_camera.h"
 #include "img_converters.h"
 #include "jpge.h"
-#include "yuv.h"
 
 #include "esp_system.h"
 #if ESP_IDF_VERSION_MAJOR >= 4 // IDF 4+
@@ -66,38 +65,27 @@ static IRAM_ATTR void convert_line_format(uint8_t * src, pixformat_t format, uin
             dst[o++] = src[i+1];
             dst[o++] = src[i];
         }
-    } else if(format == PIXFORMAT_RGB565) {
-        l = width * 2;
-        src += l * line;
-        for(i=0; i<l; i+=2) {
-            dst[o++] = src[i] & 0xF8;
-            dst[o++] = (src[i] & 0x07) << 5 | (src[i+1] & 0xE0) >> 3;
-            dst[o++] = (src[i+1] & 0x1F) << 3;
-        }
-    } else if(format == PIXFORMAT_YUV422) {
-        uint8_t y0, y1, u, v;
-        uint8_t r, g, b;
-        l = width * 2;
-        src += l * line;
-        for(i=0; i<l; i+=4) {
-            y0 = src[i];
-            u = src[i+1];
-            y1 = src[i+2];
-            v = src[i+3];
-
-            yuv2rgb(y0, u, v, &r, &g, &b);
-            dst[o++] = r;
-            dst[o++] = g;
-            dst[o++] = b;
-
-            yuv2rgb(y1, u, v, &r, &g, &b);
-            dst[o++] = r;
-            dst[o++] = g;
-            dst[o++] = b;
-        }
     }
 }
 
+// RGB565 and YUV422 go straight into the encoder's MCUs, without RGB scan lines.
+static bool convert_frame(uint8_t *src, uint16_t width, uint16_t height, pixformat_t format, const jpge::params &comp_params, jpge::output_stream *dst_stream)
+{
+    jpge::pixel_format_t pixels = format == PIXFORMAT_RGB565 ? jpge::PIXEL_RGB565 : jpge::PIXEL_YUV422;
+    jpge::jpeg_encoder dst_image;
+
+    if (!dst_image.init(dst_stream, width, height, pixels, comp_params)) {
+        ESP_LOGE(TAG, "JPG encoder init failed");
+        return false;
+    }
+    if (!dst_image.process_frame(src)) {
+        ESP_LOGE(TAG, "JPG frame encode failed");
+        return false;
+    }
+    dst_image.deinit();
+    return true;
+}
+
 bool convert_image(uint8_t *src, uint16_t width, uint16_t height, pixformat_t format, uint8_t quality, jpge::output_stream *dst_stream)
 {
     int num_channels = 3;
@@ -118,6 +106,10 @@ bool convert_image(uint8_t *src, uint16_t width, uint16_t height, pixformat_t fo
     comp_params.m_subsampling = subsampling;
     comp_params.m_quality = quality;
 
+    if(format == PIXFORMAT_RGB565 || format == PIXFORMAT_YUV422) {
+        return convert_frame(src, width, height, format, comp_params, dst_stream);
+    }
+
     jpge::jpeg_encoder dst_image;
 
     if (!dst_image.init(dst_stream, width, height, num_channels, comp_params)) {
@@ -163,7 +155,7 @@ public:
         index += ocb(oarg, index, data, len);
         return true;
     }
-    virtual size_t get_size() const
+    virtual jpge::uint get_size() const
     {
         return index;
     }
@@ -209,7 +201,7 @@ public:
         return true;
     }
 
-    virtual size_t get_size() const
+    virtual jpge::uint get_size() const
     {
         return index;
     }
@@ -14,15 +14,7 @@
 #include "yuv.h"
 #include "esp_attr.h"
 
-typedef struct {
-        int16_t vY;
-        int16_t vVr;
-        int16_t vVg;
-        int16_t vUg;
-        int16_t vUb;
-} yuv_table_row;
-
-static const yuv_table_row yuv_table[256] = {
+const yuv_table_row yuv_table[256] = {
     //  Y    Vr    Vg    Ug    Ub     // #
     {  -18, -204,   50,  104, -258 }, // 0
     {  -17, -202,   49,  103, -256 }, // 1
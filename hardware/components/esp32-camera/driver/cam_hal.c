@@ -139,6 +139,7 @@ static void cam_task(void *arg)
             case CAM_STATE_READ_BUF: {
                 camera_fb_t * frame_buffer_event = &cam_obj->frames[frame_pos].fb;
                 size_t pixels_per_dma = (cam_obj->dma_half_buffer_size * cam_obj->fb_bytes_per_pixel) / (cam_obj->dma_bytes_per_item * cam_obj->in_bytes_per_pixel);
+                pixels_per_dma /= cam_obj->fb_decimation * cam_obj->fb_decimation;
                 
                 if (cam_event == CAM_IN_SUC_EOF_EVENT) {
                     if(!cam_obj->psram_mode){
@@ -352,7 +353,17 @@ esp_err_t cam_config(const camera_config_t *config, framesize_t frame_size, uint
     CAM_CHECK(NULL != config, "config pointer is invalid", ESP_ERR_INVALID_ARG);
     esp_err_t ret = ESP_OK;
 
+    cam_obj->fb_decimation = config->fb_decimation > 1 ? config->fb_decimation : 1;
+    cam_obj->fb_yuv_to_rgb565 = config->fb_yuv_to_rgb565 && config->pixel_format == PIXFORMAT_RGB565;
+    CAM_CHECK(cam_obj->fb_decimation == 1 || cam_obj->fb_decimation == 2 || cam_obj->fb_decimation == 4, "fb_decimation must be 1, 2 or 4", ESP_ERR_INVALID_ARG);
+#if !CONFIG_IDF_TARGET_ESP32
+    CAM_CHECK(cam_obj->fb_decimation == 1 && !cam_obj->fb_yuv_to_rgb565, "decimation and conversion while copying are ESP32 only", ESP_ERR_NOT_SUPPORTED);
+#endif
+    CAM_CHECK(resolution[frame_size].width % (cam_obj->fb_decimation * 2) == 0 && resolution[frame_size].height % cam_obj->fb_decimation == 0,
+              "frame size is not a multiple of the decimation", ESP_ERR_INVALID_ARG);
+
     ret = ll_cam_set_sample_mode(cam_obj, (pixformat_t)config->pixel_format, config->xclk_freq_hz, sensor_pid);
+    CAM_CHECK(ret == ESP_OK, "sample mode not supported", ret);
 
     cam_obj->jpeg_mode = config->pixel_format == PIXFORMAT_JPEG;
 #if CONFIG_IDF_TARGET_ESP32
@@ -369,7 +380,7 @@ esp_err_t cam_config(const camera_config_t *config, framesize_t frame_size, uint
         cam_obj->fb_size = cam_obj->recv_size;
     } else {
         cam_obj->recv_size = cam_obj->width * cam_obj->height * cam_obj->in_bytes_per_pixel;
-        cam_obj->fb_size = cam_obj->width * cam_obj->height * cam_obj->fb_bytes_per_pixel;
+        cam_obj->fb_size = (cam_obj->width / cam_obj->fb_decimation) * (cam_obj->height / cam_obj->fb_decimation) * cam_obj->fb_bytes_per_pixel;
     }
     
     ret = cam_dma_config(config);
@@ -72,11 +72,13 @@ static const char *TAG = "camera";
 typedef struct {
     sensor_t sensor;
     camera_fb_t fb;
+    uint8_t fb_decimation;
 } camera_state_t;
 
 static const char *CAMERA_SENSOR_NVS_KEY = "sensor";
 static const char *CAMERA_PIXFORMAT_NVS_KEY = "pixformat";
 static camera_state_t *s_state = NULL;
+static const camera_fb_source_t *s_fb_source = NULL;
 
 #if CONFIG_IDF_TARGET_ESP32S3 // LCD_CAM module of ESP32-S3 will generate xclk
 #define CAMERA_ENABLE_OUT_CLOCK(v)
@@ -262,13 +264,20 @@ esp_err_t esp_camera_init(const camera_config_t *config)
 
     s_state->sensor.status.framesize = frame_size;
     s_state->sensor.pixformat = pix_format;
+    s_state->fb_decimation = config->fb_decimation > 1 ? config->fb_decimation : 1;
     ESP_LOGD(TAG, "Setting frame size to %dx%d", resolution[frame_size].width, resolution[frame_size].height);
     if (s_state->sensor.set_framesize(&s_state->sensor, frame_size) != 0) {
         ESP_LOGE(TAG, "Failed to set frame size");
         err = ESP_ERR_CAMERA_FAILED_TO_SET_FRAME_SIZE;
         goto fail;
     }
-    s_state->sensor.set_pixformat(&s_state->sensor, pix_format);
+    if (config->fb_yuv_to_rgb565 && pix_format == PIXFORMAT_RGB565) {
+        // converted while copying from DMA, frames are still RGB565
+        s_state->sensor.set_pixformat(&s_state->sensor, PIXFORMAT_YUV422);
+        s_state->sensor.pixformat = pix_format;
+    } else {
+        s_state->sensor.set_pixformat(&s_state->sensor, pix_format);
+    }
 
     if (s_state->sensor.id.PID == OV2640_PID) {
         s_state->sensor.set_gainceiling(&s_state->sensor, GAINCEILING_2X);
@@ -309,14 +318,17 @@ esp_err_t esp_camera_deinit()
 
 camera_fb_t *esp_camera_fb_get()
 {
+    if (s_fb_source) {
+        return s_fb_source->fb_get(s_fb_source->ctx);
+    }
     if (s_state == NULL) {
         return NULL;
     }
     camera_fb_t *fb = cam_take(FB_GET_TIMEOUT);
     //set the frame properties
     if (fb) {
-        fb->width = resolution[s_state->sensor.status.framesize].width;
-        fb->height = resolution[s_state->sensor.status.framesize].height;
+        fb->width = resolution[s_state->sensor.status.framesize].width / s_state->fb_decimation;
+        fb->height = resolution[s_state->sensor.status.framesize].height / s_state->fb_decimation;
         fb->format = s_state->sensor.pixformat;
     }
     return fb;
@@ -324,12 +336,26 @@ camera_fb_t *esp_camera_fb_get()
 
 void esp_camera_fb_return(camera_fb_t *fb)
 {
+    if (s_fb_source) {
+        s_fb_source->fb_return(s_fb_source->ctx, fb);
+        return;
+    }
     if (s_state == NULL) {
         return;
     }
     cam_give(fb);
 }
 
+void esp_camera_set_fb_source(const camera_fb_source_t *source)
+{
+    s_fb_source = source;
+}
+
+const camera_fb_source_t *esp_camera_get_fb_source()
+{
+    return s_fb_source;
+}
+
 sensor_t *esp_camera_sensor_get()
 {
     if (s_state == NULL) {
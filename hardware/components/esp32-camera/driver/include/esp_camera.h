@@ -124,6 +124,8 @@ typedef struct {
     size_t fb_count;                /*!< Number of frame buffers to be allocated. If more than one, then each frame will be acquired (double speed)  */
     camera_fb_location_t fb_location; /*!< The location where the frame buffer will be allocated */
     camera_grab_mode_t grab_mode;   /*!< When buffers should be filled */
+    uint8_t fb_decimation;          /*!< Keep every 2nd or 4th pixel of every 2nd or 4th line while copying from DMA. 0 or 1 keeps the full frame (ESP32 only, not with JPEG) */
+    bool fb_yuv_to_rgb565;          /*!< With PIXFORMAT_RGB565: the sensor sends YUV422, converted to RGB565 while copying from DMA (ESP32 only) */
 } camera_config_t;
 
 /**
@@ -138,6 +140,16 @@ typedef struct {
     struct timeval timestamp;   /*!< Timestamp since boot of the first DMA buffer of the frame */
 } camera_fb_t;
 
+/**
+ * @brief Frame source standing in for the sensor, e.g. recorded frames
+ *        replayed from files. Installed with esp_camera_set_fb_source().
+ */
+typedef struct {
+    camera_fb_t * (*fb_get)(void * ctx);            /*!< Next frame, NULL when none arrives in time, like esp_camera_fb_get() */
+    void (*fb_return)(void * ctx, camera_fb_t * fb); /*!< Hand a frame from fb_get back */
+    void * ctx;                                     /*!< Passed to both callbacks */
+} camera_fb_source_t;
+
 #define ESP_ERR_CAMERA_BASE 0x20000
 #define ESP_ERR_CAMERA_NOT_DETECTED             (ESP_ERR_CAMERA_BASE + 1)
 #define ESP_ERR_CAMERA_FAILED_TO_SET_FRAME_SIZE (ESP_ERR_CAMERA_BASE + 2)
@@ -185,6 +197,22 @@ camera_fb_t* esp_camera_fb_get();
  */
 void esp_camera_fb_return(camera_fb_t * fb);
 
+/**
+ * @brief Serve esp_camera_fb_get() and esp_camera_fb_return() from a frame
+ *        source instead of the sensor. The driver does not have to be
+ *        initialized.
+ *
+ * @param source    Frame source, kept by pointer. NULL goes back to the sensor
+ */
+void esp_camera_set_fb_source(const camera_fb_source_t * source);
+
+/**
+ * @brief Get the installed frame source
+ *
+ * @return the frame source, NULL while frames come from the sensor
+ */
+const camera_fb_source_t * esp_camera_get_fb_source();
+
 /**
  * @brief Get a pointer to the image sensor control structure
  *
@@ -33,6 +33,7 @@ static inline int gpio_ll_get_level(gpio_dev_t *hw, int gpio_num)
 #include "ll_cam.h"
 #include "xclk.h"
 #include "cam_hal.h"
+#include "yuv.h"
 
 #if (ESP_IDF_VERSION_MAJOR >= 5)
 #define GPIO_PIN_INTR_POSEDGE GPIO_INTR_POSEDGE
@@ -195,6 +196,102 @@ static size_t IRAM_ATTR ll_cam_dma_filter_yuyv_highspeed(uint8_t* dst, const uin
     return elements;
 }
 
+typedef enum {
+    RESAMPLE_NONE = 0,      // plain dma_filter copy
+    RESAMPLE_Y8,            // 1 byte per pixel: Y8 from the camera
+    RESAMPLE_RGB565,        // 2 bytes per pixel: RGB565 from the camera
+    RESAMPLE_YUYV,          // YUYV in, YUYV out
+    RESAMPLE_YUYV_TO_Y,     // YUYV in, Y8 out
+    RESAMPLE_YUYV_TO_RGB565,// YUYV in, RGB565 out
+} resample_mode_t;
+
+static resample_mode_t resample_mode = RESAMPLE_NONE;
+
+// i-th byte sent by the camera within the DMA buffer
+static inline uint8_t IRAM_ATTR dma_byte(const dma_elem_t* dma_el, size_t i, bool packed)
+{
+    if (packed) {
+        // SM_0A0B_0C0D: two bytes per element
+        return (i & 1) ? dma_el[i >> 1].sample2 : dma_el[i >> 1].sample1;
+    }
+    // SM_0A00_0B00: one byte per element
+    return dma_el[i].sample1;
+}
+
+static inline uint8_t IRAM_ATTR clamp_u8(int v)
+{
+    return v < 0 ? 0 : (v > 255 ? 255 : v);
+}
+
+/*
+ * Copy every n-th pixel of every n-th line, converting on the way. Each DMA
+ * half buffer holds a whole number of lines, a multiple of n (see
+ * ll_cam_calc_rgb_dma), so every buffer starts on a kept line.
+ */
+static size_t IRAM_ATTR ll_cam_dma_resample(cam_obj_t *cam, uint8_t* dst, const uint8_t* src, size_t len, bool packed)
+{
+    const dma_elem_t* dma_el = (const dma_elem_t*)src;
+    const size_t step = cam->fb_decimation;
+    const size_t width = cam->width;
+    const size_t line_bytes = width * cam->in_bytes_per_pixel;
+    const size_t lines = len / cam->dma_bytes_per_item / line_bytes;
+    uint8_t *out = dst;
+
+    for (size_t line = 0; line < lines; line += step) {
+        const size_t base = line * line_bytes;
+        switch (resample_mode) {
+        case RESAMPLE_Y8:
+            for (size_t x = 0; x < width; x += step) {
+                *out++ = dma_byte(dma_el, base + x, packed);
+            }
+            break;
+        case RESAMPLE_RGB565:
+            for (size_t x = 0; x < width; x += step) {
+                out[0] = dma_byte(dma_el, base + x * 2, packed);
+                out[1] = dma_byte(dma_el, base + x * 2 + 1, packed);
+                out += 2;
+            }
+            break;
+        case RESAMPLE_YUYV_TO_Y:
+            for (size_t x = 0; x < width; x += step) {
+                *out++ = dma_byte(dma_el, base + x * 2, packed);
+            }
+            break;
+        case RESAMPLE_YUYV:
+            // pixels x and x + step make one Y0 U Y1 V pair, U and V of the
+            // pair each pixel belongs to
+            for (size_t x = 0; x < width; x += step * 2) {
+                size_t x1 = x + step;
+                out[0] = dma_byte(dma_el, base + x * 2, packed);
+                out[1] = dma_byte(dma_el, base + (x & ~1) * 2 + 1, packed);
+                out[2] = dma_byte(dma_el, base + x1 * 2, packed);
+                out[3] = dma_byte(dma_el, base + (x1 & ~1) * 2 + 3, packed);
+                out += 4;
+            }
+            break;
+        case RESAMPLE_YUYV_TO_RGB565:
+            // yuv_table terms, as fmt2rgb888() uses for the same frame,
+            // RGB565 high byte first like the sensor sends it
+            for (size_t x = 0; x < width; x += step) {
+                size_t pair = base + (x & ~1) * 2;
+                int y = yuv_table[dma_byte(dma_el, base + x * 2, packed)].vY;
+                uint8_t u = dma_byte(dma_el, pair + 1, packed);
+                uint8_t v = dma_byte(dma_el, pair + 3, packed);
+                uint8_t r = clamp_u8(y + yuv_table[v].vVr);
+                uint8_t g = clamp_u8(y + yuv_table[u].vUg + yuv_table[v].vVg);
+                uint8_t b = clamp_u8(y + yuv_table[u].vUb);
+                out[0] = (r & 0xF8) | (g >> 5);
+                out[1] = ((g << 3) & 0xE0) | (b >> 3);
+                out += 2;
+            }
+            break;
+        default:
+            return 0;
+        }
+    }
+    return out - dst;
+}
+
 static void IRAM_ATTR ll_cam_vsync_isr(void *arg)
 {
     //DBG_PIN_SET(1);
@@ -435,8 +532,13 @@ static bool ll_cam_calc_rgb_dma(cam_obj_t *cam){
     // Calculate max EOF size divisable by node size
     dma_half_buffer = (dma_half_buffer_max / dma_half_buffer_min) * dma_half_buffer_min;
     // Adjust EOF size so that height will be divisable by the number of lines in each EOF
+    // and, when decimating, the number of lines by the decimation factor
     lines_per_half_buffer = dma_half_buffer / line_width;
-    while((cam->height % lines_per_half_buffer) != 0){
+    while((cam->height % lines_per_half_buffer) != 0 || (lines_per_half_buffer % cam->fb_decimation) != 0){
+        if (dma_half_buffer == dma_half_buffer_min) {
+            ESP_LOGE(TAG, "No DMA buffer size holds a multiple of %u lines", cam->fb_decimation);
+            return 0;
+        }
         dma_half_buffer = dma_half_buffer - dma_half_buffer_min;
         lines_per_half_buffer = dma_half_buffer / line_width;
     }
@@ -472,7 +574,12 @@ static dma_filter_t dma_filter = ll_cam_dma_filter_jpeg;
 size_t IRAM_ATTR ll_cam_memcpy(cam_obj_t *cam, uint8_t *out, const uint8_t *in, size_t len)
 {
     //DBG_PIN_SET(1);
-    size_t r = dma_filter(out, in, len);
+    size_t r;
+    if (resample_mode != RESAMPLE_NONE) {
+        r = ll_cam_dma_resample(cam, out, in, len, sampling_mode == SM_0A0B_0C0D);
+    } else {
+        r = dma_filter(out, in, len);
+    }
     //DBG_PIN_SET(0);
     return r;
 }
@@ -523,6 +630,21 @@ esp_err_t ll_cam_set_sample_mode(cam_obj_t *cam, pixformat_t pix_format, uint32_
         ESP_LOGE(TAG, "Requested format is not supported");
         return ESP_ERR_NOT_SUPPORTED;
     }
+
+    resample_mode = RESAMPLE_NONE;
+    if (cam->fb_decimation > 1 || cam->fb_yuv_to_rgb565) {
+        if (pix_format == PIXFORMAT_JPEG || sampling_mode == SM_0A0B_0B0C) {
+            ESP_LOGE(TAG, "Decimation and conversion need YUV422, RGB565 or GRAYSCALE in SM_0A0B_0C0D or SM_0A00_0B00");
+            return ESP_ERR_NOT_SUPPORTED;
+        }
+        if (pix_format == PIXFORMAT_GRAYSCALE) {
+            resample_mode = cam->in_bytes_per_pixel == 1 ? RESAMPLE_Y8 : RESAMPLE_YUYV_TO_Y;
+        } else if (pix_format == PIXFORMAT_YUV422) {
+            resample_mode = RESAMPLE_YUYV;
+        } else {
+            resample_mode = cam->fb_yuv_to_rgb565 ? RESAMPLE_YUYV_TO_RGB565 : RESAMPLE_RGB565;
+        }
+    }
     I2S0.fifo_conf.rx_fifo_mod = sampling_mode;
     return ESP_OK;
 }
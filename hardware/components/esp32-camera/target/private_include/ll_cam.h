@@ -118,6 +118,8 @@ typedef struct {
     uint16_t height;
     uint8_t in_bytes_per_pixel;
     uint8_t fb_bytes_per_pixel;
+    uint8_t fb_decimation;//keep every n-th pixel of every n-th line, ESP32
+    bool fb_yuv_to_rgb565;//camera sends YUV422, frame buffer stores RGB565, ESP32
     uint32_t fb_size;
 
     cam_state_t state;
@@ -55,4 +55,27 @@ void *app_camera_decode(camera_fb_t *fb)
         }
     }
     return NULL;
-}
\ No newline at end of file
+}
+
+void *app_camera_decode_rect(camera_fb_t *fb, int x, int y, int w, int h, jpg_scale_t scale)
+{
+    if (fb->format != PIXFORMAT_JPEG || x < 0 || y < 0 || (w >> scale) < 1 || (h >> scale) < 1)
+    {
+        ESP_LOGE(TAG, "cannot decode a %dx%d rect at %d,%d of format %d", w, h, x, y, fb->format);
+        return NULL;
+    }
+
+    uint8_t *image_ptr = (uint8_t *)dl::tool::malloc_aligned((w >> scale) * (h >> scale) * 3, 16);
+    if (!image_ptr)
+    {
+        ESP_LOGE(TAG, "malloc memory for rect rgb888 failed");
+        return NULL;
+    }
+    if (!jpg2rgb_rect(fb->buf, fb->len, x, y, w, h, scale, PIXFORMAT_RGB888, image_ptr))
+    {
+        ESP_LOGE(TAG, "jpg2rgb_rect failed");
+        dl::tool::free_aligned(image_ptr);
+        return NULL;
+    }
+    return (void *)image_ptr;
+}
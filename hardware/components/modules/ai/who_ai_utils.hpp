@@ -21,3 +21,18 @@ void print_detection_result(std::list<dl::detect::result_t> &results);
  * @param fb 
  */
 void *app_camera_decode(camera_fb_t *fb);
+
+/**
+ * @brief Decode a rectangle of a PIXFORMAT_JPEG fb to RGB888 (B G R, like
+ *        app_camera_decode()), only decompressing the MCUs under it. Returns
+ *        a new memory of (w >> scale) x (h >> scale) pixels, don't forget to
+ *        free it with dl::tool::free_aligned()
+ *
+ * @param fb     JPEG frame
+ * @param x      left of the rectangle, in frame pixels
+ * @param y      top of the rectangle, in frame pixels
+ * @param w      width of the rectangle, in frame pixels
+ * @param h      height of the rectangle, in frame pixels
+ * @param scale  output scale
+ */
+void *app_camera_decode_rect(camera_fb_t *fb, int x, int y, int w, int h, jpg_scale_t scale);
@@ -0,0 +1,214 @@
+#include "who_face_align.hpp"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sdkconfig.h"
+#include "esp_log.h"
+#include "img_line_convert.h"
+
+#include "dl_image.hpp"
+
+#if CONFIG_WHO_ALIGN_COMPARE
+#include "face_recognition_tool.hpp"
+#endif
+
+static const char *TAG = "face_align";
+
+// MFN template for a 112x112 face in keypoint order, the same constants
+// face_recognition_tool::align_face() uses.
+static const float TEMPLATE[10] = {
+    38.2946f, 51.6963f,     // left eye
+    41.5493f, 92.3655f,     // left mouth corner
+    56.0252f, 71.7366f,     // nose
+    73.5318f, 51.5014f,     // right eye
+    70.7299f, 92.2041f,     // right mouth corner
+};
+
+static who_align_stats_t s_stats = {};
+
+bool who_align_get_transform(const int *landmarks, who_align_transform_t *transform)
+{
+    // Least squares of template = [a -b; b a] * keypoint + t, on centred
+    // points. A handful of scalar operations, no matrix and no inverse.
+    float sx = 0, sy = 0, dx = 0, dy = 0;
+    for (int i = 0; i < 10; i += 2)
+    {
+        sx += landmarks[i];
+        sy += landmarks[i + 1];
+        dx += TEMPLATE[i];
+        dy += TEMPLATE[i + 1];
+    }
+    sx /= 5;
+    sy /= 5;
+    dx /= 5;
+    dy /= 5;
+
+    float dot = 0, cross = 0, norm = 0;
+    for (int i = 0; i < 10; i += 2)
+    {
+        float ux = landmarks[i] - sx, uy = landmarks[i + 1] - sy;
+        float vx = TEMPLATE[i] - dx, vy = TEMPLATE[i + 1] - dy;
+        dot += ux * vx + uy * vy;
+        cross += ux * vy - uy * vx;
+        norm += ux * ux + uy * uy;
+    }
+    if (norm < 1.0f)
+        return false;
+    float a = dot / norm;
+    float b = cross / norm;
+    float scale = a * a + b * b;
+    if (scale < 1e-6f)
+        return false;
+
+    // Inverse similarity: keypoint = [a b; -b a] / (a^2 + b^2) * (template - t)
+    float p = a / scale;
+    float q = -b / scale;
+    float tx = dx - (a * sx - b * sy);
+    float ty = dy - (b * sx + a * sy);
+    transform->p = (int32_t)lrintf(p * 65536.0f);
+    transform->q = (int32_t)lrintf(q * 65536.0f);
+    transform->tx = (int32_t)lrintf(-(p * tx - q * ty) * 65536.0f);
+    transform->ty = (int32_t)lrintf(-(q * tx + p * ty) * 65536.0f);
+    return true;
+}
+
+// RGB888 of pixel x in a row, for each frame format.
+static inline void rgb_rgb565(const uint8_t *row, int x, uint8_t *rgb)
+{
+    dl::image::convert_pixel_rgb565_to_rgb888(((const uint16_t *)row)[x], rgb);
+}
+
+static inline void rgb_gray(const uint8_t *row, int x, uint8_t *rgb)
+{
+    rgb[0] = rgb[1] = rgb[2] = row[x];
+}
+
+// Y0 U Y1 V, through the shared yuv_table like fmt2rgb888(), so colours
+// match the rest of the pipeline. Written in dl's blue-green-red order.
+static inline void rgb_yuv422(const uint8_t *row, int x, uint8_t *rgb)
+{
+    uint8_t pair[6];
+    line_yuv422_to_bgr888(row + (x & ~1) * 2, pair, 2);
+    memcpy(rgb, pair + (x & 1) * 3, 3);
+}
+
+template <void (*pixel)(const uint8_t *, int, uint8_t *)>
+static void warp(const uint8_t *frame, int stride, int height, int width, const who_align_transform_t *t, uint8_t *output)
+{
+    const int32_t max_x = (width - 1) << 16;
+    const int32_t max_y = (height - 1) << 16;
+    uint8_t *dst = output;
+    for (int row = 0; row < WHO_ALIGN_SIZE; row++)
+    {
+        int32_t x = t->tx - t->q * row;
+        int32_t y = t->ty + t->p * row;
+        for (int col = 0; col < WHO_ALIGN_SIZE; col++, x += t->p, y += t->q, dst += 3)
+        {
+            if (x < 0 || y < 0 || x >= max_x || y >= max_y)
+            {
+                dst[0] = dst[1] = dst[2] = 0;
+                continue;
+            }
+
+            const uint8_t *row0 = frame + (y >> 16) * stride;
+            const uint8_t *row1 = row0 + stride;
+            int sx = x >> 16;
+            int fx = (x >> 8) & 0xFF;
+            int fy = (y >> 8) & 0xFF;
+            uint8_t c00[3], c01[3], c10[3], c11[3];
+            pixel(row0, sx, c00);
+            pixel(row0, sx + 1, c01);
+            pixel(row1, sx, c10);
+            pixel(row1, sx + 1, c11);
+            for (int c = 0; c < 3; c++)
+            {
+                int top = c00[c] * (256 - fx) + c01[c] * fx;
+                int bottom = c10[c] * (256 - fx) + c11[c] * fx;
+                dst[c] = (uint8_t)((top * (256 - fy) + bottom * fy + (1 << 15)) >> 16);
+            }
+        }
+    }
+}
+
+void who_align_warp(const uint16_t *frame, int height, int width, const who_align_transform_t *t, uint8_t *output)
+{
+    warp<rgb_rgb565>((const uint8_t *)frame, width * 2, height, width, t, output);
+}
+
+bool who_align_warp_format(const uint8_t *frame, pixformat_t format, int height, int width, const who_align_transform_t *t, uint8_t *output)
+{
+    switch (format)
+    {
+    case PIXFORMAT_RGB565:
+        warp<rgb_rgb565>(frame, width * 2, height, width, t, output);
+        return true;
+    case PIXFORMAT_YUV422:
+        warp<rgb_yuv422>(frame, width * 2, height, width, t, output);
+        return true;
+    case PIXFORMAT_GRAYSCALE:
+        warp<rgb_gray>(frame, width, height, width, t, output);
+        return true;
+    default:
+        return false;
+    }
+}
+
+#if CONFIG_WHO_ALIGN_COMPARE
+// Same face through face_recognition_tool, counted channel by channel.
+static void compare_reference(const uint16_t *frame, int height, int width, const int *landmarks, dl::Tensor<uint8_t> &output)
+{
+    static dl::Tensor<uint8_t> reference;
+    if (!reference.element)
+    {
+        reference.set_shape({WHO_ALIGN_SIZE, WHO_ALIGN_SIZE, 3});
+        if (!reference.calloc_element())
+            return;
+    }
+    std::vector<int> keypoints(landmarks, landmarks + 10);
+    face_recognition_tool::align_face((uint16_t *)frame, {height, width, 3}, &reference, keypoints);
+
+    uint32_t max_diff = 0;
+    for (int i = 0; i < WHO_ALIGN_SIZE * WHO_ALIGN_SIZE * 3; i++)
+    {
+        uint32_t diff = abs((int)output.element[i] - (int)reference.element[i]);
+        s_stats.sum_diff += diff;
+        if (diff > 1)
+            s_stats.off_by_more++;
+        if (diff > max_diff)
+            max_diff = diff;
+    }
+    s_stats.compared++;
+    if (max_diff > s_stats.max_diff)
+    {
+        s_stats.max_diff = max_diff;
+        ESP_LOGW(TAG, "New largest difference to align_face(): %u", (unsigned)max_diff);
+    }
+}
+#endif
+
+void who_align_face(const uint8_t *frame, pixformat_t format, int height, int width, const int *landmarks, dl::Tensor<uint8_t> &output)
+{
+    who_align_transform_t transform;
+    if (!who_align_get_transform(landmarks, &transform))
+    {
+        ESP_LOGW(TAG, "Degenerate keypoints, face left blank");
+        memset(output.element, 0, WHO_ALIGN_SIZE * WHO_ALIGN_SIZE * 3);
+        return;
+    }
+    if (!who_align_warp_format(frame, format, height, width, &transform, output.element))
+    {
+        ESP_LOGW(TAG, "Pixel format %d cannot be aligned, face left blank", (int)format);
+        memset(output.element, 0, WHO_ALIGN_SIZE * WHO_ALIGN_SIZE * 3);
+        return;
+    }
+#if CONFIG_WHO_ALIGN_COMPARE
+    if (format == PIXFORMAT_RGB565)
+        compare_reference((const uint16_t *)frame, height, width, landmarks, output);
+#endif
+}
+
+void who_align_get_stats(who_align_stats_t *stats)
+{
+    *stats = s_stats;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <stdint.h>
+#include "dl_variable.hpp"
+#include "sensor.h"
+
+#define WHO_ALIGN_SIZE 112  // MFN input side
+
+/**
+ * @brief Inverse similarity transform, aligned face pixel -> frame pixel,
+ *        in Q16: x = p * col - q * row + tx, y = q * col + p * row + ty.
+ */
+typedef struct
+{
+    int32_t p;
+    int32_t q;
+    int32_t tx;
+    int32_t ty;
+} who_align_transform_t;
+
+/**
+ * @brief Align-stage comparison counters, CONFIG_WHO_ALIGN_COMPARE only.
+ */
+typedef struct
+{
+    uint32_t compared;      /*<! faces aligned both ways */
+    uint32_t max_diff;      /*<! largest channel difference seen */
+    uint64_t sum_diff;      /*<! sum of channel differences, for the mean */
+    uint32_t off_by_more;   /*<! channels differing by more than 1 */
+} who_align_stats_t;
+
+/**
+ * @brief Closed-form least-squares similarity transform from the 5 detected
+ *        keypoints onto the MFN template, inverted for sampling.
+ *
+ * @param landmarks keypoints in MNP01 order: left eye, left mouth corner,
+ *                  nose, right eye, right mouth corner, [x, y] each
+ * @param transform output inverse transform
+ * @return false when the keypoints are degenerate
+ */
+bool who_align_get_transform(const int *landmarks, who_align_transform_t *transform);
+
+/**
+ * @brief Warp an RGB565 frame into a 112x112 RGB888 face with fixed-point
+ *        bilinear sampling. Pixels sampled outside the frame are 0, the
+ *        same as dl::image::warp_affine().
+ *
+ * @param frame     RGB565 frame, camera byte order
+ * @param height    frame height
+ * @param width     frame width
+ * @param transform from who_align_get_transform()
+ * @param output    112 x 112 x 3 bytes
+ */
+void who_align_warp(const uint16_t *frame, int height, int width, const who_align_transform_t *transform, uint8_t *output);
+
+/**
+ * @brief who_align_warp() for any frame the camera can deliver uncompressed.
+ *        YUV422 is converted to RGB for the sampled pixels only, GRAYSCALE
+ *        gives a gray face.
+ *
+ * @param frame     frame buffer
+ * @param format    PIXFORMAT_RGB565, PIXFORMAT_YUV422 or PIXFORMAT_GRAYSCALE
+ * @param height    frame height
+ * @param width     frame width
+ * @param transform from who_align_get_transform()
+ * @param output    112 x 112 x 3 bytes
+ * @return false for other formats
+ */
+bool who_align_warp_format(const uint8_t *frame, pixformat_t format, int height, int width, const who_align_transform_t *transform, uint8_t *output);
+
+/**
+ * @brief Drop-in for face_recognition_tool::align_face(), on any format
+ *        who_align_warp_format() takes.
+ *
+ * @param frame     frame buffer
+ * @param format    frame pixel format
+ * @param height    frame height
+ * @param width     frame width
+ * @param landmarks 10 MNP01 keypoints
+ * @param output    tensor of shape {112, 112, 3}
+ */
+void who_align_face(const uint8_t *frame, pixformat_t format, int height, int width, const int *landmarks, dl::Tensor<uint8_t> &output);
+
+/**
+ * @brief Get a copy of the comparison counters.
+ */
+void who_align_get_stats(who_align_stats_t *stats);
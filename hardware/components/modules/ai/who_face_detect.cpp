@@ -0,0 +1,299 @@
+#include "who_face_detect.hpp"
+
+#include <string.h>
+#include <algorithm>
+#include <new>
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "human_face_detect_msr01.hpp"
+#include "human_face_detect_mnp01.hpp"
+#include "who_pipeline_stats.hpp"
+
+static const char *TAG = "face_detect";
+
+// Smallest face MSR01 finds at its own input, in pixels. The hand-tuned
+// resize_scale of 0.4 for 40 px faces on QVGA follows from it.
+#define MSR01_MIN_FACE 16
+
+// MNP01 output of the last pass, kept in frame coordinates for reuse.
+typedef struct
+{
+    int candidate[4];   /*<! MSR01 box the face was refined from */
+    who_face_t face;
+    int age;            /*<! passes since MNP01 last ran on it */
+} previous_t;
+
+static HumanFaceDetectMSR01 *s_msr01 = NULL;
+static HumanFaceDetectMNP01 *s_mnp01 = NULL;
+
+static float s_resize_scale = 1.0f;
+static int s_msr_shift = 0;     /*<! pyramid level MSR01 runs on */
+static int s_min_face = 0;
+static int s_max_face = 0;
+static int s_top_k = 0;
+static float s_floor = 0.0f;
+static int s_reuse_passes = 0;
+static int s_reuse_iou_percent = 70;
+
+static previous_t s_previous[WHO_DETECT_MAX_FACES];
+static int s_previous_count = 0;
+
+static who_detect_stats_t s_stats = {};
+
+bool who_detect_init(float msr_score, float msr_nms, int msr_top_k, int min_face, int max_face,
+                     float mnp_score, float mnp_nms, int mnp_top_k, int max_shift)
+{
+    if (s_msr01)
+        return true;
+
+    // Shrink the input as far as the smallest wanted face still shows up:
+    // the resolution a smaller face would need is never computed.
+    s_min_face = min_face;
+    s_max_face = max_face;
+    s_resize_scale = min_face > 0 ? std::min(1.0f, std::max(0.1f, (float)MSR01_MIN_FACE / min_face)) : 1.0f;
+    // Whole halvings come from the pyramid, MSR01 resizes what is left.
+    float msr_scale = s_resize_scale;
+    s_msr_shift = 0;
+    while (s_msr_shift < max_shift && msr_scale * 2 <= 1.0f)
+    {
+        msr_scale *= 2;
+        s_msr_shift++;
+    }
+
+    s_msr01 = new (std::nothrow) HumanFaceDetectMSR01(msr_score, msr_nms, msr_top_k, msr_scale);
+    s_mnp01 = new (std::nothrow) HumanFaceDetectMNP01(mnp_score, mnp_nms, mnp_top_k);
+    if (!s_msr01 || !s_mnp01)
+    {
+        ESP_LOGE(TAG, "Failed to allocate the detectors");
+        delete s_msr01;
+        delete s_mnp01;
+        s_msr01 = NULL;
+        s_mnp01 = NULL;
+        return false;
+    }
+    if (mnp_top_k > WHO_DETECT_MAX_FACES)
+        ESP_LOGW(TAG, "MNP01 keeps %d faces, only %d are returned", mnp_top_k, WHO_DETECT_MAX_FACES);
+    return true;
+}
+
+float who_detect_resize_scale(void)
+{
+    return s_resize_scale;
+}
+
+int who_detect_msr_shift(void)
+{
+    return s_msr_shift;
+}
+
+void who_detect_set_policy(int top_k, int floor_percent, int reuse_passes, int reuse_iou_percent)
+{
+    s_top_k = top_k;
+    s_floor = floor_percent / 100.0f;
+    s_reuse_passes = reuse_passes;
+    s_reuse_iou_percent = reuse_iou_percent;
+    s_previous_count = 0;
+}
+
+static void copy_face(const dl::detect::result_t &res, who_face_t *face)
+{
+    face->category = res.category;
+    face->score = res.score;
+    memset(face->box, 0, sizeof(face->box));
+    memset(face->keypoint, 0, sizeof(face->keypoint));
+    memcpy(face->box, res.box.data(), std::min(res.box.size(), (size_t)4) * sizeof(int));
+    memcpy(face->keypoint, res.keypoint.data(), std::min(res.keypoint.size(), (size_t)WHO_FACE_KEYPOINTS) * sizeof(int));
+}
+
+static int iou_percent(const int *a, const int *b)
+{
+    int ix = std::min(a[2], b[2]) - std::max(a[0], b[0]);
+    int iy = std::min(a[3], b[3]) - std::max(a[1], b[1]);
+    if (ix <= 0 || iy <= 0)
+        return 0;
+    int inter = ix * iy;
+    int uni = (a[2] - a[0]) * (a[3] - a[1]) + (b[2] - b[0]) * (b[3] - b[1]) - inter;
+    return uni > 0 ? inter * 100 / uni : 0;
+}
+
+static void offset_box(const int *box, int dx, int dy, int *out)
+{
+    out[0] = box[0] + dx;
+    out[1] = box[1] + dy;
+    out[2] = box[2] + dx;
+    out[3] = box[3] + dy;
+}
+
+// Previous face whose candidate box overlaps this one enough to skip MNP01.
+static previous_t *find_reusable(const int *candidate)
+{
+    previous_t *best = NULL;
+    int best_iou = s_reuse_iou_percent - 1;
+    for (int i = 0; i < s_previous_count; i++)
+    {
+        previous_t *p = &s_previous[i];
+        if (p->age >= s_reuse_passes)
+            continue;
+        int iou = iou_percent(candidate, p->candidate);
+        if (iou > best_iou)
+        {
+            best_iou = iou;
+            best = p;
+        }
+    }
+    return best;
+}
+
+int who_detect_run(const uint16_t *image, who_shape_t shape, who_faces_t *faces, int origin_x, int origin_y,
+                   const uint16_t *msr_image)
+{
+    faces->count = 0;
+    if (!s_msr01 || (s_msr_shift && !msr_image))
+        return 0;
+
+    // The prebuilt models take the shape as a std::vector by value and keep
+    // their results in an internal list; past this call nothing on the
+    // pipeline side touches the heap.
+    uint16_t *input = (uint16_t *)image;
+    uint16_t *msr_input = s_msr_shift ? (uint16_t *)msr_image : input;
+    int64_t start = esp_timer_get_time();
+    std::list<dl::detect::result_t> &candidates =
+        s_msr01->infer(msr_input, {shape.height >> s_msr_shift, shape.width >> s_msr_shift, shape.channel});
+    who_stats_record(WHO_STAGE_DETECT_MSR01, esp_timer_get_time() - start);
+    s_stats.runs++;
+    // Back to image coordinates, MNP01 refines on the image itself.
+    if (s_msr_shift)
+    {
+        for (dl::detect::result_t &c : candidates)
+            for (int &v : c.box)
+                v <<= s_msr_shift;
+    }
+
+    // Faces that cannot be there at this mounting height.
+    if (s_min_face > 0 || s_max_face > 0)
+    {
+        candidates.remove_if([](const dl::detect::result_t &c) {
+            int side = std::max(c.box[2] - c.box[0], c.box[3] - c.box[1]);
+            bool out = side < s_min_face || (s_max_face > 0 && side > s_max_face);
+            if (out)
+                s_stats.out_of_range++;
+            return out;
+        });
+    }
+
+    // Policy: the strongest top_k candidates, none at all below the floor.
+    if (s_top_k > 0 && (int)candidates.size() > s_top_k)
+    {
+        candidates.sort([](const dl::detect::result_t &a, const dl::detect::result_t &b) { return a.score > b.score; });
+        s_stats.capped += candidates.size() - s_top_k;
+        candidates.resize(s_top_k);
+    }
+    float best_score = 0.0f;
+    for (const dl::detect::result_t &c : candidates)
+        best_score = std::max(best_score, c.score);
+    if (candidates.empty() || best_score < s_floor)
+    {
+        if (!candidates.empty())
+            s_stats.below_floor++;
+        s_previous_count = 0;
+        return 0;
+    }
+
+    // A candidate sitting where the last pass refined one gets that face
+    // back, moved along with the box; MNP01 only sees the rest.
+    previous_t next[WHO_DETECT_MAX_FACES];
+    int next_count = 0;
+    for (auto it = candidates.begin(); s_reuse_passes > 0 && it != candidates.end();)
+    {
+        int candidate[4];
+        offset_box(it->box.data(), origin_x, origin_y, candidate);
+        previous_t *p = find_reusable(candidate);
+        if (!p || faces->count == WHO_DETECT_MAX_FACES)
+        {
+            ++it;
+            continue;
+        }
+
+        int dx = (candidate[0] + candidate[2] - p->candidate[0] - p->candidate[2]) / 2;
+        int dy = (candidate[1] + candidate[3] - p->candidate[1] - p->candidate[3]) / 2;
+        previous_t *n = &next[next_count++];
+        memcpy(n->candidate, candidate, sizeof(candidate));
+        n->face = p->face;
+        n->age = p->age + 1;
+        offset_box(p->face.box, dx, dy, n->face.box);
+        for (int k = 0; k < WHO_FACE_KEYPOINTS; k += 2)
+        {
+            n->face.keypoint[k] += dx;
+            n->face.keypoint[k + 1] += dy;
+        }
+        p->age = s_reuse_passes;   // one candidate per previous face
+
+        who_face_t *face = &faces->face[faces->count++];
+        *face = n->face;
+        offset_box(n->face.box, -origin_x, -origin_y, face->box);
+        for (int k = 0; k < WHO_FACE_KEYPOINTS; k += 2)
+        {
+            face->keypoint[k] -= origin_x;
+            face->keypoint[k + 1] -= origin_y;
+        }
+        s_stats.reused++;
+        it = candidates.erase(it);
+    }
+
+    if (candidates.empty())
+    {
+        s_stats.mnp01_skipped++;
+    }
+    else
+    {
+        int64_t mnp01_start = esp_timer_get_time();
+        std::list<dl::detect::result_t> &results = s_mnp01->infer(input, {shape.height, shape.width, shape.channel}, candidates);
+        who_stats_record(WHO_STAGE_DETECT_MNP01, esp_timer_get_time() - mnp01_start);
+        s_stats.mnp01_runs++;
+
+        for (const dl::detect::result_t &res : results)
+        {
+            if (faces->count == WHO_DETECT_MAX_FACES)
+            {
+                s_stats.truncated++;
+                continue;
+            }
+            who_face_t *face = &faces->face[faces->count++];
+            copy_face(res, face);
+
+            // Remember it with the candidate it most likely came from.
+            previous_t *n = &next[next_count++];
+            n->face = *face;
+            n->age = 0;
+            offset_box(face->box, origin_x, origin_y, n->face.box);
+            for (int k = 0; k < WHO_FACE_KEYPOINTS; k += 2)
+            {
+                n->face.keypoint[k] += origin_x;
+                n->face.keypoint[k + 1] += origin_y;
+            }
+            const dl::detect::result_t *source = NULL;
+            int source_iou = -1;
+            for (const dl::detect::result_t &c : candidates)
+            {
+                int iou = iou_percent(c.box.data(), face->box);
+                if (iou > source_iou)
+                {
+                    source_iou = iou;
+                    source = &c;
+                }
+            }
+            offset_box(source ? source->box.data() : face->box, origin_x, origin_y, n->candidate);
+        }
+    }
+
+    memcpy(s_previous, next, next_count * sizeof(previous_t));
+    s_previous_count = next_count;
+    s_stats.faces += faces->count;
+    return faces->count;
+}
+
+void who_detect_get_stats(who_detect_stats_t *stats)
+{
+    *stats = s_stats;
+}
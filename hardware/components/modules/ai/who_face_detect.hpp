@@ -0,0 +1,122 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define WHO_DETECT_MAX_FACES 10     // MNP01 top_k
+#define WHO_FACE_KEYPOINTS 10       // 5 [x, y] pairs
+
+/**
+ * @brief Image shape handed to the detectors.
+ */
+typedef struct
+{
+    int height;
+    int width;
+    int channel;
+} who_shape_t;
+
+/**
+ * @brief One detected face, in the layout of dl::detect::result_t without
+ *        the heap-backed vectors.
+ */
+typedef struct
+{
+    int category;                       /*<! category index */
+    float score;                        /*<! score of box */
+    int box[4];                         /*<! [left_up_x, left_up_y, right_down_x, right_down_y] */
+    int keypoint[WHO_FACE_KEYPOINTS];   /*<! left eye, left mouth corner, nose, right eye, right mouth corner */
+} who_face_t;
+
+/**
+ * @brief Caller-owned detection result, reused frame after frame.
+ */
+typedef struct
+{
+    int count;                              /*<! faces filled in */
+    who_face_t face[WHO_DETECT_MAX_FACES];
+} who_faces_t;
+
+/**
+ * @brief Detector counters.
+ */
+typedef struct
+{
+    uint32_t runs;          /*<! MSR01 passes */
+    uint32_t mnp01_runs;    /*<! MNP01 passes */
+    uint32_t mnp01_skipped; /*<! passes where every candidate reused an earlier face */
+    uint32_t below_floor;   /*<! passes whose candidates all scored below the floor */
+    uint32_t capped;        /*<! candidates beyond the top-k, not refined */
+    uint32_t out_of_range;  /*<! candidates outside the face size range, not refined */
+    uint32_t reused;        /*<! faces taken over from the previous pass without MNP01 */
+    uint32_t faces;         /*<! faces returned */
+    uint32_t truncated;     /*<! faces beyond WHO_DETECT_MAX_FACES, dropped */
+} who_detect_stats_t;
+
+/**
+ * @brief Create the MSR01 candidate detector and the MNP01 refiner, once.
+ *
+ * The MSR01 input scale follows from the smallest face of interest, so no
+ * finer resolution than that face needs is computed. Candidates outside
+ * [min_face, max_face] are dropped before MNP01. With max_shift, MSR01 runs
+ * on the coarsest pyramid level at or above that scale and only resizes the
+ * rest of the way itself.
+ *
+ * @param msr_score      MSR01 score threshold
+ * @param msr_nms        MSR01 NMS threshold
+ * @param msr_top_k      MSR01 candidates kept
+ * @param min_face       smallest face side of interest in frame pixels, 0 = full resolution
+ * @param max_face       largest face side of interest in frame pixels, 0 = no limit
+ * @param mnp_score      MNP01 score threshold
+ * @param mnp_nms        MNP01 NMS threshold
+ * @param mnp_top_k      MNP01 faces kept
+ * @param max_shift      coarsest pyramid level MSR01 may be fed, 0 = the image
+ * @return false when the detectors cannot be allocated
+ */
+bool who_detect_init(float msr_score, float msr_nms, int msr_top_k, int min_face, int max_face,
+                     float mnp_score, float mnp_nms, int mnp_top_k, int max_shift = 0);
+
+/**
+ * @brief MSR01 resize scale picked by who_detect_init().
+ */
+float who_detect_resize_scale(void);
+
+/**
+ * @brief Pyramid level who_detect_run() wants for MSR01, 0 for the image.
+ */
+int who_detect_msr_shift(void);
+
+/**
+ * @brief Set the cascade policy between MSR01 and MNP01.
+ *
+ * @param top_k             refine only the best top_k MSR01 candidates, 0 = all
+ * @param floor_percent     skip MNP01, and report no face, when no candidate
+ *                          scores at least this, in percent
+ * @param reuse_passes      a candidate overlapping one refined in the previous
+ *                          pass reuses that face, moved along with the box,
+ *                          for up to this many passes in a row; 0 = never
+ * @param reuse_iou_percent box overlap a candidate needs for the reuse
+ */
+void who_detect_set_policy(int top_k, int floor_percent, int reuse_passes, int reuse_iou_percent);
+
+/**
+ * @brief Run the two-stage detector on an RGB565 image and copy the faces
+ *        into a fixed-capacity result. MSR01 and MNP01 times go into the
+ *        pipeline stats.
+ *
+ * @param image    RGB565 image
+ * @param shape    image shape, channel 3
+ * @param faces    output in image coordinates, overwritten
+ * @param origin_x column of the image in the frame, when it is a crop
+ * @param origin_y row of the image in the frame
+ * @param msr_image the image at 1/2^who_detect_msr_shift() of its size, for
+ *                  MSR01; ignored at shift 0
+ * @return number of faces, faces->count
+ */
+int who_detect_run(const uint16_t *image, who_shape_t shape, who_faces_t *faces, int origin_x = 0, int origin_y = 0,
+                   const uint16_t *msr_image = NULL);
+
+/**
+ * @brief Get a copy of the counters.
+ */
+void who_detect_get_stats(who_detect_stats_t *stats);
@@ -0,0 +1,301 @@
+#include "who_face_gallery.hpp"
+
+#include <math.h>
+#include <string.h>
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+
+static const char *TAG = "face_gallery";
+
+typedef struct
+{
+    int id;             /*<! -1 for an empty slot */
+    int64_t last_seen_us;
+    float scale;        /*<! value of one int8 step of the stored row */
+} gallery_entry_t;
+
+static int8_t *s_embeddings = NULL;    // capacity x dim, row per slot
+static gallery_entry_t *s_entries = NULL;
+static int8_t *s_query = NULL;         // dim, quantized lookup embedding
+static float s_query_scale = 0.0f;
+static int s_capacity = 0;
+static int s_dim = 0;
+static int64_t s_ttl_us = 0;
+static int s_next_id = 1;
+
+#if CONFIG_WHO_GALLERY_COMPARE_FLOAT
+static float *s_reference = NULL;      // capacity x dim, float rows to check the int8 path against
+#endif
+
+static who_gallery_stats_t s_stats = {};
+
+static void free_buffers(void)
+{
+    heap_caps_free(s_embeddings);
+    heap_caps_free(s_entries);
+    heap_caps_free(s_query);
+    s_embeddings = NULL;
+    s_entries = NULL;
+    s_query = NULL;
+#if CONFIG_WHO_GALLERY_COMPARE_FLOAT
+    heap_caps_free(s_reference);
+    s_reference = NULL;
+#endif
+    s_capacity = 0;
+}
+
+bool who_gallery_init(int capacity, int dim, int64_t ttl_us)
+{
+    free_buffers();
+
+    size_t emb_size = (size_t)capacity * dim;
+    s_embeddings = (int8_t *)heap_caps_malloc(emb_size, MALLOC_CAP_SPIRAM);
+    if (!s_embeddings)
+        s_embeddings = (int8_t *)heap_caps_malloc(emb_size, MALLOC_CAP_8BIT);
+    s_entries = (gallery_entry_t *)heap_caps_malloc(capacity * sizeof(gallery_entry_t), MALLOC_CAP_8BIT);
+    s_query = (int8_t *)heap_caps_malloc(dim, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    bool ok = s_embeddings && s_entries && s_query;
+#if CONFIG_WHO_GALLERY_COMPARE_FLOAT
+    s_reference = (float *)heap_caps_malloc(emb_size * sizeof(float), MALLOC_CAP_SPIRAM);
+    if (!s_reference)
+        s_reference = (float *)heap_caps_malloc(emb_size * sizeof(float), MALLOC_CAP_8BIT);
+    ok = ok && s_reference;
+#endif
+    if (!ok)
+    {
+        ESP_LOGE(TAG, "Failed to allocate gallery of %d x %d", capacity, dim);
+        free_buffers();
+        return false;
+    }
+
+    s_capacity = capacity;
+    s_dim = dim;
+    s_ttl_us = ttl_us;
+    s_next_id = 1;
+    for (int i = 0; i < capacity; i++)
+        s_entries[i].id = -1;
+    memset(&s_stats, 0, sizeof(s_stats));
+    ESP_LOGI(TAG, "Gallery of %d x %d int8 (%u bytes)", capacity, dim, (unsigned)(emb_size + capacity * sizeof(gallery_entry_t)));
+    return true;
+}
+
+static bool is_expired(const gallery_entry_t *e, int64_t now_us)
+{
+    return s_ttl_us > 0 && now_us - e->last_seen_us > s_ttl_us;
+}
+
+/**
+ * L2-normalize and quantize with a per-vector scale: the largest component
+ * maps to +-127. Returns the scale, 0 for a zero vector.
+ */
+static float quantize(const float *embedding, int8_t *out)
+{
+    float norm = 0.0f;
+    float peak = 0.0f;
+    for (int i = 0; i < s_dim; i++)
+    {
+        norm += embedding[i] * embedding[i];
+        peak = fmaxf(peak, fabsf(embedding[i]));
+    }
+    if (norm <= 0.0f || peak <= 0.0f)
+    {
+        memset(out, 0, s_dim);
+        return 0.0f;
+    }
+
+    float inv = 127.0f / peak;
+    for (int i = 0; i < s_dim; i++)
+        out[i] = (int8_t)lrintf(embedding[i] * inv);
+    return peak / (127.0f * sqrtf(norm));
+}
+
+// int8 x int8 MACs into int32, |sum| <= dim * 127 * 127 fits easily.
+static int32_t dot_s8(const int8_t *a, const int8_t *b, int n)
+{
+    int32_t acc = 0;
+    for (int i = 0; i < n; i++)
+        acc += (int16_t)a[i] * b[i];
+    return acc;
+}
+
+#if CONFIG_WHO_GALLERY_COMPARE_FLOAT
+// Same lookup on the float rows, the way it was done before quantization.
+static void compare_float(const float *embedding, float threshold, int64_t now_us, int slot, float similarity)
+{
+    float norm = 0.0f;
+    for (int i = 0; i < s_dim; i++)
+        norm += embedding[i] * embedding[i];
+    norm = norm > 0.0f ? 1.0f / sqrtf(norm) : 0.0f;
+
+    int best = -1;
+    float best_sim = -2.0f;
+    float max_error = 0.0f;
+    const float *row = s_reference;
+    for (int i = 0; i < s_capacity; i++, row += s_dim)
+    {
+        const gallery_entry_t *e = &s_entries[i];
+        if (e->id < 0 || is_expired(e, now_us))
+            continue;
+
+        float dot = 0.0f;
+        for (int j = 0; j < s_dim; j++)
+            dot += embedding[j] * row[j];
+        dot *= norm;
+
+        float sim_s8 = dot_s8(s_query, s_embeddings + (size_t)i * s_dim, s_dim) * s_query_scale * e->scale;
+        max_error = fmaxf(max_error, fabsf(sim_s8 - dot));
+        if (dot > best_sim)
+        {
+            best_sim = dot;
+            best = i;
+        }
+    }
+    if (best < 0)
+        return;
+
+    s_stats.compared++;
+    s_stats.max_error = fmaxf(s_stats.max_error, max_error);
+    bool float_match = best_sim >= threshold;
+    if (float_match != (slot >= 0) || (float_match && best != slot))
+    {
+        s_stats.mismatches++;
+        ESP_LOGW(TAG, "int8 lookup disagrees: slot %d (%.3f) vs float slot %d (%.3f)", slot, similarity, best, best_sim);
+    }
+}
+#endif
+
+int who_gallery_find(const float *embedding, float threshold, int64_t now_us, float *similarity)
+{
+    s_query_scale = quantize(embedding, s_query);
+
+    // Rank on dot * row scale, the query scale is common to all rows.
+    int best = -1;
+    float best_score = -1e30f;
+    const int8_t *row = s_embeddings;
+    for (int slot = 0; slot < s_capacity; slot++, row += s_dim)
+    {
+        const gallery_entry_t *e = &s_entries[slot];
+        if (e->id < 0 || is_expired(e, now_us))
+            continue;
+
+        float score = dot_s8(s_query, row, s_dim) * e->scale;
+        if (score > best_score)
+        {
+            best_score = score;
+            best = slot;
+        }
+    }
+
+    *similarity = best >= 0 ? best_score * s_query_scale : -1.0f;
+    int match = best >= 0 && *similarity >= threshold ? best : -1;
+#if CONFIG_WHO_GALLERY_COMPARE_FLOAT
+    compare_float(embedding, threshold, now_us, match, *similarity);
+#endif
+    return match;
+}
+
+void who_gallery_touch(int slot, int64_t now_us)
+{
+    if (slot < 0 || slot >= s_capacity || s_entries[slot].id < 0)
+        return;
+    s_entries[slot].last_seen_us = now_us;
+    s_stats.hits++;
+}
+
+int who_gallery_add(const float *embedding, int64_t now_us, int id)
+{
+    if (!s_capacity)
+        return -1;
+
+    // Prefer an empty slot, then an expired one, then the least recently seen.
+    int victim = -1;
+    for (int slot = 0; slot < s_capacity && victim < 0; slot++)
+    {
+        if (s_entries[slot].id < 0)
+            victim = slot;
+    }
+    if (victim < 0)
+    {
+        victim = 0;
+        for (int slot = 1; slot < s_capacity; slot++)
+        {
+            if (s_entries[slot].last_seen_us < s_entries[victim].last_seen_us)
+                victim = slot;
+        }
+        if (is_expired(&s_entries[victim], now_us))
+            s_stats.evicted_ttl++;
+        else
+            s_stats.evicted_lru++;
+        s_stats.size--;
+    }
+
+    s_entries[victim].scale = quantize(embedding, s_embeddings + (size_t)victim * s_dim);
+#if CONFIG_WHO_GALLERY_COMPARE_FLOAT
+    float norm = 0.0f;
+    for (int i = 0; i < s_dim; i++)
+        norm += embedding[i] * embedding[i];
+    norm = norm > 0.0f ? 1.0f / sqrtf(norm) : 0.0f;
+    float *ref = s_reference + (size_t)victim * s_dim;
+    for (int i = 0; i < s_dim; i++)
+        ref[i] = embedding[i] * norm;
+#endif
+
+    if (id < 0)
+    {
+        id = s_next_id;
+        s_stats.misses++;
+    }
+    if (id >= s_next_id)
+        s_next_id = id + 1;
+
+    s_entries[victim].id = id;
+    s_entries[victim].last_seen_us = now_us;
+    s_stats.size++;
+    return id;
+}
+
+bool who_gallery_get(int slot, int *id, float *embedding)
+{
+    if (slot < 0 || slot >= s_capacity || s_entries[slot].id < 0)
+        return false;
+    if (id)
+        *id = s_entries[slot].id;
+    if (embedding)
+    {
+        const int8_t *row = s_embeddings + (size_t)slot * s_dim;
+        float scale = s_entries[slot].scale;
+        for (int i = 0; i < s_dim; i++)
+            embedding[i] = row[i] * scale;
+    }
+    return true;
+}
+
+bool who_gallery_get_age(int slot, int64_t now_us, int64_t *age_us)
+{
+    if (slot < 0 || slot >= s_capacity || s_entries[slot].id < 0 || is_expired(&s_entries[slot], now_us))
+        return false;
+    *age_us = now_us - s_entries[slot].last_seen_us;
+    return true;
+}
+
+int who_gallery_next_id(void)
+{
+    return s_next_id;
+}
+
+void who_gallery_reserve_ids(int next_id)
+{
+    if (next_id > s_next_id)
+        s_next_id = next_id;
+}
+
+int who_gallery_capacity(void)
+{
+    return s_capacity;
+}
+
+void who_gallery_get_stats(who_gallery_stats_t *stats)
+{
+    *stats = s_stats;
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * @brief Gallery counters.
+ */
+typedef struct
+{
+    uint32_t size;          /*<! live entries */
+    uint32_t hits;          /*<! lookups matching an entry */
+    uint32_t misses;        /*<! lookups without a match, i.e. new passengers */
+    uint32_t evicted_lru;   /*<! entries replaced because the gallery was full */
+    uint32_t evicted_ttl;   /*<! entries replaced after the TTL ran out */
+    uint32_t compared;      /*<! lookups checked against the float path, CONFIG_WHO_GALLERY_COMPARE_FLOAT only */
+    uint32_t mismatches;    /*<! of those, lookups where int8 and float disagree on the match */
+    float max_error;        /*<! largest int8 vs float similarity difference seen */
+} who_gallery_stats_t;
+
+/**
+ * @brief Allocate the gallery: one contiguous block of capacity x dim int8,
+ *        each row quantized with its own scale.
+ *
+ * @param capacity  number of embeddings kept
+ * @param dim       embedding length
+ * @param ttl_us    entries not seen for this long no longer match, 0 = never expire
+ * @return false when the block cannot be allocated
+ */
+bool who_gallery_init(int capacity, int dim, int64_t ttl_us);
+
+/**
+ * @brief Find the most similar live entry by cosine similarity, computed with
+ *        an int8 dot product on the quantized embeddings.
+ *
+ * @param embedding  embedding of dim floats
+ * @param threshold  similarity an entry needs to match
+ * @param now_us     current esp_timer time, for the TTL
+ * @param similarity output similarity of the best entry, -1 when the gallery is empty
+ * @return slot of the best entry, -1 when it is below threshold
+ */
+int who_gallery_find(const float *embedding, float threshold, int64_t now_us, float *similarity);
+
+/**
+ * @brief Mark an entry as seen, moving it to the back of the LRU order.
+ */
+void who_gallery_touch(int slot, int64_t now_us);
+
+/**
+ * @brief Store a new embedding, replacing an empty, expired or the least
+ *        recently seen entry. The copy is L2-normalized and quantized.
+ *
+ * @param embedding embedding of dim floats
+ * @param now_us    current esp_timer time
+ * @param id        ID to store it under (restoring a saved gallery), -1 to
+ *                  assign the next free one and count a new passenger
+ * @return ID of the entry, -1 when the gallery is not allocated
+ */
+int who_gallery_add(const float *embedding, int64_t now_us, int id = -1);
+
+/**
+ * @brief Get an entry.
+ *
+ * @param slot      slot in [0, capacity)
+ * @param id        output ID, may be NULL
+ * @param embedding output dim floats, the dequantized embedding, may be NULL
+ * @return false when the slot is empty
+ */
+bool who_gallery_get(int slot, int *id, float *embedding);
+
+/**
+ * @brief Time since a live entry was last seen, e.g. to save it with.
+ *
+ * @param slot   slot in [0, capacity)
+ * @param now_us current esp_timer time, for the TTL
+ * @param age_us output age
+ * @return false when the slot is empty or expired
+ */
+bool who_gallery_get_age(int slot, int64_t now_us, int64_t *age_us);
+
+/**
+ * @brief ID the next new passenger gets.
+ */
+int who_gallery_next_id(void);
+
+/**
+ * @brief Never hand out IDs below this one again, e.g. those of passengers
+ *        logged before a reboot whose entries are gone since.
+ */
+void who_gallery_reserve_ids(int next_id);
+
+/**
+ * @brief Number of slots, as given to who_gallery_init().
+ */
+int who_gallery_capacity(void);
+
+/**
+ * @brief Get a copy of the counters.
+ */
+void who_gallery_get_stats(who_gallery_stats_t *stats);
@@ -0,0 +1,137 @@
+#include "who_face_quality.hpp"
+
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+#include "dl_image.hpp"
+
+static float s_min_score = 0.4f;
+static int s_min_face_size = 40;
+static int s_min_eye_distance = 16;
+static int s_max_yaw_percent = 35;
+static int s_min_sharpness = 40;
+
+static who_quality_stats_t s_stats = {};
+
+static const char *s_names[WHO_QUALITY_MAX] = {
+    "ok",
+    "score",
+    "small",
+    "eyes",
+    "yaw",
+    "blur",
+};
+
+// Sample grid of the blur measure, bounds the cost on large faces.
+#define SHARPNESS_GRID 24
+
+void who_quality_init(int min_score_percent, int min_face_size, int min_eye_distance,
+                      int max_yaw_percent, int min_sharpness)
+{
+    s_min_score = min_score_percent / 100.0f;
+    s_min_face_size = min_face_size;
+    s_min_eye_distance = min_eye_distance;
+    s_max_yaw_percent = max_yaw_percent;
+    s_min_sharpness = min_sharpness;
+    memset(&s_stats, 0, sizeof(s_stats));
+}
+
+static inline int gray_at(const uint16_t *frame, int width, int x, int y)
+{
+    return dl::image::convert_pixel_rgb565_to_gray(frame[y * width + x]);
+}
+
+/**
+ * Variance of the 4-neighbour Laplacian over the inner half of the box,
+ * sampled on a SHARPNESS_GRID x SHARPNESS_GRID grid. The inner half keeps
+ * background edges out of the measure.
+ */
+static uint32_t sharpness(const uint16_t *frame, int height, int width, const int *box)
+{
+    int bw = box[2] - box[0];
+    int bh = box[3] - box[1];
+    int x0 = std::max(1, box[0] + bw / 4);
+    int y0 = std::max(1, box[1] + bh / 4);
+    int x1 = std::min(width - 1, box[2] - bw / 4);
+    int y1 = std::min(height - 1, box[3] - bh / 4);
+    if (x1 <= x0 || y1 <= y0)
+        return 0;
+
+    int step_x = std::max(1, (x1 - x0) / SHARPNESS_GRID);
+    int step_y = std::max(1, (y1 - y0) / SHARPNESS_GRID);
+    int64_t sum = 0;
+    int64_t sum_sq = 0;
+    int n = 0;
+    for (int y = y0; y < y1; y += step_y)
+    {
+        for (int x = x0; x < x1; x += step_x)
+        {
+            int lap = 4 * gray_at(frame, width, x, y) -
+                      gray_at(frame, width, x - 1, y) - gray_at(frame, width, x + 1, y) -
+                      gray_at(frame, width, x, y - 1) - gray_at(frame, width, x, y + 1);
+            sum += lap;
+            sum_sq += lap * lap;
+            n++;
+        }
+    }
+    int64_t mean = sum / n;
+    return (uint32_t)(sum_sq / n - mean * mean);
+}
+
+static who_quality_t score(const uint16_t *frame, int height, int width, const who_face_t &face)
+{
+    if (face.score < s_min_score)
+        return WHO_QUALITY_LOW_SCORE;
+
+    if (std::min(face.box[2] - face.box[0], face.box[3] - face.box[1]) < s_min_face_size)
+        return WHO_QUALITY_TOO_SMALL;
+
+    // keypoint: left eye, left mouth corner, nose, right eye, right mouth corner
+    int eye_dx = face.keypoint[6] - face.keypoint[0];
+    int eye_dy = face.keypoint[7] - face.keypoint[1];
+    int eye_distance_sq = eye_dx * eye_dx + eye_dy * eye_dy;
+    if (eye_distance_sq < s_min_eye_distance * s_min_eye_distance)
+        return WHO_QUALITY_EYES_TOO_CLOSE;
+
+    // Yaw proxy: the nose drifts towards one eye as the head turns.
+    int eye_mid_x = (face.keypoint[0] + face.keypoint[6]) / 2;
+    int nose_offset = abs(face.keypoint[4] - eye_mid_x);
+    if (nose_offset * 100 > abs(eye_dx) * s_max_yaw_percent)
+        return WHO_QUALITY_YAW;
+
+    if (s_min_sharpness > 0)
+    {
+        s_stats.last_sharpness = sharpness(frame, height, width, face.box);
+        if ((int)s_stats.last_sharpness < s_min_sharpness)
+            return WHO_QUALITY_BLUR;
+    }
+    return WHO_QUALITY_OK;
+}
+
+who_quality_t who_quality_check(const uint16_t *frame, int height, int width, const who_face_t &face)
+{
+    who_quality_t reason = score(frame, height, width, face);
+    s_stats.checked++;
+    s_stats.outcomes[reason]++;
+    return reason;
+}
+
+float who_quality_weight(const who_face_t &face)
+{
+    int eye_dx = abs(face.keypoint[6] - face.keypoint[0]);
+    int eye_mid_x = (face.keypoint[0] + face.keypoint[6]) / 2;
+    int nose_offset = abs(face.keypoint[4] - eye_mid_x);
+    float frontal = eye_dx > 0 ? 1.0f - 2.0f * nose_offset / eye_dx : 0.0f;
+    return std::max(0.1f, std::min(1.0f, face.score) * std::max(0.1f, frontal));
+}
+
+const char *who_quality_name(who_quality_t reason)
+{
+    return reason < WHO_QUALITY_MAX ? s_names[reason] : "?";
+}
+
+void who_quality_get_stats(who_quality_stats_t *stats)
+{
+    *stats = s_stats;
+}
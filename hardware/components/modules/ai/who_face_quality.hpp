@@ -0,0 +1,72 @@
+#pragma once
+
+#include <stdint.h>
+#include "who_face_detect.hpp"
+
+/**
+ * @brief Outcome of the quality gate, the first failed check wins.
+ */
+typedef enum
+{
+    WHO_QUALITY_OK = 0,
+    WHO_QUALITY_LOW_SCORE,      /*<! detection score below threshold */
+    WHO_QUALITY_TOO_SMALL,      /*<! face box too small */
+    WHO_QUALITY_EYES_TOO_CLOSE, /*<! eye distance too small, face too far or tilted away */
+    WHO_QUALITY_YAW,            /*<! nose too far off the eye midpoint, profile face */
+    WHO_QUALITY_BLUR,           /*<! Laplacian variance too low */
+    WHO_QUALITY_MAX,
+} who_quality_t;
+
+/**
+ * @brief Quality gate counters.
+ */
+typedef struct
+{
+    uint32_t checked;                       /*<! faces scored */
+    uint32_t outcomes[WHO_QUALITY_MAX];     /*<! faces per outcome, [WHO_QUALITY_OK] are the passed ones */
+    uint32_t last_sharpness;                /*<! Laplacian variance of the last face that got that far */
+} who_quality_stats_t;
+
+/**
+ * @brief Set the gate thresholds.
+ *
+ * @param min_score_percent  minimum detection score, in percent
+ * @param min_face_size      minimum face box side, in pixels
+ * @param min_eye_distance   minimum distance between the eyes, in pixels
+ * @param max_yaw_percent    maximum horizontal nose offset from the eye
+ *                           midpoint, in percent of the eye distance
+ * @param min_sharpness      minimum Laplacian variance of the face, 0 disables
+ *                           the blur check
+ */
+void who_quality_init(int min_score_percent, int min_face_size, int min_eye_distance,
+                      int max_yaw_percent, int min_sharpness);
+
+/**
+ * @brief Score a detected face, cheapest checks first.
+ *
+ * @param frame  RGB565 frame the face was found in
+ * @param height frame height
+ * @param width  frame width
+ * @param face   detection result with box and 5 keypoints, in frame coordinates
+ * @return WHO_QUALITY_OK when the face is worth recognizing
+ */
+who_quality_t who_quality_check(const uint16_t *frame, int height, int width, const who_face_t &face);
+
+/**
+ * @brief Weight of a face in a track's mean embedding: detection score
+ *        times frontalness, from 1 for a centred nose down to 0.1.
+ *
+ * @param face detection result with 5 keypoints
+ * @return weight in (0, 1]
+ */
+float who_quality_weight(const who_face_t &face);
+
+/**
+ * @brief Name of a reason, for logging.
+ */
+const char *who_quality_name(who_quality_t reason);
+
+/**
+ * @brief Get a copy of the counters.
+ */
+void who_quality_get_stats(who_quality_stats_t *stats);
@@ -0,0 +1,124 @@
+#include "who_face_ring.hpp"
+
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "dl_tool.hpp"
+
+static const char *TAG = "face_ring";
+
+static who_face_slot_t *s_slots = NULL;
+static uint32_t s_size = 0;
+static int s_batch = 0;
+
+// Free-running counters, slot = index % s_size. The producer only writes
+// s_head, the consumer only writes s_tail.
+static std::atomic<uint32_t> s_head(0);
+static std::atomic<uint32_t> s_tail(0);
+
+static TaskHandle_t s_consumer = NULL;
+static uint32_t s_dropped = 0;
+static uint32_t s_faces = 0;
+
+bool who_face_ring_init(int slots, int batch, const std::vector<int> &face_shape)
+{
+    delete[] s_slots;
+    s_slots = new who_face_slot_t[slots];
+    s_size = slots;
+    s_batch = std::min(batch, WHO_FACE_BATCH_MAX);
+    s_head.store(0);
+    s_tail.store(0);
+    s_dropped = 0;
+    s_faces = 0;
+
+    size_t total = 0, psram = 0;
+    for (int i = 0; i < slots; i++)
+    {
+        s_slots[i].count = 0;
+        for (int f = 0; f < s_batch; f++)
+        {
+            // Not calloc_element(): it reports success with a NULL element
+            // when the allocation fails, after zeroing through it. PSRAM
+            // first, MFN reads the face once into its own input copy.
+            dl::Tensor<uint8_t> &face = s_slots[i].face[f];
+            face.set_shape(face_shape);
+            uint8_t *element = (uint8_t *)heap_caps_aligned_alloc(16, face.get_size(), MALLOC_CAP_SPIRAM);
+            if (element)
+                psram += face.get_size();
+            else
+                element = (uint8_t *)dl::tool::malloc_aligned_prefer(face.get_size(), sizeof(uint8_t), 16);
+            if (!element)
+            {
+                ESP_LOGE(TAG, "Failed to allocate %d slots of %d faces", slots, s_batch);
+                // The faces allocated so far go with their tensors.
+                delete[] s_slots;
+                s_slots = NULL;
+                s_size = 0;
+                s_batch = 0;
+                return false;
+            }
+            memset(element, 0, face.get_size());
+            face.set_element(element, true);
+            total += face.get_size();
+        }
+    }
+    ESP_LOGI(TAG, "%d slots of %d faces: %u KB, %u KB of it in PSRAM", slots, s_batch, (unsigned)(total / 1024),
+             (unsigned)(psram / 1024));
+    return true;
+}
+
+int who_face_ring_batch(void)
+{
+    return s_batch;
+}
+
+void who_face_ring_set_consumer(TaskHandle_t task)
+{
+    s_consumer = task;
+}
+
+who_face_slot_t *who_face_ring_acquire(void)
+{
+    uint32_t head = s_head.load(std::memory_order_relaxed);
+    if (!s_size || head - s_tail.load(std::memory_order_acquire) >= s_size)
+    {
+        s_dropped++;
+        return NULL;
+    }
+    return &s_slots[head % s_size];
+}
+
+void who_face_ring_publish(void)
+{
+    s_faces += s_slots[s_head.load(std::memory_order_relaxed) % s_size].count;
+    s_head.store(s_head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    if (s_consumer)
+        xTaskNotifyGive(s_consumer);
+}
+
+who_face_slot_t *who_face_ring_peek(TickType_t ticks_to_wait)
+{
+    uint32_t tail = s_tail.load(std::memory_order_relaxed);
+    // Notifications accumulate, one given after the check is not lost.
+    while (s_head.load(std::memory_order_acquire) == tail)
+    {
+        if (!ulTaskNotifyTake(pdTRUE, ticks_to_wait))
+            return NULL;
+    }
+    return &s_slots[tail % s_size];
+}
+
+void who_face_ring_release(void)
+{
+    s_tail.store(s_tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+void who_face_ring_get_stats(who_face_ring_stats_t *stats)
+{
+    stats->published = s_head.load(std::memory_order_relaxed);
+    stats->consumed = s_tail.load(std::memory_order_relaxed);
+    stats->dropped = s_dropped;
+    stats->faces = s_faces;
+}
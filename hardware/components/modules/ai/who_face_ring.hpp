@@ -0,0 +1,93 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "dl_variable.hpp"
+
+#define WHO_FACE_BATCH_MAX 8
+
+/**
+ * @brief The aligned faces of one frame, handed from the detection to the
+ *        recognition stage as a batch.
+ */
+typedef struct
+{
+    dl::Tensor<uint8_t> face[WHO_FACE_BATCH_MAX];   /*<! aligned faces, written in place by the producer */
+    int track_id[WHO_FACE_BATCH_MAX];               /*<! who_track_assign() track of each face */
+    float weight[WHO_FACE_BATCH_MAX];               /*<! share of each face in its track's mean embedding */
+    int count;                  /*<! faces filled in */
+    int64_t frame_us;           /*<! esp_timer time the frame entered the pipeline */
+    int64_t published_us;       /*<! esp_timer time the batch was handed over */
+    uint32_t frame_index;       /*<! frame number of the detection stage */
+} who_face_slot_t;
+
+/**
+ * @brief Ring counters.
+ */
+typedef struct
+{
+    uint32_t published;     /*<! batches handed over */
+    uint32_t consumed;      /*<! batches released by the consumer */
+    uint32_t dropped;       /*<! batches lost because every slot was in use */
+    uint32_t faces;         /*<! faces in the published batches */
+} who_face_ring_stats_t;
+
+/**
+ * @brief Allocate the ring, every slot holding a batch of face tensors of
+ *        the given shape, PSRAM first: 37 KB per 112x112 face, 300 KB for
+ *        2 slots of 4.
+ *
+ * Single producer, single consumer: who_face_ring_acquire() and
+ * who_face_ring_publish() must only be called from one task,
+ * who_face_ring_peek() and who_face_ring_release() from one other task.
+ * The slots are handed over through two atomic indices, no lock is taken.
+ *
+ * @param slots      number of batches in flight
+ * @param batch      faces per slot, at most WHO_FACE_BATCH_MAX
+ * @param face_shape shape of the face tensor, e.g. {112, 112, 3}
+ * @return false when the slots cannot be allocated
+ */
+bool who_face_ring_init(int slots, int batch, const std::vector<int> &face_shape);
+
+/**
+ * @brief Faces per slot, as given to who_face_ring_init().
+ */
+int who_face_ring_batch(void);
+
+/**
+ * @brief Set the task woken by who_face_ring_publish(), i.e. the consumer.
+ */
+void who_face_ring_set_consumer(TaskHandle_t task);
+
+/**
+ * @brief Producer: get the next free slot to fill.
+ *
+ * @return slot, NULL when the consumer is behind and every slot is in use
+ *         (counted as a drop)
+ */
+who_face_slot_t *who_face_ring_acquire(void);
+
+/**
+ * @brief Producer: hand the slot returned by who_face_ring_acquire() over.
+ */
+void who_face_ring_publish(void);
+
+/**
+ * @brief Consumer: wait for the oldest published slot.
+ *
+ * @param ticks_to_wait how long to wait for the producer
+ * @return slot, NULL on timeout. It stays valid until who_face_ring_release().
+ */
+who_face_slot_t *who_face_ring_peek(TickType_t ticks_to_wait);
+
+/**
+ * @brief Consumer: give the slot returned by who_face_ring_peek() back.
+ */
+void who_face_ring_release(void);
+
+/**
+ * @brief Get a copy of the counters.
+ */
+void who_face_ring_get_stats(who_face_ring_stats_t *stats);
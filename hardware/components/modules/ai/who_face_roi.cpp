@@ -0,0 +1,147 @@
+#include "who_face_roi.hpp"
+
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+
+static const char *TAG = "face_roi";
+
+static int s_padding_percent = 50;
+static int s_full_frame_every = 10;
+static int s_max_area_percent = 50;
+
+// Union of the face boxes of the last frame, [x0, y0, x1, y1]
+static bool s_tracking = false;
+static int s_box[4] = {0};
+static int s_roi_passes_since_full = 0;
+
+// Crops of the frame and of one pyramid level of it.
+static uint16_t *s_crop[2] = {NULL, NULL};
+static size_t s_crop_capacity[2] = {0, 0};
+
+static who_roi_stats_t s_stats = {};
+
+void who_roi_init(int padding_percent, int full_frame_every, int max_area_percent)
+{
+    s_padding_percent = padding_percent;
+    s_full_frame_every = full_frame_every;
+    s_max_area_percent = max_area_percent;
+    s_tracking = false;
+    s_roi_passes_since_full = 0;
+    memset(&s_stats, 0, sizeof(s_stats));
+}
+
+bool who_roi_select(int height, int width, who_roi_t *roi, int shift)
+{
+    if (!s_tracking || s_roi_passes_since_full >= s_full_frame_every)
+        return false;
+
+    int pad_x = (s_box[2] - s_box[0]) * s_padding_percent / 100;
+    int pad_y = (s_box[3] - s_box[1]) * s_padding_percent / 100;
+    int x0 = std::max(0, s_box[0] - pad_x);
+    int y0 = std::max(0, s_box[1] - pad_y);
+    int x1 = std::min(width, s_box[2] + pad_x);
+    int y1 = std::min(height, s_box[3] + pad_y);
+    if (shift)
+    {
+        int mask = (1 << shift) - 1;
+        x0 &= ~mask;
+        y0 &= ~mask;
+        x1 = std::min(width & ~mask, (x1 + mask) & ~mask);
+        y1 = std::min(height & ~mask, (y1 + mask) & ~mask);
+    }
+
+    if (x1 <= x0 || y1 <= y0 ||
+        (x1 - x0) * (y1 - y0) * 100 > width * height * s_max_area_percent)
+        return false;
+
+    roi->x = x0;
+    roi->y = y0;
+    roi->width = x1 - x0;
+    roi->height = y1 - y0;
+    return true;
+}
+
+uint16_t *who_roi_crop(const uint16_t *frame, int frame_width, const who_roi_t *roi, int shift)
+{
+    int b = shift > 0;
+    int width = roi->width >> shift;
+    int height = roi->height >> shift;
+    size_t pixels = (size_t)width * height;
+    if (pixels > s_crop_capacity[b])
+    {
+        heap_caps_free(s_crop[b]);
+        s_crop[b] = (uint16_t *)heap_caps_malloc(pixels * sizeof(uint16_t), MALLOC_CAP_8BIT);
+        s_crop_capacity[b] = s_crop[b] ? pixels : 0;
+        if (!s_crop[b])
+        {
+            ESP_LOGW(TAG, "Failed to allocate %dx%d crop", width, height);
+            return NULL;
+        }
+    }
+
+    const uint16_t *src = frame + (roi->y >> shift) * frame_width + (roi->x >> shift);
+    uint16_t *dst = s_crop[b];
+    for (int y = 0; y < height; y++)
+    {
+        memcpy(dst, src, width * sizeof(uint16_t));
+        src += frame_width;
+        dst += width;
+    }
+    return s_crop[b];
+}
+
+void who_roi_to_frame(who_faces_t *faces, const who_roi_t *roi)
+{
+    for (int f = 0; f < faces->count; f++)
+    {
+        who_face_t *face = &faces->face[f];
+        for (int i = 0; i < 4; i += 2)
+        {
+            face->box[i] += roi->x;
+            face->box[i + 1] += roi->y;
+        }
+        for (int i = 0; i < WHO_FACE_KEYPOINTS; i += 2)
+        {
+            face->keypoint[i] += roi->x;
+            face->keypoint[i + 1] += roi->y;
+        }
+    }
+}
+
+void who_roi_update(const who_faces_t *faces, bool from_roi)
+{
+    if (from_roi)
+    {
+        s_stats.roi_passes++;
+        if (!faces->count)
+            s_stats.lost++;
+    }
+    else
+    {
+        s_stats.full_passes++;
+    }
+
+    s_roi_passes_since_full = from_roi ? s_roi_passes_since_full + 1 : 0;
+    s_tracking = faces->count > 0;
+    if (!s_tracking)
+        return;
+
+    s_box[0] = s_box[1] = INT32_MAX;
+    s_box[2] = s_box[3] = INT32_MIN;
+    for (int f = 0; f < faces->count; f++)
+    {
+        const int *box = faces->face[f].box;
+        s_box[0] = std::min(s_box[0], box[0]);
+        s_box[1] = std::min(s_box[1], box[1]);
+        s_box[2] = std::max(s_box[2], box[2]);
+        s_box[3] = std::max(s_box[3], box[3]);
+    }
+}
+
+void who_roi_get_stats(who_roi_stats_t *stats)
+{
+    *stats = s_stats;
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <stdint.h>
+#include "who_face_detect.hpp"
+
+/**
+ * @brief Search window of the next detection pass, in frame pixels.
+ */
+typedef struct
+{
+    int x;      /*<! left column */
+    int y;      /*<! top row */
+    int width;
+    int height;
+} who_roi_t;
+
+/**
+ * @brief Region-of-interest counters.
+ */
+typedef struct
+{
+    uint32_t roi_passes;   /*<! detection passes run on a crop */
+    uint32_t full_passes;  /*<! detection passes run on the whole frame */
+    uint32_t lost;         /*<! crops without a face, followed by a full pass */
+} who_roi_stats_t;
+
+/**
+ * @brief Set the search window parameters and drop the current track.
+ *
+ * @param padding_percent   padding added on every side of the last face box,
+ *                          in percent of the box size
+ * @param full_frame_every  force a full-frame pass after this many crop passes
+ * @param max_area_percent  crops larger than this share of the frame are not
+ *                          worth it, the whole frame is searched instead
+ */
+void who_roi_init(int padding_percent, int full_frame_every, int max_area_percent);
+
+/**
+ * @brief Pick the search window for the next frame.
+ *
+ * @param height frame height
+ * @param width  frame width
+ * @param roi    output window
+ * @param shift  window corners snapped outwards to multiples of 2^shift, so
+ *               it covers whole pixels of that pyramid level
+ * @return false when the whole frame has to be searched
+ */
+bool who_roi_select(int height, int width, who_roi_t *roi, int shift = 0);
+
+/**
+ * @brief Copy the window out of an RGB565 frame into the internal crop buffer.
+ *
+ * @param frame       RGB565 frame, or its pyramid level at 1/2^shift
+ * @param frame_width width of frame
+ * @param roi         window returned by who_roi_select(), in frame pixels
+ * @param shift       pyramid level of frame; crops of a level have their
+ *                    own buffer, next to the one of the frame
+ * @return crop of (roi->height x roi->width) >> shift pixels, NULL when the
+ *         buffer cannot be allocated
+ */
+uint16_t *who_roi_crop(const uint16_t *frame, int frame_width, const who_roi_t *roi, int shift = 0);
+
+/**
+ * @brief Move boxes and keypoints found on a crop back to frame coordinates.
+ */
+void who_roi_to_frame(who_faces_t *faces, const who_roi_t *roi);
+
+/**
+ * @brief Feed the detection result of a frame back into the tracker.
+ *
+ * @param faces    faces in frame coordinates
+ * @param from_roi whether the results come from a crop
+ */
+void who_roi_update(const who_faces_t *faces, bool from_roi);
+
+/**
+ * @brief Get a copy of the counters.
+ */
+void who_roi_get_stats(who_roi_stats_t *stats);
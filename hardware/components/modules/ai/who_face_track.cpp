@@ -0,0 +1,495 @@
+#include "who_face_track.hpp"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+
+#include "dl_image.hpp"
+#include "who_pyramid.hpp"
+
+static const char *TAG = "face_track";
+
+// Side of the appearance signature, a mean-removed luminance thumbnail.
+#define SIGNATURE_SIDE 8
+#define SIGNATURE_SIZE (SIGNATURE_SIDE * SIGNATURE_SIDE)
+
+// Faces without a track waiting for their decision, more than one frame of
+// faces can hold.
+#define UNTRACKED_MAX WHO_DETECT_MAX_FACES
+
+// Detection side: where each track was last seen.
+typedef struct
+{
+    int id;             /*<! -1 for a free slot */
+    int box[4];
+    int64_t last_us;
+    int published;      /*<! faces handed to recognition */
+    int8_t signature[SIGNATURE_SIZE];   /*<! appearance when the last sample was handed over */
+} track_t;
+
+// Recognition side: running weighted sum of a track's embeddings.
+typedef struct
+{
+    int id;             /*<! -1 for a free slot */
+    int count;
+    bool decided;
+    bool closed;        /*<! split off its track, decided on the next call */
+    int64_t last_us;    /*<! last face of the track seen by the recognition task */
+} accum_t;
+
+static int s_max_tracks = 0;
+static int s_dim = 0;
+static int s_samples = 3;
+static int s_iou_percent = 30;
+static int s_split_percent = 25;
+static int s_refresh_diff = 24;
+static int64_t s_lost_us = 1000000;
+
+static track_t *s_tracks = NULL;
+static int s_next_id = 1;
+
+static accum_t *s_accums = NULL;
+static float *s_sums = NULL;    // max_tracks x dim
+static float *s_mean = NULL;    // dim, handed out by who_track_next_decision()
+static float *s_untracked = NULL;   // UNTRACKED_MAX x dim, normalized embeddings
+static int s_untracked_count = 0;
+
+// One set of counters per half, each written by its own task only.
+static who_track_detect_stats_t s_detect_stats = {};
+static who_track_sample_stats_t s_sample_stats = {};
+
+bool who_track_init(int max_tracks, int dim, int samples, int iou_percent, int split_percent,
+                    int refresh_diff, int64_t lost_us)
+{
+    heap_caps_free(s_tracks);
+    heap_caps_free(s_accums);
+    heap_caps_free(s_sums);
+    heap_caps_free(s_mean);
+    heap_caps_free(s_untracked);
+
+    s_tracks = (track_t *)heap_caps_malloc(max_tracks * sizeof(track_t), MALLOC_CAP_8BIT);
+    s_accums = (accum_t *)heap_caps_malloc(max_tracks * sizeof(accum_t), MALLOC_CAP_8BIT);
+    s_sums = (float *)heap_caps_malloc((size_t)max_tracks * dim * sizeof(float), MALLOC_CAP_8BIT);
+    s_mean = (float *)heap_caps_malloc(dim * sizeof(float), MALLOC_CAP_8BIT);
+    s_untracked = (float *)heap_caps_malloc((size_t)UNTRACKED_MAX * dim * sizeof(float), MALLOC_CAP_8BIT);
+    s_untracked_count = 0;
+    if (!s_tracks || !s_accums || !s_sums || !s_mean || !s_untracked)
+    {
+        ESP_LOGE(TAG, "Failed to allocate %d tracks", max_tracks);
+        heap_caps_free(s_tracks);
+        heap_caps_free(s_accums);
+        heap_caps_free(s_sums);
+        heap_caps_free(s_mean);
+        heap_caps_free(s_untracked);
+        s_tracks = NULL;
+        s_accums = NULL;
+        s_sums = NULL;
+        s_mean = NULL;
+        s_untracked = NULL;
+        s_max_tracks = 0;
+        return false;
+    }
+
+    s_max_tracks = max_tracks;
+    s_dim = dim;
+    s_samples = std::max(1, samples);
+    s_iou_percent = iou_percent;
+    s_split_percent = split_percent;
+    s_refresh_diff = refresh_diff;
+    s_lost_us = lost_us;
+    for (int i = 0; i < max_tracks; i++)
+    {
+        s_tracks[i].id = -1;
+        s_accums[i].id = -1;
+    }
+    memset(&s_detect_stats, 0, sizeof(s_detect_stats));
+    memset(&s_sample_stats, 0, sizeof(s_sample_stats));
+    return true;
+}
+
+/* ----------------------------- detection side ----------------------------- */
+
+// Intersection over union in 1/1024, 0 for disjoint boxes.
+static int iou_1024(const int *a, const int *b)
+{
+    int ix = std::min(a[2], b[2]) - std::max(a[0], b[0]);
+    int iy = std::min(a[3], b[3]) - std::max(a[1], b[1]);
+    if (ix <= 0 || iy <= 0)
+        return 0;
+    int64_t inter = (int64_t)ix * iy;
+    int64_t uni = (int64_t)(a[2] - a[0]) * (a[3] - a[1]) + (int64_t)(b[2] - b[0]) * (b[3] - b[1]) - inter;
+    return uni > 0 ? (int)(inter * 1024 / uni) : 0;
+}
+
+void who_track_assign(const who_faces_t *faces, int64_t now_us, int *ids)
+{
+    if (!s_max_tracks)
+    {
+        for (int f = 0; f < faces->count; f++)
+            ids[f] = -1;
+        return;
+    }
+
+    for (int t = 0; t < s_max_tracks; t++)
+    {
+        if (s_tracks[t].id >= 0 && now_us - s_tracks[t].last_us > s_lost_us)
+            s_tracks[t].id = -1;
+    }
+
+    // Greedy matching, best overlapping pair first.
+    uint32_t track_used = 0;
+    uint32_t face_done = 0;
+    for (int f = 0; f < faces->count; f++)
+        ids[f] = -1;
+    while (true)
+    {
+        int best_f = -1, best_t = -1;
+        int best = s_iou_percent * 1024 / 100 - 1;
+        for (int f = 0; f < faces->count; f++)
+        {
+            if (face_done & (1u << f))
+                continue;
+            for (int t = 0; t < s_max_tracks; t++)
+            {
+                if (s_tracks[t].id < 0 || (track_used & (1u << t)))
+                    continue;
+                int score = iou_1024(faces->face[f].box, s_tracks[t].box);
+                if (score > best)
+                {
+                    best = score;
+                    best_f = f;
+                    best_t = t;
+                }
+            }
+        }
+        if (best_f < 0)
+            break;
+        face_done |= 1u << best_f;
+        track_used |= 1u << best_t;
+        ids[best_f] = s_tracks[best_t].id;
+        memcpy(s_tracks[best_t].box, faces->face[best_f].box, sizeof(s_tracks[best_t].box));
+        s_tracks[best_t].last_us = now_us;
+    }
+
+    // Whatever is left is a new face in the doorway.
+    for (int f = 0; f < faces->count; f++)
+    {
+        if (face_done & (1u << f))
+            continue;
+        int slot = -1;
+        for (int t = 0; t < s_max_tracks; t++)
+        {
+            if (track_used & (1u << t))
+                continue;
+            if (s_tracks[t].id < 0)
+            {
+                slot = t;
+                break;
+            }
+            if (slot < 0 || s_tracks[t].last_us < s_tracks[slot].last_us)
+                slot = t;
+        }
+        if (slot < 0)
+            break;
+        track_used |= 1u << slot;
+        s_tracks[slot].id = s_next_id++;
+        s_tracks[slot].published = 0;
+        memcpy(s_tracks[slot].box, faces->face[f].box, sizeof(s_tracks[slot].box));
+        s_tracks[slot].last_us = now_us;
+        ids[f] = s_tracks[slot].id;
+        s_detect_stats.tracks++;
+    }
+}
+
+// Free slots have ID -1 too: an untracked face (-1) matches none of them.
+static track_t *find_track(int track_id)
+{
+    if (track_id < 0)
+        return NULL;
+    for (int t = 0; t < s_max_tracks; t++)
+    {
+        if (s_tracks[t].id == track_id)
+            return &s_tracks[t];
+    }
+    return NULL;
+}
+
+// Mean-removed 8x8 luminance of the face box, clipped to +-127.
+static void signature(const uint16_t *frame, int height, int width, const int *box, int8_t *out)
+{
+    int x0 = std::max(0, box[0]), y0 = std::max(0, box[1]);
+    int x1 = std::min(width - 1, box[2]), y1 = std::min(height - 1, box[3]);
+    int bw = std::max(1, x1 - x0), bh = std::max(1, y1 - y0);
+
+    // Sample the coarsest pyramid level whose pixels still fit in a cell of
+    // the thumbnail: each sample the mean of its block, not one pixel.
+    int cell = std::min(bw, bh) / SIGNATURE_SIDE;
+    int shift = 0;
+    const who_pyramid_level_t *level = cell > 1 ? who_pyramid_find(frame, 31 - __builtin_clz(cell), &shift) : NULL;
+    if (level)
+    {
+        frame = level->image;
+        width = level->shape.width;
+        x0 >>= shift;
+        y0 >>= shift;
+        bw = std::max(1, bw >> shift);
+        bh = std::max(1, bh >> shift);
+    }
+
+    int gray[SIGNATURE_SIZE];
+    int sum = 0;
+    for (int i = 0; i < SIGNATURE_SIDE; i++)
+    {
+        int y = y0 + (2 * i + 1) * bh / (2 * SIGNATURE_SIDE);
+        for (int j = 0; j < SIGNATURE_SIDE; j++)
+        {
+            int x = x0 + (2 * j + 1) * bw / (2 * SIGNATURE_SIDE);
+            int g = dl::image::convert_pixel_rgb565_to_gray(frame[y * width + x]);
+            gray[i * SIGNATURE_SIDE + j] = g;
+            sum += g;
+        }
+    }
+    int mean = sum / SIGNATURE_SIZE;
+    for (int i = 0; i < SIGNATURE_SIZE; i++)
+        out[i] = (int8_t)std::max(-127, std::min(127, gray[i] - mean));
+}
+
+bool who_track_wants_face(int *track_id, const uint16_t *frame, int height, int width, const who_face_t &face)
+{
+    track_t *track = find_track(*track_id);
+    if (!track || track->published < s_samples)
+        return true;
+    if (s_refresh_diff <= 0)
+    {
+        s_detect_stats.cached++;
+        return false;
+    }
+
+    int8_t current[SIGNATURE_SIZE];
+    signature(frame, height, width, face.box, current);
+    int diff = 0;
+    for (int i = 0; i < SIGNATURE_SIZE; i++)
+        diff += abs(current[i] - track->signature[i]);
+    if (diff < s_refresh_diff * SIGNATURE_SIZE)
+    {
+        s_detect_stats.cached++;
+        return false;
+    }
+
+    // Looks like someone else now, or the same person much better lit or
+    // turned: recognize it again as a track of its own.
+    track->id = s_next_id++;
+    track->published = 0;
+    *track_id = track->id;
+    s_detect_stats.tracks++;
+    s_detect_stats.refreshed++;
+    return true;
+}
+
+void who_track_mark_published(int track_id, const uint16_t *frame, int height, int width, const who_face_t &face)
+{
+    track_t *track = find_track(track_id);
+    if (!track)
+        return;
+    track->published++;
+    if (track->published == s_samples)
+        signature(frame, height, width, face.box, track->signature);
+}
+
+/* ---------------------------- recognition side ---------------------------- */
+
+static accum_t *find_accum(int track_id)
+{
+    if (track_id < 0)
+        return NULL;
+    for (int i = 0; i < s_max_tracks; i++)
+    {
+        if (s_accums[i].id == track_id && !s_accums[i].closed)
+            return &s_accums[i];
+    }
+    return NULL;
+}
+
+static accum_t *new_accum(int track_id, int64_t now_us)
+{
+    // A free slot, else the oldest decided track, else the oldest at all.
+    accum_t *victim = NULL;
+    for (int i = 0; i < s_max_tracks; i++)
+    {
+        accum_t *a = &s_accums[i];
+        if (a->id < 0)
+        {
+            victim = a;
+            break;
+        }
+        if (!victim || (a->decided && !victim->decided) ||
+            (a->decided == victim->decided && a->last_us < victim->last_us))
+            victim = a;
+    }
+    if (victim->id >= 0 && !victim->decided)
+        ESP_LOGW(TAG, "Too many open tracks, track %d dropped undecided", victim->id);
+
+    victim->id = track_id;
+    victim->count = 0;
+    victim->decided = false;
+    victim->closed = false;
+    victim->last_us = now_us;
+    memset(s_sums + (victim - s_accums) * s_dim, 0, s_dim * sizeof(float));
+    return victim;
+}
+
+bool who_track_wants_sample(int track_id, int64_t now_us)
+{
+    accum_t *a = find_accum(track_id);
+    if (!a)
+        return true;
+    a->last_us = now_us;
+    if (a->decided || a->count >= s_samples)
+    {
+        s_sample_stats.skipped++;
+        return false;
+    }
+    return true;
+}
+
+void who_track_add_sample(int track_id, const float *embedding, float weight, int64_t now_us)
+{
+    if (!s_untracked)
+        return;
+
+    float norm = 0.0f;
+    for (int i = 0; i < s_dim; i++)
+        norm += embedding[i] * embedding[i];
+    if (norm <= 0.0f)
+        return;
+
+    // More faces than tracks: the face is decided on its own, from this
+    // one sample, rather than merged into someone else's mean.
+    if (track_id < 0 || !s_max_tracks)
+    {
+        if (s_untracked_count == UNTRACKED_MAX)
+        {
+            ESP_LOGW(TAG, "Too many untracked faces, one dropped undecided");
+            return;
+        }
+        float *out = s_untracked + (size_t)s_untracked_count++ * s_dim;
+        float scale = 1.0f / sqrtf(norm);
+        for (int i = 0; i < s_dim; i++)
+            out[i] = embedding[i] * scale;
+        s_sample_stats.samples++;
+        s_sample_stats.untracked++;
+        return;
+    }
+
+    accum_t *a = find_accum(track_id);
+    if (!a)
+        a = new_accum(track_id, now_us);
+
+    // A face unlike the rest of the track is someone else who stepped into
+    // the same box: decide the track so far and start over.
+    float *sum = s_sums + (a - s_accums) * s_dim;
+    if (a->count)
+    {
+        float dot = 0.0f, sum_norm = 0.0f;
+        for (int i = 0; i < s_dim; i++)
+        {
+            dot += sum[i] * embedding[i];
+            sum_norm += sum[i] * sum[i];
+        }
+        if (sum_norm > 0.0f && dot * 100.0f < s_split_percent * sqrtf(sum_norm * norm))
+        {
+            a->closed = true;
+            s_sample_stats.splits++;
+            a = new_accum(track_id, now_us);
+            sum = s_sums + (a - s_accums) * s_dim;
+        }
+    }
+
+    float scale = weight / sqrtf(norm);
+    for (int i = 0; i < s_dim; i++)
+        sum[i] += embedding[i] * scale;
+    a->count++;
+    a->last_us = now_us;
+    s_sample_stats.samples++;
+}
+
+bool who_track_next_decision(int64_t now_us, who_track_decision_t *decision)
+{
+    if (s_untracked_count)
+    {
+        s_untracked_count--;
+        memcpy(s_mean, s_untracked + (size_t)s_untracked_count * s_dim, s_dim * sizeof(float));
+        decision->track_id = -1;
+        decision->samples = 1;
+        decision->ended = true;
+        decision->embedding = s_mean;
+        return true;
+    }
+
+    for (int i = 0; i < s_max_tracks; i++)
+    {
+        accum_t *a = &s_accums[i];
+        if (a->id < 0)
+            continue;
+        bool lost = a->closed || now_us - a->last_us > s_lost_us;
+        if (a->decided || !a->count)
+        {
+            if (lost)
+                a->id = -1;
+            continue;
+        }
+        bool mature = a->count >= s_samples;
+        if (!mature && !lost)
+            continue;
+
+        const float *sum = s_sums + (size_t)i * s_dim;
+        float norm = 0.0f;
+        for (int j = 0; j < s_dim; j++)
+            norm += sum[j] * sum[j];
+        float scale = norm > 0.0f ? 1.0f / sqrtf(norm) : 0.0f;
+        for (int j = 0; j < s_dim; j++)
+            s_mean[j] = sum[j] * scale;
+
+        decision->track_id = a->id;
+        decision->samples = a->count;
+        decision->ended = !mature;
+        decision->embedding = s_mean;
+        if (mature)
+        {
+            s_sample_stats.matured++;
+            a->decided = true;
+        }
+        else
+        {
+            s_sample_stats.ended++;
+            a->id = -1;
+        }
+        return true;
+    }
+    return false;
+}
+
+bool who_track_pending(void)
+{
+    if (s_untracked_count)
+        return true;
+    for (int i = 0; i < s_max_tracks; i++)
+    {
+        if (s_accums[i].id >= 0 && !s_accums[i].decided && s_accums[i].count)
+            return true;
+    }
+    return false;
+}
+
+void who_track_get_detect_stats(who_track_detect_stats_t *stats)
+{
+    *stats = s_detect_stats;
+}
+
+void who_track_get_sample_stats(who_track_sample_stats_t *stats)
+{
+    *stats = s_sample_stats;
+}
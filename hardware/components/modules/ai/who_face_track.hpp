@@ -0,0 +1,140 @@
+#pragma once
+
+#include <stdint.h>
+#include "who_face_detect.hpp"
+
+/**
+ * @brief A track whose identity is ready to be decided.
+ */
+typedef struct
+{
+    int track_id;
+    int samples;                /*<! embeddings averaged */
+    bool ended;                 /*<! decided because the track was lost or split, not because it matured */
+    const float *embedding;     /*<! L2-normalized weighted mean, valid until the next call */
+} who_track_decision_t;
+
+/**
+ * @brief Counters of the detection side, written by the detection task only.
+ */
+typedef struct
+{
+    uint32_t tracks;        /*<! tracks started by the detection stage */
+    uint32_t cached;        /*<! faces of a decided track, neither aligned nor embedded */
+    uint32_t refreshed;     /*<! decided tracks re-recognized after a large appearance change */
+} who_track_detect_stats_t;
+
+/**
+ * @brief Counters of the recognition side, written by the recognition task only.
+ */
+typedef struct
+{
+    uint32_t samples;       /*<! embeddings accumulated */
+    uint32_t skipped;       /*<! faces not embedded, their track had enough samples or was decided */
+    uint32_t matured;       /*<! tracks decided after the full number of samples */
+    uint32_t ended;         /*<! tracks decided early because they were lost or split */
+    uint32_t splits;        /*<! tracks cut because a face did not match their mean */
+    uint32_t untracked;     /*<! faces beyond the tracks, each decided from its one sample */
+} who_track_sample_stats_t;
+
+/**
+ * @brief Set up both halves of the tracker.
+ *
+ * Detection side: who_track_assign(), who_track_wants_face() and
+ * who_track_mark_published(), called from the detection task only.
+ * Recognition side: who_track_wants_sample(), who_track_add_sample() and
+ * who_track_next_decision(), called from the recognition task only. The two
+ * halves share nothing but the track ID carried in the face ring slot.
+ *
+ * @param max_tracks    tracks followed at once on either side
+ * @param dim           embedding length
+ * @param samples       embeddings averaged before a track is decided
+ * @param iou_percent   minimum box overlap to continue a track, in percent
+ * @param split_percent a face whose cosine similarity to the track's mean is
+ *                      below this, in percent, starts a new accumulation
+ * @param refresh_diff  mean luminance difference, in gray levels, of a
+ *                      decided track's face that has it recognized again,
+ *                      0 never re-recognizes
+ * @param lost_us       a track without a face for this long has ended
+ * @return false when the accumulators cannot be allocated
+ */
+bool who_track_init(int max_tracks, int dim, int samples, int iou_percent, int split_percent,
+                    int refresh_diff, int64_t lost_us);
+
+/**
+ * @brief Associate the faces of a frame with the running tracks by IoU,
+ *        greedily from the best overlap, and start tracks for the rest.
+ *
+ * @param faces  faces in frame coordinates
+ * @param now_us esp_timer time of the frame
+ * @param ids    output track ID per face, faces->count entries; -1 for
+ *               faces beyond max_tracks
+ */
+void who_track_assign(const who_faces_t *faces, int64_t now_us, int *ids);
+
+/**
+ * @brief Whether a face is worth aligning and handing to recognition: its
+ *        track still needs samples, or its appearance changed a lot since
+ *        the last sample. In that case the face gets a new track ID.
+ *
+ * @param track_id  in: track from who_track_assign(), out: track to publish under
+ * @param frame     RGB565 frame
+ * @param height    frame height
+ * @param width     frame width
+ * @param face      detection result in frame coordinates
+ * @return false when the track has been handed all its samples already
+ */
+bool who_track_wants_face(int *track_id, const uint16_t *frame, int height, int width, const who_face_t &face);
+
+/**
+ * @brief Count a face handed to recognition, keeping its appearance once the
+ *        track has all its samples.
+ */
+void who_track_mark_published(int track_id, const uint16_t *frame, int height, int width, const who_face_t &face);
+
+/**
+ * @brief Whether a face of this track is still worth an MFN forward pass.
+ *        Keeps the track alive either way.
+ *
+ * @return false once the track has its samples or has been decided
+ */
+bool who_track_wants_sample(int track_id, int64_t now_us);
+
+/**
+ * @brief Add an embedding to the track's weighted mean. The embedding is
+ *        L2-normalized first, so the weight alone sets its share. An
+ *        embedding that does not match the mean so far closes the track's
+ *        samples for a decision and starts a new mean.
+ *
+ * @param track_id  track from who_track_assign(); -1, a face no track was
+ *                  left for, is decided on its own with this one sample
+ * @param embedding dim floats
+ * @param weight    e.g. who_quality_weight() of the face
+ * @param now_us    current esp_timer time
+ */
+void who_track_add_sample(int track_id, const float *embedding, float weight, int64_t now_us);
+
+/**
+ * @brief Pop the next track to decide: one with all its samples, or one
+ *        lost or split with at least one sample. Each mean is decided once.
+ *
+ * @param now_us   current esp_timer time
+ * @param decision output
+ * @return false when no track is ready
+ */
+bool who_track_next_decision(int64_t now_us, who_track_decision_t *decision);
+
+/**
+ * @brief Whether the recognition side has tracks still collecting samples.
+ */
+bool who_track_pending(void);
+
+/**
+ * @brief Get a copy of the detection side counters, from the detection task.
+ */
+void who_track_get_detect_stats(who_track_detect_stats_t *stats);
+
+/**
+ * @brief Get a copy of the recognition side counters, from the recognition task.
+ */
+void who_track_get_sample_stats(who_track_sample_stats_t *stats);
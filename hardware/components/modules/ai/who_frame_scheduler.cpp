@@ -0,0 +1,117 @@
+#include "who_frame_scheduler.hpp"
+
+#include <string.h>
+#include <algorithm>
+#include "esp_timer.h"
+
+static int64_t s_active_period_us = 0;
+static int64_t s_idle_period_us = 250 * 1000;
+static int64_t s_idle_after_us = 2000 * 1000;
+static int64_t s_starvation_us = 200 * 1000;
+static int64_t s_backoff_base_us = 50 * 1000;
+static int64_t s_backoff_hold_us = 2000 * 1000;
+
+static int64_t s_last_face_us = INT64_MIN / 2;
+static int64_t s_backoff_us = 0;
+
+// Written by whichever task reports, read by the frame loop.
+static portMUX_TYPE s_lag_lock = portMUX_INITIALIZER_UNLOCKED;
+static int64_t s_last_starved_us = INT64_MIN / 2;
+static uint32_t s_pending_reports = 0;
+
+static who_sched_stats_t s_stats = {};
+
+static const char *s_names[WHO_SCHED_MAX] = {
+    "active",
+    "idle",
+    "backoff",
+};
+
+void who_sched_init(int active_period_ms, int idle_period_ms, int idle_after_ms,
+                    int starvation_ms, int backoff_ms, int backoff_hold_ms)
+{
+    s_active_period_us = active_period_ms * 1000LL;
+    s_idle_period_us = idle_period_ms * 1000LL;
+    s_idle_after_us = idle_after_ms * 1000LL;
+    s_starvation_us = starvation_ms * 1000LL;
+    s_backoff_base_us = backoff_ms * 1000LL;
+    s_backoff_hold_us = backoff_hold_ms * 1000LL;
+    s_backoff_us = 0;
+    memset(&s_stats, 0, sizeof(s_stats));
+    s_stats.mode = WHO_SCHED_IDLE;
+}
+
+void who_sched_report_lag(int64_t lag_us)
+{
+    portENTER_CRITICAL(&s_lag_lock);
+    s_stats.max_lag_ms = std::max<uint32_t>(s_stats.max_lag_ms, lag_us / 1000);
+    if (lag_us >= s_starvation_us)
+    {
+        s_last_starved_us = esp_timer_get_time();
+        s_pending_reports++;
+        s_stats.starvation_reports++;
+    }
+    portEXIT_CRITICAL(&s_lag_lock);
+}
+
+TickType_t who_sched_frame_done(bool face_found, int64_t frame_start_us)
+{
+    int64_t now = esp_timer_get_time();
+    if (face_found)
+        s_last_face_us = now;
+
+    portENTER_CRITICAL(&s_lag_lock);
+    uint32_t reports = s_pending_reports;
+    int64_t last_starved = s_last_starved_us;
+    s_pending_reports = 0;
+    portEXIT_CRITICAL(&s_lag_lock);
+
+    // Every report while backing off doubles the extra sleep, quiet for
+    // the hold time resets it.
+    for (uint32_t i = 0; i < reports; i++)
+        s_backoff_us = std::min(s_idle_period_us, s_backoff_us ? s_backoff_us * 2 : s_backoff_base_us);
+    if (now - last_starved > s_backoff_hold_us)
+        s_backoff_us = 0;
+
+    who_sched_mode_t mode;
+    int64_t period;
+    if (now - s_last_face_us <= s_idle_after_us)
+    {
+        mode = WHO_SCHED_ACTIVE;
+        period = s_active_period_us;
+    }
+    else
+    {
+        mode = WHO_SCHED_IDLE;
+        period = s_idle_period_us;
+    }
+    int64_t delay_us = period - (now - frame_start_us);
+    if (s_backoff_us)
+    {
+        mode = WHO_SCHED_BACKOFF;
+        delay_us = std::max<int64_t>(delay_us, 0) + s_backoff_us;
+    }
+
+    if (mode != s_stats.mode)
+        s_stats.switches++;
+    s_stats.mode = mode;
+    s_stats.frames[mode]++;
+
+    TickType_t ticks = delay_us > 0 ? pdMS_TO_TICKS(delay_us / 1000) : 0;
+    if (ticks < 1)
+        ticks = 1;
+    s_stats.last_delay_ms = ticks * portTICK_PERIOD_MS;
+    return ticks;
+}
+
+const char *who_sched_mode_name(who_sched_mode_t mode)
+{
+    return mode < WHO_SCHED_MAX ? s_names[mode] : "?";
+}
+
+void who_sched_get_stats(who_sched_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_lag_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_lag_lock);
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+
+/**
+ * @brief Processing rate picked for a frame.
+ */
+typedef enum
+{
+    WHO_SCHED_ACTIVE = 0,   /*<! face seen recently, full rate */
+    WHO_SCHED_IDLE,         /*<! nobody around, low rate */
+    WHO_SCHED_BACKOFF,      /*<! other tasks report starvation, slowed down */
+    WHO_SCHED_MAX,
+} who_sched_mode_t;
+
+/**
+ * @brief Scheduler counters.
+ */
+typedef struct
+{
+    who_sched_mode_t mode;              /*<! mode of the last frame */
+    uint32_t frames[WHO_SCHED_MAX];     /*<! frames per mode */
+    uint32_t switches;                  /*<! mode changes */
+    uint32_t starvation_reports;        /*<! wake-ups later than the starvation threshold */
+    uint32_t max_lag_ms;                /*<! worst reported wake-up lag */
+    uint32_t last_delay_ms;             /*<! sleep after the last frame */
+} who_sched_stats_t;
+
+/**
+ * @brief Set the frame periods.
+ *
+ * @param active_period_ms  frame period while faces are around, 0 = as fast
+ *                          as possible (one tick of sleep per frame)
+ * @param idle_period_ms    frame period with nobody around
+ * @param idle_after_ms     time without a face before dropping to idle
+ * @param starvation_ms     wake-up lag of another task that counts as starvation
+ * @param backoff_ms        extra sleep per frame on the first starvation
+ *                          report, doubled on every further report while
+ *                          backing off, capped at idle_period_ms
+ * @param backoff_hold_ms   back off until no report came for this long
+ */
+void who_sched_init(int active_period_ms, int idle_period_ms, int idle_after_ms,
+                    int starvation_ms, int backoff_ms, int backoff_hold_ms);
+
+/**
+ * @brief Pick the sleep after a processed frame.
+ *
+ * @param face_found     whether the frame had a face in it
+ * @param frame_start_us esp_timer time processing of the frame started
+ * @return ticks to vTaskDelay() before the next frame, at least one so the
+ *         other tasks on this core get to run
+ */
+TickType_t who_sched_frame_done(bool face_found, int64_t frame_start_us);
+
+/**
+ * @brief Report how late a task woke up, from any task.
+ *
+ * @param lag_us time between the task becoming ready and running
+ */
+void who_sched_report_lag(int64_t lag_us);
+
+/**
+ * @brief Name of a mode, for logging.
+ */
+const char *who_sched_mode_name(who_sched_mode_t mode);
+
+/**
+ * @brief Get a copy of the counters.
+ */
+void who_sched_get_stats(who_sched_stats_t *stats);
@@ -7,13 +7,13 @@
 #include "esp_task_wdt.h"
 #include "img_converters.h"
 #include <cmath>
+#include <algorithm>
+#include <atomic>
 #include "driver/gpio.h"
 
 #include "dl_image.hpp"
 // #include "fb_gfx.h" // Removed to save IRAM
 
-#include "human_face_detect_msr01.hpp"
-#include "human_face_detect_mnp01.hpp"
 #include "face_recognition_tool.hpp"
 #include "../gps/gps_neo7m.hpp"
 #include "csv_logger.h"
@@ -35,6 +35,20 @@
 #endif
 
 #include "who_ai_utils.hpp"
+#include "who_pipeline_stats.hpp"
+#include "who_motion_gate.hpp"
+#include "who_face_roi.hpp"
+#include "who_face_gallery.hpp"
+#include "who_face_quality.hpp"
+#include "who_face_ring.hpp"
+#include "who_frame_scheduler.hpp"
+#include "who_face_align.hpp"
+#include "who_face_detect.hpp"
+#include "who_face_track.hpp"
+#include "who_camera.h"
+#include "who_frame.h"
+#include "who_luma.hpp"
+#include "who_pyramid.hpp"
 
 using namespace std;
 using namespace dl;
@@ -47,18 +61,14 @@ static QueueHandle_t xQueueEvent = NULL;
 static QueueHandle_t xQueueFrameO = NULL;
 static QueueHandle_t xQueueResult = NULL;
 
-static recognizer_state_t gEvent = RECOGNIZE;
+static std::atomic<recognizer_state_t> gEvent(RECOGNIZE);
 static bool gReturnFB = true;
 static face_info_t recognize_result;
 
-SemaphoreHandle_t xMutex;
-
 // Custom face recognition settings
 static bool system_reset_flag = false;  // Flag for first run after reset - DISABLED to persist faces
 static int stored_face_id = -1;        // Currently stored face ID
 static const float SIMILARITY_THRESHOLD = 0.5f;  // Threshold for face matching (lowered to 0.5 for more tolerance)
-static int64_t s_last_detection_us = 0;
-static const int64_t DETECTION_THROTTLE_US = 500 * 1000; // 0.5 seconds between detections (much faster)
 
 typedef struct RecPostArgs {
     uint8_t *jpeg_buf;
@@ -80,6 +90,32 @@ typedef enum
 #define RGB565_MASK_GREEN 0x07E0
 #define RGB565_MASK_BLUE 0x001F
 #define FRAME_DELAY_NUM 16
+#define STATS_LOG_INTERVAL 200  // Print per-stage latency every N processed frames
+#define FACE_EMBEDDING_DIM 128  // MFN output, also the size csv_logger stores
+
+// Detection on the half resolution luminance of GRAYSCALE or YUV422 frames:
+// face sizes configured in frame pixels are halved for the detection side.
+#if CONFIG_WHO_DETECT_INPUT_RGB565
+#define DETECT_SHIFT 0
+#else
+#define DETECT_SHIFT 1
+#endif
+
+// Pyramid levels MSR01 may start from instead of the detection image.
+#if CONFIG_WHO_PYRAMID_DETECT
+#define DETECT_PYRAMID_SHIFT CONFIG_WHO_PYRAMID_LEVELS
+#else
+#define DETECT_PYRAMID_SHIFT 0
+#endif
+
+// Detection next to the camera task, recognition and logging next to WiFi.
+#if CONFIG_FREERTOS_UNICORE
+#define WHO_DETECT_CORE 0
+#define WHO_RECOGNIZE_CORE 0
+#else
+#define WHO_DETECT_CORE CONFIG_WHO_PIPELINE_DETECT_CORE
+#define WHO_RECOGNIZE_CORE CONFIG_WHO_PIPELINE_RECOGNIZE_CORE
+#endif
 
 
 // Global variables to track LED state with cooldown
@@ -117,7 +153,366 @@ static void flash_led_on_face_detect()
     // If within cooldown, ignore this detection
 }
 
-static void task_process_handler(void *arg)
+// Embeddings of a batch of aligned faces without enrolling them in the
+// recognizer: row i of embeddings is faces[index[i]]. The MFN model has no
+// batch dimension, so the batch shares one input and one output tensor and
+// runs face after face.
+template <typename feature_t>
+static void extract_embeddings(FaceRecognizer<feature_t> *recognizer, Tensor<uint8_t> *faces, const int *index, int count,
+                               Tensor<feature_t> &model_input, Tensor<float> &embedding, float *embeddings)
+{
+    for (int i = 0; i < count; i++)
+    {
+        face_recognition_tool::transform_mfn_input(faces[index[i]], model_input, false);
+        Tensor<feature_t> &output = recognizer->forward(model_input);
+        face_recognition_tool::transform_mfn_output(output, embedding, true, false);
+        memcpy(embeddings + (size_t)i * FACE_EMBEDDING_DIM, embedding.element, FACE_EMBEDDING_DIM * sizeof(float));
+    }
+}
+
+static bool is_valid_embedding(const float *emb, int size)
+{
+    float sum_sq = 0;
+    for (int i = 0; i < size; i++) {
+        if (isnan(emb[i]) || isinf(emb[i])) return false;
+        sum_sq += emb[i] * emb[i];
+    }
+    return sum_sq >= 1e-6;
+}
+
+// Each saved face carries its gallery ID, its age and the next free ID in
+// its name, so a reboot neither renumbers passengers nor hands out IDs
+// already logged, and the TTL keeps counting from when it was last seen.
+#define GALLERY_NAME_FORMAT "%d:%d:%d"
+
+// Load the gallery saved by save_gallery(), dropping invalid and expired
+// embeddings.
+template <typename feature_t>
+static void load_gallery(FaceRecognizer<feature_t> *recognizer)
+{
+    recognizer->set_ids_from_flash();
+    std::vector<face_info_t> ids = recognizer->get_enrolled_ids();
+    int loaded = 0;
+    int64_t now = esp_timer_get_time();
+    for (face_info_t &info : ids) {
+        Tensor<float> &emb = recognizer->get_face_emb(info.id);
+        if (!emb.element || emb.get_size() != FACE_EMBEDDING_DIM || !is_valid_embedding(emb.element, emb.get_size())) {
+            ESP_LOGW(TAG, "⚠️ Stored ID %d has invalid embedding (NaN/Inf/Zero). Skipping...", info.id);
+            continue;
+        }
+        // Saved before IDs were kept: the recognizer's ID, seen just now.
+        int id = info.id, age_s = 0, next_id = 0;
+        sscanf(info.name.c_str(), GALLERY_NAME_FORMAT, &id, &age_s, &next_id);
+        who_gallery_reserve_ids(next_id);
+        if (CONFIG_WHO_GALLERY_TTL_S > 0 && age_s > CONFIG_WHO_GALLERY_TTL_S)
+            continue;
+        who_gallery_add(emb.element, now - (int64_t)age_s * 1000000, id);
+        loaded++;
+    }
+    // The gallery owns the embeddings now, keep no second copy in RAM.
+    recognizer->clear_id(false);
+    ESP_LOGI(TAG, "✅ Loaded %d/%d stored faces into the gallery, next ID %d", loaded, (int)ids.size(),
+             who_gallery_next_id());
+}
+
+// Flash write of the live gallery, only off the hot path (trip end).
+template <typename feature_t>
+static void save_gallery(FaceRecognizer<feature_t> *recognizer)
+{
+    int64_t start = esp_timer_get_time();
+    Tensor<float> emb;
+    emb.set_shape({FACE_EMBEDDING_DIM});
+    emb.calloc_element();
+    if (!emb.element) {
+        ESP_LOGE(TAG, "❌ Failed to allocate embedding, gallery not saved");
+        return;
+    }
+
+    recognizer->clear_id(false);
+    char name[40];
+    for (int slot = 0; slot < who_gallery_capacity(); slot++) {
+        int id;
+        int64_t age_us;
+        if (!who_gallery_get_age(slot, start, &age_us) || !who_gallery_get(slot, &id, emb.element)) continue;
+        snprintf(name, sizeof(name), GALLERY_NAME_FORMAT, id, (int)(age_us / 1000000), who_gallery_next_id());
+        recognizer->enroll_id(emb, name, false);
+    }
+    int saved = recognizer->write_ids_to_flash();
+    recognizer->clear_id(false);
+    ESP_LOGI(TAG, "💾 Saved %d gallery faces to flash (%lld ms)", saved, (esp_timer_get_time() - start) / 1000);
+}
+
+static csv_gps_data_t csv_gps_now(void)
+{
+    gps_data_t current_gps = gps_get_current_data();
+    csv_gps_data_t csv_gps = {
+        .latitude = current_gps.latitude,
+        .longitude = current_gps.longitude,
+        .altitude = current_gps.altitude,
+        .satellites = current_gps.satellites,
+        .valid = current_gps.valid,
+        .timestamp = {0}
+    };
+    strncpy(csv_gps.timestamp, current_gps.timestamp, sizeof(csv_gps.timestamp) - 1);
+    return csv_gps;
+}
+
+// Match a track's mean embedding against the gallery, log it when new.
+// Returns true when the gallery changed.
+static bool decide_track(const who_track_decision_t &decision, const csv_gps_data_t &csv_gps)
+{
+    int64_t stage_time = esp_timer_get_time();
+    float similarity;
+    int match = who_gallery_find(decision.embedding, SIMILARITY_THRESHOLD, stage_time, &similarity);
+    who_stats_record(WHO_STAGE_MATCH, esp_timer_get_time() - stage_time);
+
+    bool added = false;
+    if (match >= 0)
+    {
+        // Seen within the gallery window: duplicate
+        who_gallery_touch(match, stage_time);
+        who_gallery_get(match, &recognize_result.id, NULL);
+        recognize_result.similarity = similarity;
+        ESP_LOGI(TAG, "⏭️ DUPLICATE (Sim: %.3f, ID %d, track %d, %d samples). Skipping.",
+                 similarity, recognize_result.id, decision.track_id, decision.samples);
+    }
+    else
+    {
+        // New passenger: RAM only, flash is written at trip end
+        stage_time = esp_timer_get_time();
+        stored_face_id = who_gallery_add(decision.embedding, stage_time);
+        added = true;
+        who_stats_record(WHO_STAGE_ENROLL, esp_timer_get_time() - stage_time);
+        recognize_result.id = stored_face_id;
+        recognize_result.similarity = similarity;
+
+        ESP_LOGI(TAG, "🆕 NEW PASSENGER LOGGED: ID %d (best Sim: %.3f, track %d, %d samples)",
+                 stored_face_id, recognize_result.similarity, decision.track_id, decision.samples);
+        stage_time = esp_timer_get_time();
+        csv_logger_log_face(stored_face_id, (float *)decision.embedding, FACE_EMBEDDING_DIM, csv_gps, NULL, 0);
+        csv_uploader_trigger_now();
+        who_stats_record(WHO_STAGE_LOG, esp_timer_get_time() - stage_time);
+    }
+
+    if (xQueueResult)
+    {
+        xQueueSend(xQueueResult, &recognize_result, portMAX_DELAY);
+    }
+    return added;
+}
+
+// Counters written by the recognition task, logged from it: the tracker's
+// samples and the gallery take no lock.
+static void log_recognition_stats(void)
+{
+    who_track_sample_stats_t track;
+    who_track_get_sample_stats(&track);
+    ESP_LOGI(TAG, "🧵 Samples: %u embeddings, %u faces skipped, decided %u mature / %u lost, %u splits, %u faces without a track",
+             (unsigned)track.samples, (unsigned)track.skipped, (unsigned)track.matured,
+             (unsigned)track.ended, (unsigned)track.splits, (unsigned)track.untracked);
+    who_gallery_stats_t gallery;
+    who_gallery_get_stats(&gallery);
+    ESP_LOGI(TAG, "🗂️ Gallery: %u faces, %u new, %u duplicates, evicted %u LRU / %u TTL",
+             (unsigned)gallery.size, (unsigned)gallery.misses, (unsigned)gallery.hits,
+             (unsigned)gallery.evicted_lru, (unsigned)gallery.evicted_ttl);
+#if CONFIG_WHO_GALLERY_COMPARE_FLOAT
+    ESP_LOGI(TAG, "🧮 int8 vs float: %u/%u lookups disagree, max similarity error %.4f",
+             (unsigned)gallery.mismatches, (unsigned)gallery.compared, gallery.max_error);
+#endif
+}
+
+// Counters written by the detection task, logged from it.
+static void log_module_stats(void)
+{
+    who_detect_stats_t detect;
+    who_detect_get_stats(&detect);
+    ESP_LOGI(TAG, "🔎 Detector: %u passes, %u faces, %u over capacity",
+             (unsigned)detect.runs, (unsigned)detect.faces, (unsigned)detect.truncated);
+    ESP_LOGI(TAG, "🔎 Cascade: MNP01 ran %u times, skipped %u (all reused) / %u (below floor), %u faces reused, %u candidates capped, %u out of size range",
+             (unsigned)detect.mnp01_runs, (unsigned)detect.mnp01_skipped, (unsigned)detect.below_floor,
+             (unsigned)detect.reused, (unsigned)detect.capped, (unsigned)detect.out_of_range);
+#if CONFIG_WHO_PYRAMID_LEVELS
+    who_pyramid_stats_t pyramid;
+    who_pyramid_get_stats(&pyramid);
+    ESP_LOGI(TAG, "🔺 Pyramid: %u frames, %u levels in %u bytes of %s",
+             (unsigned)pyramid.builds, (unsigned)pyramid.levels, (unsigned)pyramid.arena_bytes,
+             pyramid.in_psram ? "PSRAM" : "internal RAM");
+#endif
+#if CONFIG_WHO_MOTION_GATE
+    who_motion_stats_t motion;
+    who_motion_gate_get_stats(&motion);
+    ESP_LOGI(TAG, "🚪 Motion gate: %u/%u frames gated, %u moving, %u refreshes",
+             (unsigned)motion.gated, (unsigned)motion.frames,
+             (unsigned)motion.moving, (unsigned)motion.refreshes);
+#endif
+    who_sched_stats_t sched;
+    who_sched_get_stats(&sched);
+    ESP_LOGI(TAG, "⏱️ Scheduler: %u active / %u idle / %u backoff frames, %u switches, %u starvation reports (max lag %u ms)",
+             (unsigned)sched.frames[WHO_SCHED_ACTIVE], (unsigned)sched.frames[WHO_SCHED_IDLE],
+             (unsigned)sched.frames[WHO_SCHED_BACKOFF], (unsigned)sched.switches,
+             (unsigned)sched.starvation_reports, (unsigned)sched.max_lag_ms);
+    who_face_ring_stats_t ring;
+    who_face_ring_get_stats(&ring);
+    ESP_LOGI(TAG, "🔁 Handoff: %u faces in %u batches to recognition, %u done, %u dropped (recognition behind)",
+             (unsigned)ring.faces, (unsigned)ring.published, (unsigned)ring.consumed, (unsigned)ring.dropped);
+    who_track_detect_stats_t track;
+    who_track_get_detect_stats(&track);
+    ESP_LOGI(TAG, "🧵 Tracks: %u started, %u faces of decided tracks not aligned, %u re-recognized after an appearance change",
+             (unsigned)track.tracks, (unsigned)track.cached, (unsigned)track.refreshed);
+    who_camera_stats_t camera;
+    who_camera_get_stats(&camera);
+    ESP_LOGI(TAG, "📷 Camera: %u captured, dropped %u %s / %u %s / %u %s, oldest admitted %u ms",
+             (unsigned)camera.captured,
+             (unsigned)camera.drops[WHO_CAMERA_DROP_EVICTED], who_camera_drop_name(WHO_CAMERA_DROP_EVICTED),
+             (unsigned)camera.drops[WHO_CAMERA_DROP_FULL], who_camera_drop_name(WHO_CAMERA_DROP_FULL),
+             (unsigned)camera.drops[WHO_CAMERA_DROP_STALE], who_camera_drop_name(WHO_CAMERA_DROP_STALE),
+             (unsigned)camera.max_age_ms);
+    ESP_LOGI(TAG, "📷 Frame age (ms) <33: %u, <66: %u, <100: %u, <200: %u, <500: %u, more: %u; queue 0/1/2/3+: %u/%u/%u/%u",
+             (unsigned)camera.age[0], (unsigned)camera.age[1], (unsigned)camera.age[2],
+             (unsigned)camera.age[3], (unsigned)camera.age[4], (unsigned)camera.age[5],
+             (unsigned)camera.queue[0], (unsigned)camera.queue[1], (unsigned)camera.queue[2], (unsigned)camera.queue[3]);
+    who_frame_stats_t shared;
+    who_frame_get_stats(&shared);
+    ESP_LOGI(TAG, "📷 Frames: %u published, %u shared with readers, %u returned, %u held, %u reader timeouts",
+             (unsigned)shared.published, (unsigned)shared.shared, (unsigned)shared.returned,
+             (unsigned)shared.held, (unsigned)shared.timeouts);
+#if CONFIG_WHO_ALIGN_COMPARE
+    who_align_stats_t align;
+    who_align_get_stats(&align);
+    ESP_LOGI(TAG, "📐 Fixed-point align vs align_face(): %u faces, mean diff %.3f, max %u, %u channels off by >1",
+             (unsigned)align.compared,
+             align.compared ? (double)align.sum_diff / (align.compared * WHO_ALIGN_SIZE * WHO_ALIGN_SIZE * 3) : 0.0,
+             (unsigned)align.max_diff, (unsigned)align.off_by_more);
+#endif
+#if CONFIG_WHO_QUALITY_GATE
+    who_quality_stats_t quality;
+    who_quality_get_stats(&quality);
+    ESP_LOGI(TAG, "🙈 Quality: %u/%u faces passed, rejected score %u, small %u, eyes %u, yaw %u, blur %u",
+             (unsigned)quality.outcomes[WHO_QUALITY_OK], (unsigned)quality.checked,
+             (unsigned)quality.outcomes[WHO_QUALITY_LOW_SCORE], (unsigned)quality.outcomes[WHO_QUALITY_TOO_SMALL],
+             (unsigned)quality.outcomes[WHO_QUALITY_EYES_TOO_CLOSE], (unsigned)quality.outcomes[WHO_QUALITY_YAW],
+             (unsigned)quality.outcomes[WHO_QUALITY_BLUR]);
+#endif
+#if CONFIG_WHO_ROI_REDETECT
+    who_roi_stats_t roi_stats;
+    who_roi_get_stats(&roi_stats);
+    ESP_LOGI(TAG, "🎯 ROI: %u crop passes (%u lost), %u full-frame passes",
+             (unsigned)roi_stats.roi_passes, (unsigned)roi_stats.lost,
+             (unsigned)roi_stats.full_passes);
+#endif
+}
+
+// Stage 2: recognition and logging. Owns the recognizer and the gallery, fed
+// with aligned faces by the detection stage through the face ring.
+static void task_recognize_handler(void *arg)
+{
+#if CONFIG_MFN_V1
+#if CONFIG_S8
+    FaceRecognition112V1S8 *recognizer = new FaceRecognition112V1S8();
+#elif CONFIG_S16
+    FaceRecognition112V1S16 *recognizer = new FaceRecognition112V1S16();
+#endif
+#endif
+    recognizer->set_partition(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, "fr");
+    
+    if (!who_gallery_init(CONFIG_WHO_GALLERY_CAPACITY, FACE_EMBEDDING_DIM, (int64_t)CONFIG_WHO_GALLERY_TTL_S * 1000000)) {
+        ESP_LOGE(TAG, "❌ Failed to allocate face gallery! Restarting...");
+        vTaskDelay(pdMS_TO_TICKS(5000));
+        esp_restart();
+    }
+
+    // On system reset: clear all stored faces
+    if (system_reset_flag) {
+        ESP_LOGI(TAG, "System reset detected - clearing all stored faces");
+        recognizer->clear_id(true);  // Clear with flash update
+        stored_face_id = -1;
+        system_reset_flag = false;
+        ESP_LOGI(TAG, "All faces cleared, ready for new enrollment");
+    } else {
+        load_gallery(recognizer);
+    }
+    
+    ESP_LOGI(TAG, "🚀 Face recognition task starting on core %d...", xPortGetCoreID());
+    ESP_LOGI(TAG, "📊 Similarity threshold: %.2f", SIMILARITY_THRESHOLD);
+    ESP_LOGI(TAG, "📊 Gallery: %d faces, TTL %d s", CONFIG_WHO_GALLERY_CAPACITY, CONFIG_WHO_GALLERY_TTL_S);
+
+#if CONFIG_S8
+    Tensor<int8_t> model_input;
+#elif CONFIG_S16
+    Tensor<int16_t> model_input;
+#endif
+    model_input.set_shape(recognizer->get_input_shape());
+    model_input.calloc_element();
+
+    Tensor<float> embedding;
+    embedding.set_shape({FACE_EMBEDDING_DIM});
+    embedding.calloc_element();
+
+    // One row per face of a batch.
+    Tensor<float> embeddings;
+    embeddings.set_shape({who_face_ring_batch(), FACE_EMBEDDING_DIM});
+    embeddings.calloc_element();
+
+    if (!model_input.element || !embedding.element || !embeddings.element) {
+        ESP_LOGE(TAG, "❌ Failed to allocate memory for recognition tensors! System may crash.");
+        vTaskDelay(pdMS_TO_TICKS(5000));
+        esp_restart(); // Better to restart than crash randomly later
+    }
+
+    bool gallery_dirty = false;
+    uint32_t batches = 0;
+    while (true)
+    {
+        // Short waits while a track is collecting, so a lost track is
+        // decided soon after its last face.
+        who_face_slot_t *slot = who_face_ring_peek(pdMS_TO_TICKS(who_track_pending() ? 100 : 1000));
+        int64_t stage_time = esp_timer_get_time();
+        if (slot)
+        {
+            // At most CONFIG_WHO_TRACK_SAMPLES forward passes per track.
+            int wanted[WHO_FACE_BATCH_MAX];
+            int count = 0;
+            for (int i = 0; i < slot->count; i++)
+            {
+                if (who_track_wants_sample(slot->track_id[i], stage_time))
+                    wanted[count++] = i;
+            }
+            if (count)
+            {
+                extract_embeddings(recognizer, slot->face, wanted, count, model_input, embedding, embeddings.element);
+                int64_t now = esp_timer_get_time();
+                for (int i = 0; i < count; i++)
+                    who_track_add_sample(slot->track_id[wanted[i]], embeddings.element + (size_t)i * FACE_EMBEDDING_DIM,
+                                         slot->weight[wanted[i]], now);
+                who_stats_record(WHO_STAGE_RECOGNIZE, now - stage_time);
+            }
+            who_stats_record(WHO_STAGE_LATENCY, esp_timer_get_time() - slot->frame_us);
+            who_face_ring_release();
+            if (++batches % STATS_LOG_INTERVAL == 0)
+                log_recognition_stats();
+        }
+
+        // New passenger or duplicate, once per track from its mean embedding.
+        who_track_decision_t decision;
+        while (who_track_next_decision(esp_timer_get_time(), &decision))
+        {
+            if (decide_track(decision, csv_gps_now()))
+                gallery_dirty = true;
+        }
+
+        // Trip over and every handed over face recognized: the only
+        // point the gallery is written to flash.
+        if (!slot && gallery_dirty && !who_track_pending() && !power_mgmt_is_trip_time()) {
+            save_gallery(recognizer);
+            gallery_dirty = false;
+        }
+    }
+}
+
+// Stage 1: motion gate, detection, quality gate and alignment. Returns the
+// frame to the camera as soon as the face is aligned into a ring slot, so
+// detection of the next frame overlaps with recognition of this one.
+static void task_detect_handler(void *arg)
 {
     camera_fb_t *frame = NULL;
     
@@ -161,87 +556,56 @@ static void task_process_handler(void *arg)
     ESP_LOGI(TAG, "💡 White Flash LED initialized on GPIO %d", LED_FLASH);
     
     // Relaxed thresholds for better detection (Increased sensitivity)
-    // resize_scale 0.4F is a good middle ground for QVGA
-    HumanFaceDetectMSR01 detector(0.20F, 0.3F, 10, 0.4F);  
-    HumanFaceDetectMNP01 detector2(0.25F, 0.3F, 10);      
+    // resize_scale follows from the face size range of the mounting height
+    if (!who_detect_init(0.20F, 0.3F, 10, CONFIG_WHO_DETECT_MIN_FACE_SIZE >> DETECT_SHIFT,
+                         CONFIG_WHO_DETECT_MAX_FACE_SIZE >> DETECT_SHIFT, 0.25F, 0.3F, 10, DETECT_PYRAMID_SHIFT)) {
+        ESP_LOGE(TAG, "❌ Failed to allocate face detectors! Restarting...");
+        vTaskDelay(pdMS_TO_TICKS(5000));
+        esp_restart();
+    }
+    who_detect_set_policy(CONFIG_WHO_DETECT_MNP01_TOP_K, CONFIG_WHO_DETECT_FLOOR_PERCENT,
+                          CONFIG_WHO_DETECT_REUSE_PASSES, CONFIG_WHO_DETECT_REUSE_IOU_PERCENT);
     
-    ESP_LOGI(TAG, "📊 Detector config: MSR01(score=0.20, scale=0.4), MNP01(score=0.25)");
+    ESP_LOGI(TAG, "📊 Detector config: MSR01(score=0.20, scale=%.2f from pyramid level %d), MNP01(score=0.25), faces %d-%d px",
+             who_detect_resize_scale(), who_detect_msr_shift(), CONFIG_WHO_DETECT_MIN_FACE_SIZE, CONFIG_WHO_DETECT_MAX_FACE_SIZE);
+    ESP_LOGI(TAG, "📊 Cascade: MNP01 on top %d candidates above %d%%, reuse for %d passes",
+             CONFIG_WHO_DETECT_MNP01_TOP_K, CONFIG_WHO_DETECT_FLOOR_PERCENT, CONFIG_WHO_DETECT_REUSE_PASSES);
 
-#if CONFIG_MFN_V1
-#if CONFIG_S8
-    FaceRecognition112V1S8 *recognizer = new FaceRecognition112V1S8();
-#elif CONFIG_S16
-    FaceRecognition112V1S16 *recognizer = new FaceRecognition112V1S16();
-#endif
-#endif
     show_state_t frame_show_state = SHOW_STATE_IDLE;
     recognizer_state_t _gEvent;
-    recognizer->set_partition(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, "fr");
-    
-    // On system reset: clear all stored faces
-    if (system_reset_flag) {
-        ESP_LOGI(TAG, "System reset detected - clearing all stored faces");
-        while (recognizer->get_enrolled_id_num() > 0) {
-            recognizer->delete_id(true);  // Delete with flash update
-        }
-        stored_face_id = -1;
-        system_reset_flag = false;
-        ESP_LOGI(TAG, "All faces cleared, ready for new enrollment");
-    } else {
-        recognizer->set_ids_from_flash();
-        if (recognizer->get_enrolled_id_num() > 0) {
-            stored_face_id = recognizer->get_enrolled_ids().back().id;
-            ESP_LOGI(TAG, "Loaded existing face ID: %d", stored_face_id);
-            
-            // Validate the loaded embedding
-            Tensor<float> &emb = recognizer->get_face_emb(stored_face_id);
-            bool is_valid = true;
-            float sum_sq = 0;
-            if (emb.element) {
-                for (int i = 0; i < emb.get_size(); i++) {
-                    if (isnan(emb.element[i]) || isinf(emb.element[i])) {
-                        is_valid = false;
-                        break;
-                    }
-                    sum_sq += emb.element[i] * emb.element[i];
-                }
-                if (sum_sq < 1e-6) is_valid = false;
-            } else {
-                is_valid = false;
-            }
 
-            if (!is_valid) {
-                 ESP_LOGW(TAG, "⚠️ Loaded ID %d has invalid embedding (NaN/Inf/Zero). Deleting...", stored_face_id);
-                 recognizer->delete_id(stored_face_id, true);
-                 stored_face_id = -1;
-                 recognizer->delete_id(stored_face_id, true);
-                 stored_face_id = -1;
-                 // faces_enrolled not yet defined/needed here as it starts at 0 later
-            } else {
-                 ESP_LOGI(TAG, "✅ Loaded ID %d embedding is valid (Norm Sq: %.4f)", stored_face_id, sum_sq);
-            }
-        }
-    }
-    
-    ESP_LOGI(TAG, "📊 Similarity threshold: %.2f", SIMILARITY_THRESHOLD);
-    ESP_LOGI(TAG, "📊 Detection throttle: %lld seconds", DETECTION_THROTTLE_US / 1000000);
+    who_sched_init(CONFIG_WHO_SCHED_ACTIVE_PERIOD_MS, CONFIG_WHO_SCHED_IDLE_PERIOD_MS, CONFIG_WHO_SCHED_IDLE_AFTER_MS,
+                   CONFIG_WHO_SCHED_STARVATION_MS, CONFIG_WHO_SCHED_BACKOFF_MS, CONFIG_WHO_SCHED_BACKOFF_HOLD_MS);
+    csv_uploader_set_lag_callback(who_sched_report_lag);
+    ESP_LOGI(TAG, "📊 Frame period: %d ms active, %d ms idle after %d ms without a face",
+             CONFIG_WHO_SCHED_ACTIVE_PERIOD_MS, CONFIG_WHO_SCHED_IDLE_PERIOD_MS, CONFIG_WHO_SCHED_IDLE_AFTER_MS);
+#if CONFIG_WHO_QUALITY_GATE
+    who_quality_init(CONFIG_WHO_QUALITY_MIN_SCORE_PERCENT, CONFIG_WHO_QUALITY_MIN_FACE_SIZE >> DETECT_SHIFT,
+                     CONFIG_WHO_QUALITY_MIN_EYE_DISTANCE >> DETECT_SHIFT, CONFIG_WHO_QUALITY_MAX_YAW_PERCENT,
+                     CONFIG_WHO_QUALITY_MIN_SHARPNESS);
+#endif
+#if CONFIG_WHO_ROI_REDETECT
+    who_roi_init(CONFIG_WHO_ROI_PADDING_PERCENT, CONFIG_WHO_ROI_FULL_FRAME_INTERVAL, CONFIG_WHO_ROI_MAX_AREA_PERCENT);
+    ESP_LOGI(TAG, "📊 ROI re-detection: padding=%d%%, full frame every %d frames",
+             CONFIG_WHO_ROI_PADDING_PERCENT, CONFIG_WHO_ROI_FULL_FRAME_INTERVAL);
+#endif
+#if CONFIG_WHO_MOTION_GATE
+    who_motion_gate_init(std::max(1, CONFIG_WHO_MOTION_STRIDE >> DETECT_SHIFT), CONFIG_WHO_MOTION_PIXEL_THRESHOLD,
+                         CONFIG_WHO_MOTION_POINT_THRESHOLD, CONFIG_WHO_MOTION_REFRESH_FRAMES);
+    ESP_LOGI(TAG, "📊 Motion gate: stride=%d, pixel>%d, points>%d, refresh=%d frames",
+             CONFIG_WHO_MOTION_STRIDE, CONFIG_WHO_MOTION_PIXEL_THRESHOLD,
+             CONFIG_WHO_MOTION_POINT_THRESHOLD, CONFIG_WHO_MOTION_REFRESH_FRAMES);
+#endif
     ESP_LOGI(TAG, "📊 Waiting for frames from camera...");
     
     int process_count = 0;
     int faces_detected = 0;
-
-    // Aligned face tensor for normalization (112x112 RGB)
-    Tensor<uint8_t> aligned_face;
-    aligned_face.set_shape({112, 112, 3});
-    aligned_face.calloc_element(); 
-    
-    if (!aligned_face.element) {
-        ESP_LOGE(TAG, "❌ Failed to allocate memory for aligned face tensor! System may crash.");
-        vTaskDelay(pdMS_TO_TICKS(5000));
-        esp_restart(); // Better to restart than crash randomly later
-    }
+    bool face_in_last_frame = false;
+    // Reused for every frame, detection results never touch the heap.
+    static who_faces_t detect_results;
 
     static bool was_paused = false;
+    who_sched_mode_t sched_mode = WHO_SCHED_IDLE;
     while (true)
     {
         // --- POWER SAVING: CHECK IF WE SHOULD BE DETECTING ---
@@ -257,89 +621,176 @@ static void task_process_handler(void *arg)
             was_paused = false;
         }
         
-        xSemaphoreTake(xMutex, portMAX_DELAY);
         _gEvent = RECOGNIZE;
-        gEvent = RECOGNIZE;
-        xSemaphoreGive(xMutex);
+        gEvent.store(RECOGNIZE);
 
         if (_gEvent)
         {
-            bool is_detected = false;
-
-            if (xQueueReceive(xQueueFrameI, &frame, portMAX_DELAY))
+            int64_t frame_age_us = 0;
+            if ((frame = who_camera_take(xQueueFrameI, portMAX_DELAY, &frame_age_us)) != NULL)
             {
                 process_count++;
+                who_stats_record(WHO_STAGE_AGE, frame_age_us);
                 
                 int64_t start_time = esp_timer_get_time();
-                std::list<dl::detect::result_t> &detect_candidates = detector.infer((uint16_t *)frame->buf, {(int)frame->height, (int)frame->width, 3});
-                std::list<dl::detect::result_t> &detect_results = detector2.infer((uint16_t *)frame->buf, {(int)frame->height, (int)frame->width, 3}, detect_candidates);
+                int64_t stage_time;
+                // Everything up to alignment works on the detection image,
+                // in its coordinates; only alignment reads the frame itself.
+                uint16_t *image = (uint16_t *)frame->buf;
+                int image_height = (int)frame->height;
+                int image_width = (int)frame->width;
+#if DETECT_SHIFT
+                image = NULL;
+                if (who_luma_init(image_height, image_width))
+                    image = (uint16_t *)who_luma_downscale(frame->buf, frame->format, image_height, image_width);
+                else
+                    ESP_LOGE(TAG, "❌ Failed to allocate the detection image");
+                image_height >>= DETECT_SHIFT;
+                image_width >>= DETECT_SHIFT;
+                who_stats_record(WHO_STAGE_LUMA, esp_timer_get_time() - start_time);
+#endif
+#if CONFIG_WHO_PYRAMID_LEVELS
+                // Downscaled once, for the motion gate, MSR01 and track
+                // thumbnails alike.
+                if (image)
+                {
+                    stage_time = esp_timer_get_time();
+                    if (who_pyramid_init(image_height, image_width, CONFIG_WHO_PYRAMID_LEVELS))
+                        who_pyramid_build(image, image_height, image_width);
+                    else
+                        ESP_LOGE(TAG, "❌ Failed to allocate the image pyramid");
+                    who_stats_record(WHO_STAGE_PYRAMID, esp_timer_get_time() - stage_time);
+                }
+#endif
+                int msr_shift = who_detect_msr_shift();
+                const who_pyramid_level_t *msr_level = who_pyramid_level(msr_shift);
+                bool run_detection = image != NULL && (!msr_shift || msr_level);
+#if CONFIG_WHO_MOTION_GATE
+                // Static doorway: skip the detector cascade. A face that was
+                // just found keeps it running even when standing still.
+                stage_time = esp_timer_get_time();
+                bool moving = image && who_motion_gate_check(image, image_height, image_width);
+                who_stats_record(WHO_STAGE_MOTION, esp_timer_get_time() - stage_time);
+                if (image && !moving && !face_in_last_frame)
+                {
+                    run_detection = false;
+                    who_motion_gate_mark_gated();
+                }
+#endif
+
+                detect_results.count = 0;
+                if (run_detection)
+                {
+                    uint16_t *roi_input = NULL;
+#if CONFIG_WHO_ROI_REDETECT
+                    // Search around the last face first, the full frame only
+                    // periodically or once the face is no longer in the window.
+                    who_roi_t roi;
+                    uint16_t *roi_msr_input = NULL;
+                    if (who_roi_select(image_height, image_width, &roi, msr_shift))
+                    {
+                        roi_input = who_roi_crop(image, image_width, &roi);
+                        if (roi_input && msr_shift)
+                        {
+                            roi_msr_input = who_roi_crop(msr_level->image, msr_level->shape.width, &roi, msr_shift);
+                            if (!roi_msr_input)
+                                roi_input = NULL;
+                        }
+                    }
+                    if (roi_input)
+                    {
+                        who_detect_run(roi_input, {roi.height, roi.width, 3}, &detect_results, roi.x, roi.y, roi_msr_input);
+                        who_roi_to_frame(&detect_results, &roi);
+                        who_roi_update(&detect_results, true);
+                        if (!detect_results.count)
+                            roi_input = NULL;
+                    }
+#endif
+                    if (!roi_input)
+                    {
+                        who_detect_run(image, {image_height, image_width, 3}, &detect_results, 0, 0,
+                                       msr_level ? msr_level->image : NULL);
+#if CONFIG_WHO_ROI_REDETECT
+                        who_roi_update(&detect_results, false);
+#endif
+                    }
+                }
+                face_in_last_frame = detect_results.count > 0;
+                // Every frame, also the empty ones: that is how tracks end.
+                int track_ids[WHO_DETECT_MAX_FACES];
+                who_track_assign(&detect_results, start_time, track_ids);
                 int64_t detection_time = (esp_timer_get_time() - start_time) / 1000;
 
-                if (detect_results.size() == 1) {
-                    is_detected = true;
-                    faces_detected++;
-                    ESP_LOGI(TAG, "✅ Face #%d found (%lld ms)", faces_detected, detection_time);
+                if (detect_results.count > 0) {
+                    faces_detected += detect_results.count;
+                    ESP_LOGI(TAG, "✅ %d face(s) found, #%d so far (%lld ms)", detect_results.count, faces_detected, detection_time);
                     flash_led_on_face_detect();
-                } else if (detect_results.size() > 1) {
-                    ESP_LOGW(TAG, "Multiple faces detected, ignoring");
                 } else if (process_count % 20 == 0) {
-                    ESP_LOGI(TAG, "🔍 Scanning... Frame %d (Enrolled: %d)", process_count, (int)recognizer->get_enrolled_id_num());
+                    ESP_LOGI(TAG, "🔍 Scanning... Frame %d", process_count);
                 }
 
-                if (is_detected)
+                // Pick the faces worth recognizing, at most one batch of them.
+                int batch[WHO_FACE_BATCH_MAX];
+                int batch_count = 0;
+                for (int i = 0; i < detect_results.count && batch_count < who_face_ring_batch(); i++)
                 {
-                    gps_data_t current_gps = gps_get_current_data();
-                    csv_gps_data_t csv_gps = {
-                        .latitude = current_gps.latitude,
-                        .longitude = current_gps.longitude,
-                        .altitude = current_gps.altitude,
-                        .satellites = current_gps.satellites,
-                        .valid = current_gps.valid,
-                        .timestamp = {0}
-                    };
-                    strncpy(csv_gps.timestamp, current_gps.timestamp, sizeof(csv_gps.timestamp) - 1);
-
-                    // --- INSTANT 1-SHOT LOGIC ---
-                    if (recognizer->get_enrolled_id_num() == 0)
+                    const who_face_t &face = detect_results.face[i];
+                    // Someone standing in the doorway: once their track has been
+                    // handed its samples, skip quality, alignment and MFN until
+                    // the face looks different.
+                    if (!who_track_wants_face(&track_ids[i], image, image_height, image_width, face))
+                        continue;
+#if CONFIG_WHO_QUALITY_GATE
+                    // Tiny, turned away or blurred faces are not worth an MFN
+                    // forward pass and would only be logged as bogus new people.
+                    stage_time = esp_timer_get_time();
+                    who_quality_t quality = who_quality_check(image, image_height, image_width, face);
+                    who_stats_record(WHO_STAGE_QUALITY, esp_timer_get_time() - stage_time);
+                    if (quality != WHO_QUALITY_OK)
                     {
-                        // Case A: First person ever detected
-                        face_recognition_tool::align_face((uint16_t *)frame->buf, {(int)frame->height, (int)frame->width, 3}, &aligned_face, detect_results.front().keypoint);
-                        recognizer->enroll_id(aligned_face, "", true);
-                        stored_face_id = recognizer->get_enrolled_ids().back().id;
-                        
-                        Tensor<float> &last_embedding = recognizer->get_face_emb(-1);
-                        ESP_LOGI(TAG, "🎉 FIRST PASSENGER LOGGED (Instant): ID %d", stored_face_id);
-                        csv_logger_log_face(stored_face_id, last_embedding.element, last_embedding.get_size(), csv_gps, NULL, 0);
-                        csv_uploader_trigger_now();
+                        ESP_LOGI(TAG, "🙈 Face skipped, poor quality (%s)", who_quality_name(quality));
+                        continue;
                     }
-                    else
+#endif
+                    batch[batch_count++] = i;
+                }
+
+                if (batch_count)
+                {
+                    // Align straight into a free ring slot, the frame is not
+                    // needed past this point.
+                    who_face_slot_t *slot = who_face_ring_acquire();
+                    if (slot)
                     {
-                        // Case B: Compare with current passenger
-                        face_recognition_tool::align_face((uint16_t *)frame->buf, {(int)frame->height, (int)frame->width, 3}, &aligned_face, detect_results.front().keypoint);
-                        recognize_result = recognizer->recognize(aligned_face);
-                        
-                        if (recognize_result.similarity < SIMILARITY_THRESHOLD) 
+                        for (int b = 0; b < batch_count; b++)
                         {
-                            // INSTANT NEW PERSON (Similarity < 0.5)
-                            ESP_LOGW(TAG, "🆕 NEW PERSON DETECTED (Sim: %.3f). Replacing cache...", recognize_result.similarity);
-                            
-                            // Wipe old local cache immediately
-                            while (recognizer->get_enrolled_id_num() > 0) recognizer->delete_id(true);
-                            
-                            // Enroll new face immediately
-                            recognizer->enroll_id(aligned_face, "", true);
-                            stored_face_id = recognizer->get_enrolled_ids().back().id;
-                            
-                            Tensor<float> &new_embedding = recognizer->get_face_emb(-1);
-                            ESP_LOGI(TAG, "🔄 NEW PASSENGER LOGGED (Instant): ID %d", stored_face_id);
-                            csv_logger_log_face(stored_face_id, new_embedding.element, new_embedding.get_size(), csv_gps, NULL, 0);
-                            csv_uploader_trigger_now();
-                        }
-                        else 
-                        {
-                            // SAME PERSON (Similarity >= 0.5)
-                            ESP_LOGI(TAG, "⏭️ DUPLICATE (Sim: %.3f, ID %d). Skipping.", recognize_result.similarity, recognize_result.id);
+                            const who_face_t &face = detect_results.face[batch[b]];
+                            stage_time = esp_timer_get_time();
+#if CONFIG_WHO_ALIGN_FIXED_POINT
+                            // Color comes back only here, for 112x112 pixels.
+                            int keypoint[WHO_FACE_KEYPOINTS];
+                            for (int k = 0; k < WHO_FACE_KEYPOINTS; k++)
+                                keypoint[k] = face.keypoint[k] << DETECT_SHIFT;
+                            who_align_face(frame->buf, frame->format, (int)frame->height, (int)frame->width, keypoint, slot->face[b]);
+#else
+                            std::vector<int> keypoint(face.keypoint, face.keypoint + WHO_FACE_KEYPOINTS);
+                            face_recognition_tool::align_face((uint16_t *)frame->buf, {(int)frame->height, (int)frame->width, 3}, &slot->face[b], keypoint);
+#endif
+                            who_stats_record(WHO_STAGE_ALIGN, esp_timer_get_time() - stage_time);
+                            slot->track_id[b] = track_ids[batch[b]];
+                            slot->weight[b] = who_quality_weight(face);
                         }
+                        slot->count = batch_count;
+                        slot->frame_us = start_time;
+                        slot->frame_index = process_count;
+                        slot->published_us = esp_timer_get_time();
+                        who_face_ring_publish();
+                        for (int b = 0; b < batch_count; b++)
+                            who_track_mark_published(track_ids[batch[b]], image, image_height, image_width, detect_results.face[batch[b]]);
+                    }
+                    else
+                    {
+                        ESP_LOGW(TAG, "Recognition busy, %d face(s) dropped", batch_count);
                     }
                 }
 
@@ -357,28 +808,40 @@ static void task_process_handler(void *arg)
                 {
                     if (xQueueSend(xQueueFrameO, &frame, pdMS_TO_TICKS(10)) != pdTRUE)
                     {
-                        if (gReturnFB) esp_camera_fb_return(frame);
+                        if (gReturnFB) who_frame_release(frame);
                         else free(frame);
                     }
                 }
                 else if (gReturnFB)
                 {
-                    esp_camera_fb_return(frame);
+                    // Readers sharing this frame keep it until they are done.
+                    who_frame_release(frame);
                 }
                 else
                 {
                     free(frame);
                 }
 
-                if (xQueueResult && is_detected)
+                int64_t end_time = esp_timer_get_time();
+                who_stats_record(WHO_STAGE_FRAME, end_time - start_time);
+                who_stats_frame_done(end_time);
+                if (process_count % STATS_LOG_INTERVAL == 0)
                 {
-                    xQueueSend(xQueueResult, &recognize_result, portMAX_DELAY);
+                    who_stats_log_summary(TAG);
+                    log_module_stats();
                 }
 
                 // --- CPU BREATHING ROOM ---
-                // We add a tiny delay after processing to ensure background tasks 
-                // (WiFi, GPS, Heartbeat) get enough CPU cycles on Core 0.
-                vTaskDelay(pdMS_TO_TICKS(50));
+                // Full rate while people are boarding, slow when nobody is
+                // around or when the upload task reports it is starved.
+                who_sched_mode_t last_mode = sched_mode;
+                TickType_t delay = who_sched_frame_done(face_in_last_frame, start_time);
+                who_sched_stats_t sched;
+                who_sched_get_stats(&sched);
+                sched_mode = sched.mode;
+                if (sched_mode != last_mode)
+                    ESP_LOGI(TAG, "⏱️ Frame rate: %s, %u ms sleep", who_sched_mode_name(sched_mode), (unsigned)sched.last_delay_ms);
+                vTaskDelay(delay);
             }
         }
     }
@@ -390,9 +853,7 @@ static void task_event_handler(void *arg)
     while (true)
     {
         xQueueReceive(xQueueEvent, &(_gEvent), portMAX_DELAY);
-        xSemaphoreTake(xMutex, portMAX_DELAY);
-        gEvent = _gEvent;
-        xSemaphoreGive(xMutex);
+        gEvent.store(_gEvent);
     }
 }
 
@@ -407,9 +868,25 @@ void register_human_face_recognition(const QueueHandle_t frame_i,
     xQueueEvent = event;
     xQueueResult = result;
     gReturnFB = camera_fb_return;
-    xMutex = xSemaphoreCreateMutex();
 
-    xTaskCreatePinnedToCore(task_process_handler, TAG, 8 * 1024, NULL, 5, NULL, 0);
+    if (!who_face_ring_init(CONFIG_WHO_PIPELINE_RING_SLOTS, CONFIG_WHO_PIPELINE_BATCH_FACES, {112, 112, 3})) {
+        ESP_LOGE(TAG, "❌ Failed to allocate aligned face slots! Restarting...");
+        vTaskDelay(pdMS_TO_TICKS(5000));
+        esp_restart();
+    }
+    if (!who_track_init(CONFIG_WHO_TRACK_MAX, FACE_EMBEDDING_DIM, CONFIG_WHO_TRACK_SAMPLES,
+                        CONFIG_WHO_TRACK_IOU_PERCENT, CONFIG_WHO_TRACK_SPLIT_PERCENT,
+                        CONFIG_WHO_TRACK_REFRESH_DIFF, (int64_t)CONFIG_WHO_TRACK_LOST_MS * 1000)) {
+        ESP_LOGE(TAG, "❌ Failed to allocate face tracks! Restarting...");
+        vTaskDelay(pdMS_TO_TICKS(5000));
+        esp_restart();
+    }
+
+    // Consumer first, the ring needs its handle before anything is published.
+    TaskHandle_t recognize_task = NULL;
+    xTaskCreatePinnedToCore(task_recognize_handler, TAG, 8 * 1024, NULL, 5, &recognize_task, WHO_RECOGNIZE_CORE);
+    who_face_ring_set_consumer(recognize_task);
+    xTaskCreatePinnedToCore(task_detect_handler, TAG, 8 * 1024, NULL, 5, NULL, WHO_DETECT_CORE);
     if (xQueueEvent)
         xTaskCreatePinnedToCore(task_event_handler, TAG, 8 * 1024, NULL, 5, NULL, 1);
 }
@@ -4,6 +4,17 @@
 #include "freertos/queue.h"
 #include "freertos/task.h"
 #include "freertos/semphr.h"
+#include "sdkconfig.h"
+#include "sensor.h"
+
+// Capture format the detection stage is built for, see "Detection input".
+#if CONFIG_WHO_DETECT_INPUT_GRAYSCALE
+#define WHO_CAMERA_PIXFORMAT PIXFORMAT_GRAYSCALE
+#elif CONFIG_WHO_DETECT_INPUT_YUV422
+#define WHO_CAMERA_PIXFORMAT PIXFORMAT_YUV422
+#else
+#define WHO_CAMERA_PIXFORMAT PIXFORMAT_RGB565
+#endif
 
 typedef enum
 {
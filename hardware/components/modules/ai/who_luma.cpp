@@ -0,0 +1,125 @@
+#include "who_luma.hpp"
+
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+
+#include "img_line_convert.h"
+
+static const char *TAG = "luma";
+
+static uint16_t *s_image = NULL;
+static uint8_t *s_rows = NULL;    /*<! two frame rows of gray, for RGB565 frames */
+static int s_height = 0;
+static int s_width = 0;
+static uint16_t s_gray565[256];   /*<! gray level -> RGB565, camera byte order */
+static who_luma_stats_t s_stats = {};
+
+bool who_luma_init(int height, int width)
+{
+    if (s_image && height == s_height && width == s_width)
+        return true;
+    heap_caps_free(s_image);
+    heap_caps_free(s_rows);
+    s_image = NULL;
+    s_rows = (uint8_t *)heap_caps_malloc((size_t)width * 2, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (!s_rows)
+    {
+        s_height = s_width = 0;
+        return false;
+    }
+
+    size_t size = (size_t)(height / 2) * (width / 2) * sizeof(uint16_t);
+    s_image = (uint16_t *)heap_caps_malloc(size, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    s_stats.in_psram = 0;
+    if (!s_image)
+    {
+        s_image = (uint16_t *)heap_caps_malloc(size, MALLOC_CAP_SPIRAM);
+        s_stats.in_psram = 1;
+        ESP_LOGW(TAG, "No internal RAM for the %u byte detection image, using PSRAM", (unsigned)size);
+    }
+    if (!s_image)
+    {
+        s_height = s_width = 0;
+        return false;
+    }
+    s_height = height;
+    s_width = width;
+
+    for (int g = 0; g < 256; g++)
+    {
+        uint16_t rgb565 = ((g >> 3) << 11) | ((g >> 2) << 5) | (g >> 3);
+        s_gray565[g] = (uint16_t)((rgb565 >> 8) | (rgb565 << 8));
+    }
+    return true;
+}
+
+// Y of pixel x in a row, for each frame format.
+static inline int luma_gray(const uint8_t *row, int x) { return row[x]; }
+static inline int luma_yuv422(const uint8_t *row, int x) { return row[x * 2]; }
+
+template <int (*luma)(const uint8_t *, int)>
+static void downscale_row(const uint8_t *top, const uint8_t *bottom, uint16_t *out)
+{
+    const int w = s_width / 2;
+    for (int x = 0; x < w; x++)
+    {
+        int sum = luma(top, x * 2) + luma(top, x * 2 + 1) + luma(bottom, x * 2) + luma(bottom, x * 2 + 1);
+        *out++ = s_gray565[(sum + 2) >> 2];
+    }
+}
+
+template <int (*luma)(const uint8_t *, int)>
+static void downscale(const uint8_t *frame, int stride, uint16_t *out)
+{
+    const int h = s_height / 2;
+    const int w = s_width / 2;
+    for (int y = 0; y < h; y++)
+    {
+        const uint8_t *top = frame + (size_t)(y * 2) * stride;
+        downscale_row<luma>(top, top + stride, out + (size_t)y * w);
+    }
+}
+
+// RGB565 has no Y to read: each row pair is converted to gray first.
+static void downscale_rgb565(const uint8_t *frame, uint16_t *out)
+{
+    const int h = s_height / 2;
+    const int w = s_width / 2;
+    const size_t stride = (size_t)s_width * 2;
+    for (int y = 0; y < h; y++)
+    {
+        const uint8_t *top = frame + (size_t)(y * 2) * stride;
+        line_rgb565_to_gray(top, s_rows, s_width);
+        line_rgb565_to_gray(top + stride, s_rows + s_width, s_width);
+        downscale_row<luma_gray>(s_rows, s_rows + s_width, out + (size_t)y * w);
+    }
+}
+
+const uint16_t *who_luma_downscale(const uint8_t *frame, pixformat_t format, int height, int width)
+{
+    if (!s_image || height != s_height || width != s_width)
+        return NULL;
+
+    switch (format)
+    {
+    case PIXFORMAT_GRAYSCALE:
+        downscale<luma_gray>(frame, width, s_image);
+        break;
+    case PIXFORMAT_YUV422:
+        downscale<luma_yuv422>(frame, width * 2, s_image);
+        break;
+    case PIXFORMAT_RGB565:
+        downscale_rgb565(frame, s_image);
+        break;
+    default:
+        s_stats.unsupported++;
+        return NULL;
+    }
+    s_stats.frames++;
+    return s_image;
+}
+
+void who_luma_get_stats(who_luma_stats_t *stats)
+{
+    *stats = s_stats;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdint.h>
+#include "sensor.h"
+
+/**
+ * @brief Luminance detection image counters.
+ */
+typedef struct
+{
+    uint32_t frames;        /*<! detection images built */
+    uint32_t unsupported;   /*<! frames in a format without luminance, e.g. JPEG */
+    uint32_t in_psram;      /*<! 1 when the image did not fit in internal RAM */
+} who_luma_stats_t;
+
+/**
+ * @brief Allocate the detection image for frames of this size, internal RAM
+ *        first: a quarter of the pixels at 2 bytes each, 37.5 KB for QVGA,
+ *        plus two rows of gray for RGB565 frames.
+ *
+ * @return false when it cannot be allocated
+ */
+bool who_luma_init(int height, int width);
+
+/**
+ * @brief Build the half resolution detection image of a frame: each pixel
+ *        the mean luminance of a 2x2 block, as gray RGB565 in camera byte
+ *        order for the detectors. Only the Y bytes of the frame are read.
+ *
+ * @param frame  frame buffer
+ * @param format PIXFORMAT_GRAYSCALE, PIXFORMAT_YUV422 (Y0 U Y1 V) or PIXFORMAT_RGB565
+ * @param height frame height
+ * @param width  frame width
+ * @return height/2 x width/2 image, valid until the next call, NULL for
+ *         other formats or sizes
+ */
+const uint16_t *who_luma_downscale(const uint8_t *frame, pixformat_t format, int height, int width);
+
+/**
+ * @brief Get a copy of the counters.
+ */
+void who_luma_get_stats(who_luma_stats_t *stats);
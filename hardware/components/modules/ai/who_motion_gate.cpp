@@ -0,0 +1,132 @@
+#include "who_motion_gate.hpp"
+
+#include <string.h>
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+
+#include "dl_image.hpp"
+#include "who_pyramid.hpp"
+
+static const char *TAG = "motion_gate";
+
+static uint16_t *s_reference = NULL;
+static uint16_t *s_current = NULL;
+static int s_capacity = 0;
+static int s_ref_height = 0;
+static int s_ref_width = 0;
+
+static int s_stride = 8;
+static int s_pixel_threshold = 5;
+static int s_point_threshold = 12;
+static int s_refresh_frames = 30;
+static int s_static_frames = 0;
+
+static who_motion_stats_t s_stats = {};
+
+void who_motion_gate_init(int stride, int pixel_threshold, int point_threshold, int refresh_frames)
+{
+    s_stride = stride > 0 ? stride : 1;
+    s_pixel_threshold = pixel_threshold;
+    s_point_threshold = point_threshold;
+    s_refresh_frames = refresh_frames > 0 ? refresh_frames : 1;
+    s_ref_height = 0;
+    s_ref_width = 0;
+    s_static_frames = 0;
+    memset(&s_stats, 0, sizeof(s_stats));
+}
+
+// Sized lazily from the first frame, a QVGA frame at stride 8 needs 2x 2.4 KB.
+static bool ensure_buffers(int points)
+{
+    if (points <= s_capacity)
+        return true;
+
+    heap_caps_free(s_reference);
+    heap_caps_free(s_current);
+    s_reference = (uint16_t *)heap_caps_malloc(points * sizeof(uint16_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    s_current = (uint16_t *)heap_caps_malloc(points * sizeof(uint16_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (!s_reference || !s_current)
+    {
+        ESP_LOGE(TAG, "Failed to allocate %d sample points", points);
+        heap_caps_free(s_reference);
+        heap_caps_free(s_current);
+        s_reference = s_current = NULL;
+        s_capacity = 0;
+        return false;
+    }
+    s_capacity = points;
+    return true;
+}
+
+bool who_motion_gate_check(uint16_t *frame, int height, int width)
+{
+    s_stats.frames++;
+
+    int h = height / s_stride;
+    int w = width / s_stride;
+    if (h <= 0 || w <= 0 || !ensure_buffers(h * w))
+    {
+        s_stats.moving++;
+        return true;
+    }
+
+    // Same points from the pyramid level the stride divides into, each
+    // the mean of its block rather than one pixel of sensor noise.
+    int shift = __builtin_ctz(s_stride);
+    const uint16_t *src = frame;
+    int src_width = width;
+    int stride = s_stride;
+    const who_pyramid_level_t *level = who_pyramid_find(frame, shift, &shift);
+    if (level)
+    {
+        src = level->image;
+        src_width = level->shape.width;
+        stride >>= shift;
+    }
+
+    uint16_t *out = s_current;
+    for (int y = 0; y < h; y++)
+    {
+        const uint16_t *row = src + (y * stride) * src_width;
+        for (int x = 0; x < w; x++)
+            *out++ = row[x * stride];
+    }
+
+    bool moving;
+    if (h != s_ref_height || w != s_ref_width)
+    {
+        s_ref_height = h;
+        s_ref_width = w;
+        s_stats.last_points = h * w;
+        moving = true;
+    }
+    else
+    {
+        s_stats.last_points = dl::image::get_moving_point_number(s_current, s_reference, h, w, 1, s_pixel_threshold);
+        moving = (int)s_stats.last_points > s_point_threshold;
+    }
+
+    if (moving || ++s_static_frames >= s_refresh_frames)
+    {
+        uint16_t *swap = s_reference;
+        s_reference = s_current;
+        s_current = swap;
+        if (!moving)
+            s_stats.refreshes++;
+        s_static_frames = 0;
+    }
+
+    if (moving)
+        s_stats.moving++;
+    return moving;
+}
+
+void who_motion_gate_mark_gated(void)
+{
+    s_stats.gated++;
+}
+
+void who_motion_gate_get_stats(who_motion_stats_t *stats)
+{
+    *stats = s_stats;
+}
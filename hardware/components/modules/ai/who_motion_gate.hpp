@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * @brief Motion gate counters.
+ */
+typedef struct
+{
+    uint32_t frames;        /*<! frames checked by the gate */
+    uint32_t moving;        /*<! frames judged moving */
+    uint32_t gated;         /*<! frames the detector was skipped on */
+    uint32_t refreshes;     /*<! reference frame replacements without motion */
+    uint32_t last_points;   /*<! activated points of the last checked frame */
+} who_motion_stats_t;
+
+/**
+ * @brief Set the gate parameters and drop the reference frame.
+ *
+ * @param stride          distance between sampled pixels
+ * @param pixel_threshold activation threshold of one sample point
+ * @param point_threshold activated points above which a frame is moving
+ * @param refresh_frames  static frames after which the reference is replaced
+ */
+void who_motion_gate_init(int stride, int pixel_threshold, int point_threshold, int refresh_frames);
+
+/**
+ * @brief Compare an RGB565 frame against the reference frame.
+ *
+ * The frame is sampled at the configured stride into a small buffer which is
+ * compared with dl::image::get_moving_point_number(). When the pyramid was
+ * built from the frame, the points come from the coarsest level the stride
+ * divides into, each the mean of its block. The reference is
+ * replaced on motion and every refresh_frames static frames. A frame size
+ * change resets the reference and counts as motion, so does running out of
+ * memory for the sample buffers.
+ *
+ * @param frame  RGB565 frame
+ * @param height frame height
+ * @param width  frame width
+ * @return true when the frame is moving
+ */
+bool who_motion_gate_check(uint16_t *frame, int height, int width);
+
+/**
+ * @brief Count one frame the detector was skipped on.
+ */
+void who_motion_gate_mark_gated(void);
+
+/**
+ * @brief Get a copy of the gate counters.
+ */
+void who_motion_gate_get_stats(who_motion_stats_t *stats);
@@ -0,0 +1,126 @@
+#include "who_pipeline_stats.hpp"
+
+#include <algorithm>
+#include <string.h>
+#include "esp_log.h"
+
+// Samples kept per stage for the percentiles. Each stage is written by a
+// single task, readers only ever see a slightly stale window.
+#define WHO_STATS_WINDOW 128
+
+typedef struct
+{
+    int32_t samples[WHO_STATS_WINDOW];
+    uint32_t count;
+    int64_t total_us;
+    int64_t max_us;
+} stage_stats_t;
+
+static stage_stats_t s_stages[WHO_STAGE_MAX];
+static int64_t s_first_frame_us = 0;
+static int64_t s_last_frame_us = 0;
+static uint32_t s_frames = 0;
+
+static const char *s_stage_names[WHO_STAGE_MAX] = {
+    "luma",
+    "pyramid",
+    "motion",
+    "msr01",
+    "mnp01",
+    "quality",
+    "align",
+    "recognize",
+    "match",
+    "enroll",
+    "log",
+    "frame",
+    "latency",
+    "age",
+};
+
+void who_stats_record(who_stage_t stage, int64_t elapsed_us)
+{
+    if (stage >= WHO_STAGE_MAX)
+        return;
+
+    stage_stats_t *s = &s_stages[stage];
+    s->samples[s->count % WHO_STATS_WINDOW] = (int32_t)elapsed_us;
+    s->count++;
+    s->total_us += elapsed_us;
+    if (elapsed_us > s->max_us)
+        s->max_us = elapsed_us;
+}
+
+void who_stats_frame_done(int64_t now_us)
+{
+    if (s_frames == 0)
+        s_first_frame_us = now_us;
+    s_last_frame_us = now_us;
+    s_frames++;
+}
+
+static int64_t percentile(const int32_t *sorted, uint32_t n, int pct)
+{
+    uint32_t idx = (n * pct + 99) / 100;
+    if (idx > 0)
+        idx--;
+    return sorted[std::min(idx, n - 1)];
+}
+
+bool who_stats_get(who_stage_t stage, who_stage_summary_t *summary)
+{
+    if (stage >= WHO_STAGE_MAX || !summary)
+        return false;
+
+    stage_stats_t *s = &s_stages[stage];
+    if (s->count == 0)
+        return false;
+
+    int32_t sorted[WHO_STATS_WINDOW];
+    uint32_t n = std::min<uint32_t>(s->count, WHO_STATS_WINDOW);
+    memcpy(sorted, s->samples, n * sizeof(int32_t));
+    std::sort(sorted, sorted + n);
+
+    summary->count = s->count;
+    summary->mean_us = s->total_us / s->count;
+    summary->p50_us = percentile(sorted, n, 50);
+    summary->p95_us = percentile(sorted, n, 95);
+    summary->p99_us = percentile(sorted, n, 99);
+    summary->max_us = s->max_us;
+    return true;
+}
+
+float who_stats_get_fps(void)
+{
+    if (s_frames < 2 || s_last_frame_us <= s_first_frame_us)
+        return 0.0f;
+    return (float)(s_frames - 1) * 1000000.0f / (float)(s_last_frame_us - s_first_frame_us);
+}
+
+const char *who_stats_stage_name(who_stage_t stage)
+{
+    return stage < WHO_STAGE_MAX ? s_stage_names[stage] : "?";
+}
+
+void who_stats_log_summary(const char *tag)
+{
+    who_stage_summary_t summary;
+    for (int i = 0; i < WHO_STAGE_MAX; i++)
+    {
+        if (!who_stats_get((who_stage_t)i, &summary))
+            continue;
+        ESP_LOGI(tag, "⏱️ %-9s n=%-6u p50=%6lld p95=%6lld p99=%6lld max=%6lld us",
+                 s_stage_names[i], (unsigned)summary.count,
+                 (long long)summary.p50_us, (long long)summary.p95_us,
+                 (long long)summary.p99_us, (long long)summary.max_us);
+    }
+    ESP_LOGI(tag, "⏱️ %u frames, %.2f fps", (unsigned)s_frames, who_stats_get_fps());
+}
+
+void who_stats_reset(void)
+{
+    memset(s_stages, 0, sizeof(s_stages));
+    s_first_frame_us = 0;
+    s_last_frame_us = 0;
+    s_frames = 0;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * @brief Stages of the face pipeline that are timed individually.
+ */
+typedef enum
+{
+    WHO_STAGE_LUMA = 0,         /*<! half resolution luminance image for detection */
+    WHO_STAGE_PYRAMID,          /*<! downscaled levels of the detection image */
+    WHO_STAGE_MOTION,           /*<! motion gate check */
+    WHO_STAGE_DETECT_MSR01,     /*<! MSR01 candidate detection */
+    WHO_STAGE_DETECT_MNP01,     /*<! MNP01 refinement + keypoints */
+    WHO_STAGE_QUALITY,          /*<! face quality gate */
+    WHO_STAGE_ALIGN,            /*<! face_recognition_tool::align_face */
+    WHO_STAGE_RECOGNIZE,        /*<! MFN forward into the track's mean embedding */
+    WHO_STAGE_MATCH,            /*<! gallery lookup of a decided track */
+    WHO_STAGE_ENROLL,           /*<! gallery insert of a new face */
+    WHO_STAGE_LOG,              /*<! csv_logger_log_face + uploader trigger */
+    WHO_STAGE_FRAME,            /*<! detection stage per frame, dequeue to release */
+    WHO_STAGE_LATENCY,          /*<! frame dequeue to recognition done, across both stages */
+    WHO_STAGE_AGE,              /*<! frame capture to dequeue, time spent in the camera queue */
+    WHO_STAGE_MAX,
+} who_stage_t;
+
+/**
+ * @brief Latency summary of one stage, in microseconds.
+ */
+typedef struct
+{
+    uint32_t count; /*<! samples recorded since reset */
+    int64_t mean_us;
+    int64_t p50_us;
+    int64_t p95_us;
+    int64_t p99_us;
+    int64_t max_us;
+} who_stage_summary_t;
+
+/**
+ * @brief Record one latency sample of a stage.
+ *
+ * Only the most recent WHO_STATS_WINDOW samples take part in the percentiles,
+ * count/mean/max cover everything since the last reset.
+ *
+ * @param stage   stage the sample belongs to
+ * @param elapsed elapsed time in microseconds
+ */
+void who_stats_record(who_stage_t stage, int64_t elapsed_us);
+
+/**
+ * @brief Mark one frame as completed, used for the frames-per-second figure.
+ *
+ * @param now_us current esp_timer time
+ */
+void who_stats_frame_done(int64_t now_us);
+
+/**
+ * @brief Get the latency summary of a stage.
+ *
+ * @param stage   stage to summarize
+ * @param summary output summary
+ * @return false when the stage has no samples yet
+ */
+bool who_stats_get(who_stage_t stage, who_stage_summary_t *summary);
+
+/**
+ * @brief Get the frame rate over all frames completed since the last reset.
+ */
+float who_stats_get_fps(void);
+
+/**
+ * @brief Get the printable name of a stage.
+ */
+const char *who_stats_stage_name(who_stage_t stage);
+
+/**
+ * @brief Print one line per stage with p50/p95/p99 and the frame rate.
+ *
+ * @param tag log tag to print under
+ */
+void who_stats_log_summary(const char *tag);
+
+/**
+ * @brief Drop all samples.
+ */
+void who_stats_reset(void);
@@ -0,0 +1,124 @@
+#include "who_pyramid.hpp"
+
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+
+static const char *TAG = "pyramid";
+
+static uint16_t *s_arena = NULL;
+static size_t s_arena_size = 0;
+static int s_height = 0;
+static int s_width = 0;
+static int s_levels = 0;    /*<! levels below the image the arena holds */
+static int s_built = 0;     /*<! levels of the last build, the image included */
+static who_pyramid_level_t s_level[WHO_PYRAMID_MAX_LEVELS + 1];
+static who_pyramid_stats_t s_stats = {};
+
+bool who_pyramid_init(int height, int width, int levels)
+{
+    if (levels > WHO_PYRAMID_MAX_LEVELS)
+        levels = WHO_PYRAMID_MAX_LEVELS;
+    while (levels > 0 && ((height >> levels) < 1 || (width >> levels) < 1))
+        levels--;
+    if (height == s_height && width == s_width && levels == s_levels && (s_arena || !levels))
+        return true;
+
+    heap_caps_free(s_arena);
+    s_arena = NULL;
+    s_built = 0;
+    size_t size = 0;
+    for (int l = 1; l <= levels; l++)
+        size += (size_t)(height >> l) * (width >> l) * sizeof(uint16_t);
+    if (size)
+    {
+        s_arena = (uint16_t *)heap_caps_malloc(size, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+        s_stats.in_psram = 0;
+        if (!s_arena)
+        {
+            s_arena = (uint16_t *)heap_caps_malloc(size, MALLOC_CAP_SPIRAM);
+            s_stats.in_psram = 1;
+            ESP_LOGW(TAG, "No internal RAM for the %u byte pyramid, using PSRAM", (unsigned)size);
+        }
+        if (!s_arena)
+        {
+            s_height = s_width = s_levels = 0;
+            s_arena_size = 0;
+            return false;
+        }
+    }
+    s_arena_size = size;
+    s_height = height;
+    s_width = width;
+    s_levels = levels;
+    s_stats.levels = levels;
+    s_stats.arena_bytes = size;
+    return true;
+}
+
+// Camera byte order to R, G and B apart in one word, with room for the sum
+// of four pixels: B in bits 0-4, R in 11-15, G in 21-26.
+static inline uint32_t spread(uint16_t pixel)
+{
+    uint32_t c = (uint16_t)((pixel >> 8) | (pixel << 8));
+    return (c | (c << 16)) & 0x07E0F81F;
+}
+
+static inline uint16_t pack(uint32_t sum)
+{
+    // Rounded per channel: 2 added to each field before the shift.
+    uint32_t s = ((sum + 0x00401002) >> 2) & 0x07E0F81F;
+    uint16_t c = (uint16_t)(s | (s >> 16));
+    return (uint16_t)((c >> 8) | (c << 8));
+}
+
+static void halve(const uint16_t *src, int src_width, uint16_t *dst, int height, int width)
+{
+    for (int y = 0; y < height; y++)
+    {
+        const uint16_t *top = src + (size_t)(y * 2) * src_width;
+        const uint16_t *bottom = top + src_width;
+        for (int x = 0; x < width; x++, top += 2, bottom += 2)
+            *dst++ = pack(spread(top[0]) + spread(top[1]) + spread(bottom[0]) + spread(bottom[1]));
+    }
+}
+
+int who_pyramid_build(const uint16_t *image, int height, int width)
+{
+    s_built = 0;
+    if (!image || height != s_height || width != s_width)
+        return 0;
+
+    s_level[0].image = image;
+    s_level[0].shape = {height, width, 3};
+    uint16_t *out = s_arena;
+    for (int l = 1; l <= s_levels; l++)
+    {
+        const who_pyramid_level_t &above = s_level[l - 1];
+        int h = height >> l, w = width >> l;
+        halve(above.image, above.shape.width, out, h, w);
+        s_level[l].image = out;
+        s_level[l].shape = {h, w, 3};
+        out += (size_t)h * w;
+    }
+    s_built = s_levels + 1;
+    s_stats.builds++;
+    return s_built;
+}
+
+const who_pyramid_level_t *who_pyramid_level(int level)
+{
+    return level >= 0 && level < s_built ? &s_level[level] : NULL;
+}
+
+const who_pyramid_level_t *who_pyramid_find(const uint16_t *image, int max_shift, int *shift)
+{
+    if (!s_built || s_level[0].image != image)
+        return NULL;
+    *shift = max_shift < s_built ? (max_shift > 0 ? max_shift : 0) : s_built - 1;
+    return &s_level[*shift];
+}
+
+void who_pyramid_get_stats(who_pyramid_stats_t *stats)
+{
+    *stats = s_stats;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <stdint.h>
+#include "who_face_detect.hpp"
+
+#define WHO_PYRAMID_MAX_LEVELS 4    // levels below the image, down to 1/16
+
+/**
+ * @brief One level of the pyramid, in the form the detectors take.
+ */
+typedef struct
+{
+    const uint16_t *image;  /*<! RGB565, camera byte order */
+    who_shape_t shape;      /*<! height, width, channel 3 */
+} who_pyramid_level_t;
+
+/**
+ * @brief Pyramid counters.
+ */
+typedef struct
+{
+    uint32_t builds;        /*<! images the levels were built for */
+    uint32_t levels;        /*<! levels below the image */
+    uint32_t arena_bytes;   /*<! size of the level buffer */
+    uint32_t in_psram;      /*<! 1 when the levels did not fit in internal RAM */
+} who_pyramid_stats_t;
+
+/**
+ * @brief Allocate one buffer for every level below images of this size,
+ *        internal RAM first: a third of the image for 3 levels, 50 KB for a
+ *        QVGA RGB565 frame, 12.6 KB for its half resolution luminance.
+ *
+ * @param height image height
+ * @param width  image width
+ * @param levels levels below the image, at most WHO_PYRAMID_MAX_LEVELS;
+ *               fewer when the image runs out of pixels first
+ * @return false when the buffer cannot be allocated
+ */
+bool who_pyramid_init(int height, int width, int levels);
+
+/**
+ * @brief Build the levels of an image, once per frame before any consumer
+ *        reads them: each pixel the mean of a 2x2 block of the level above,
+ *        channel by channel, odd last rows and columns dropped.
+ *
+ * @param image  RGB565 image, level 0; not copied, has to outlive the levels
+ * @param height image height
+ * @param width  image width
+ * @return levels available including the image, 0 for another size than
+ *         who_pyramid_init() was called with
+ */
+int who_pyramid_build(const uint16_t *image, int height, int width);
+
+/**
+ * @brief Level of the last built image, valid until the next build.
+ *
+ * @param level 0 for the image itself, n for 1/2^n of its size
+ * @return NULL past the coarsest level
+ */
+const who_pyramid_level_t *who_pyramid_level(int level);
+
+/**
+ * @brief Coarsest level of an image, at most 2^max_shift smaller: where a
+ *        consumer shrinking the image by 2^max_shift or more starts from.
+ *
+ * @param image     image the caller works on
+ * @param max_shift wanted level
+ * @param shift     output, level returned
+ * @return NULL when the pyramid was not built from this image
+ */
+const who_pyramid_level_t *who_pyramid_find(const uint16_t *image, int max_shift, int *shift);
+
+/**
+ * @brief Get a copy of the counters.
+ */
+void who_pyramid_get_stats(who_pyramid_stats_t *stats);
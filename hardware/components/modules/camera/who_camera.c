@@ -1,9 +1,42 @@
 #include "who_camera.h"
+#include "who_frame.h"
+#include "who_file_camera.h"
 #include "esp_log.h"
 #include "esp_system.h"
+#include "esp_timer.h"
 
 static const char *TAG = "who_camera";
 static QueueHandle_t xQueueFrameO = NULL;
+// Written by the camera task and by who_camera_take() callers.
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static who_camera_stats_t s_stats = {0};
+
+static const int s_age_bounds_ms[WHO_CAMERA_AGE_BUCKETS - 1] = {33, 66, 100, 200, 500};
+
+static const char *s_drop_names[WHO_CAMERA_DROP_MAX] = {
+    "evicted",
+    "full",
+    "stale",
+};
+
+// Drops of this reason so far, this one included.
+static uint32_t count_drop(who_camera_drop_t reason)
+{
+    portENTER_CRITICAL(&s_lock);
+    uint32_t drops = ++s_stats.drops[reason];
+    s_stats.dropped++;
+    portEXIT_CRITICAL(&s_lock);
+    return drops;
+}
+
+// A captured frame, with the frames queued ahead of it.
+static void count_captured(UBaseType_t waiting)
+{
+    portENTER_CRITICAL(&s_lock);
+    s_stats.captured++;
+    s_stats.queue[waiting < WHO_CAMERA_QUEUE_BUCKETS ? waiting : WHO_CAMERA_QUEUE_BUCKETS - 1]++;
+    portEXIT_CRITICAL(&s_lock);
+}
 
 static void task_process_handler(void *arg)
 {
@@ -28,19 +61,27 @@ static void task_process_handler(void *arg)
                          frame_count, frame_success, frame_dropped, frame->len);
             }
             
+            // The AI queue holds the first reference, a /capture request
+            // waiting right now shares the same buffer.
+            who_frame_publish(frame);
+            count_captured(uxQueueMessagesWaiting(xQueueFrameO));
+
             // Try to send frame, but don't block forever if queue is full
             if (xQueueSend(xQueueFrameO, &frame, pdMS_TO_TICKS(100)) != pdTRUE) {
                 // Queue full - drop oldest frame and try again
                 camera_fb_t *old_frame = NULL;
                 if (xQueueReceive(xQueueFrameO, &old_frame, 0) == pdTRUE) {
-                    esp_camera_fb_return(old_frame);
+                    who_frame_release(old_frame);
+                    count_drop(WHO_CAMERA_DROP_EVICTED);
                     if (xQueueSend(xQueueFrameO, &frame, 0) != pdTRUE) {
-                        esp_camera_fb_return(frame);
+                        who_frame_release(frame);
                         frame_dropped++;
+                        count_drop(WHO_CAMERA_DROP_FULL);
                     }
                 } else {
-                    esp_camera_fb_return(frame);
+                    who_frame_release(frame);
                     frame_dropped++;
+                    count_drop(WHO_CAMERA_DROP_FULL);
                 }
                 
                 // Only log every 10th drop to reduce spam
@@ -51,6 +92,9 @@ static void task_process_handler(void *arg)
         } else {
             consecutive_failures++;
             failure_count++;
+            portENTER_CRITICAL(&s_lock);
+            s_stats.failures++;
+            portEXIT_CRITICAL(&s_lock);
             
             // Only log every 10th failure to reduce spam
             if (failure_count % 10 == 0) {
@@ -70,10 +114,9 @@ static void task_process_handler(void *arg)
     }
 }
 
-void register_camera(const pixformat_t pixel_fromat,
-                    const framesize_t frame_size,
-                    const uint8_t fb_count,
-                    const QueueHandle_t frame_o)
+static bool init_sensor(const pixformat_t pixel_fromat,
+                        const framesize_t frame_size,
+                        const uint8_t fb_count)
 {
     ESP_LOGI(TAG, "Camera module is %s", CAMERA_MODULE_NAME);
 
@@ -115,16 +158,29 @@ void register_camera(const pixformat_t pixel_fromat,
     config.pixel_format = pixel_fromat;
     config.frame_size = frame_size;
     config.jpeg_quality = 30;
-    config.fb_count = fb_count >= 3 ? fb_count : 3;
+    // Readers share frames instead of queueing copies, two buffers keep
+    // the DMA running while one is being read.
+    config.fb_count = fb_count >= 2 ? fb_count : 2;
     config.fb_location = CAMERA_FB_IN_PSRAM;
     config.grab_mode = CAMERA_GRAB_LATEST;
+    // Decimation and conversion happen in the driver's DMA copy (ESP32).
+#if CONFIG_CAMERA_FB_DECIMATION
+    config.fb_decimation = CONFIG_CAMERA_FB_DECIMATION;
+#else
+    config.fb_decimation = 1;
+#endif
+#if CONFIG_CAMERA_YUV_TO_RGB565
+    config.fb_yuv_to_rgb565 = true;
+#else
+    config.fb_yuv_to_rgb565 = false;
+#endif
 
     // camera init
     esp_err_t err = esp_camera_init(&config);
     if (err != ESP_OK)
     {
         ESP_LOGE(TAG, "Camera init failed with error 0x%x", err);
-        return;
+        return false;
     }
 
     sensor_t *s = esp_camera_sensor_get();
@@ -151,7 +207,100 @@ void register_camera(const pixformat_t pixel_fromat,
         
         ESP_LOGI(TAG, "📷 Camera set to AUTO mode for dynamic bus lighting");
     }
+    return true;
+}
+
+void register_camera(const pixformat_t pixel_fromat,
+                    const framesize_t frame_size,
+                    const uint8_t fb_count,
+                    const QueueHandle_t frame_o)
+{
+#if CONFIG_CAMERA_SOURCE_FILE
+    who_file_camera_config_t replay = {
+        .dir = CONFIG_CAMERA_FILE_DIR,
+        .width = resolution[frame_size].width,
+        .height = resolution[frame_size].height,
+        .fps = CONFIG_CAMERA_FILE_FPS,
+        .fb_count = fb_count >= 2 ? fb_count : 2,
+        .loops = CONFIG_CAMERA_FILE_LOOPS,
+    };
+    esp_err_t err = who_file_camera_start(&replay);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "❌ Recorded frames unavailable (0x%x), camera not started", err);
+        return;
+    }
+#endif
+
+    if (esp_camera_get_fb_source())
+    {
+        ESP_LOGI(TAG, "📼 Frames come from a frame source, sensor left alone");
+    }
+    else if (!init_sensor(pixel_fromat, frame_size, fb_count))
+    {
+        return;
+    }
+
+    if (!who_frame_init())
+    {
+        ESP_LOGE(TAG, "❌ Failed to allocate frame readers! Restarting...");
+        vTaskDelay(pdMS_TO_TICKS(5000));
+        esp_restart();
+    }
 
     xQueueFrameO = frame_o;
     xTaskCreatePinnedToCore(task_process_handler, TAG, 3 * 1024, NULL, 6, NULL, 1);
-}
\ No newline at end of file
+}
+
+camera_fb_t *who_camera_take(const QueueHandle_t queue, TickType_t timeout, int64_t *age_us)
+{
+    camera_fb_t *frame = NULL;
+    while (xQueueReceive(queue, &frame, timeout) == pdTRUE)
+    {
+        // Same clock as the driver's frame stamp.
+        int64_t age = esp_timer_get_time() - ((int64_t)frame->timestamp.tv_sec * 1000000 + frame->timestamp.tv_usec);
+        int age_ms = age > 0 ? (int)(age / 1000) : 0;
+#if CONFIG_CAMERA_MAX_FRAME_AGE_MS
+        if (age_ms > CONFIG_CAMERA_MAX_FRAME_AGE_MS)
+        {
+            // Decisions on it would be about people who already moved on,
+            // a fresher frame is at most one capture away.
+            who_frame_release(frame);
+            uint32_t stale = count_drop(WHO_CAMERA_DROP_STALE);
+            if (stale % 10 == 1)
+                ESP_LOGW(TAG, "Frame %d ms old at dequeue, dropped (%u stale so far)",
+                         age_ms, (unsigned)stale);
+            continue;
+        }
+#endif
+        int bucket = 0;
+        while (bucket < WHO_CAMERA_AGE_BUCKETS - 1 && age_ms >= s_age_bounds_ms[bucket])
+            bucket++;
+        portENTER_CRITICAL(&s_lock);
+        s_stats.age[bucket]++;
+        if ((uint32_t)age_ms > s_stats.max_age_ms)
+            s_stats.max_age_ms = age_ms;
+        portEXIT_CRITICAL(&s_lock);
+        if (age_us)
+            *age_us = age;
+        return frame;
+    }
+    return NULL;
+}
+
+const char *who_camera_drop_name(who_camera_drop_t reason)
+{
+    return reason < WHO_CAMERA_DROP_MAX ? s_drop_names[reason] : "?";
+}
+
+int who_camera_age_bucket_ms(int bucket)
+{
+    return bucket >= 0 && bucket < WHO_CAMERA_AGE_BUCKETS - 1 ? s_age_bounds_ms[bucket] : 0;
+}
+
+void who_camera_get_stats(who_camera_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+}
@@ -194,6 +194,34 @@
 
 #define XCLK_FREQ_HZ 15000000
 
+#define WHO_CAMERA_AGE_BUCKETS 6    /*<! frame age histogram: <33, <66, <100, <200, <500, >=500 ms */
+#define WHO_CAMERA_QUEUE_BUCKETS 4  /*<! queue occupancy histogram: 0, 1, 2, 3+ frames waiting */
+
+/**
+ * @brief Why a captured frame never reached the consumer.
+ */
+typedef enum
+{
+    WHO_CAMERA_DROP_EVICTED = 0,    /*<! oldest queued frame pushed out by a newer one */
+    WHO_CAMERA_DROP_FULL,           /*<! new frame released, the queue stayed full */
+    WHO_CAMERA_DROP_STALE,          /*<! older than CONFIG_CAMERA_MAX_FRAME_AGE_MS at dequeue */
+    WHO_CAMERA_DROP_MAX,
+} who_camera_drop_t;
+
+/**
+ * @brief Camera task counters.
+ */
+typedef struct
+{
+    uint32_t captured;      /*<! frames taken from esp_camera_fb_get() */
+    uint32_t dropped;       /*<! frames released unprocessed, sum of drops[] */
+    uint32_t failures;      /*<! esp_camera_fb_get() calls that returned no frame */
+    uint32_t drops[WHO_CAMERA_DROP_MAX];        /*<! dropped frames by reason */
+    uint32_t age[WHO_CAMERA_AGE_BUCKETS];       /*<! capture to dequeue age of admitted frames */
+    uint32_t queue[WHO_CAMERA_QUEUE_BUCKETS];   /*<! frames already waiting when one is queued */
+    uint32_t max_age_ms;    /*<! oldest frame admitted */
+} who_camera_stats_t;
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -234,12 +262,42 @@ extern "C"
      *                     - FRAMESIZE_P_FHD,    // 1080x1920
      *                     - FRAMESIZE_QSXGA,    // 2560x1920
      * @param fb_count     Number of frame buffers to be allocated. If more than one, then each frame will be acquired (double speed)
+     *
+     * With a frame source installed (esp_camera_set_fb_source(), e.g. by
+     * who_file_camera_start() or CONFIG_CAMERA_SOURCE_FILE) the sensor is
+     * not initialized and the camera task reads the source instead.
      */
     void register_camera(const pixformat_t pixel_fromat,
                          const framesize_t frame_size,
                          const uint8_t fb_count,
                          const QueueHandle_t frame_o);
 
+    /**
+     * @brief Take the next frame off the camera's frame queue, releasing the
+     *        ones captured more than CONFIG_CAMERA_MAX_FRAME_AGE_MS ago.
+     *
+     * @param queue   the frame_o queue given to register_camera()
+     * @param timeout how long to wait for each frame
+     * @param age_us  capture to dequeue age of the returned frame, may be NULL
+     * @return frame to release with who_frame_release(), NULL on timeout
+     */
+    camera_fb_t *who_camera_take(const QueueHandle_t queue, TickType_t timeout, int64_t *age_us);
+
+    /**
+     * @brief Get the printable name of a drop reason.
+     */
+    const char *who_camera_drop_name(who_camera_drop_t reason);
+
+    /**
+     * @brief Get the upper bound of a frame age bucket in ms, 0 for the last.
+     */
+    int who_camera_age_bucket_ms(int bucket);
+
+    /**
+     * @brief Get a copy of the camera task counters.
+     */
+    void who_camera_get_stats(who_camera_stats_t *stats);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,286 @@
+#include "who_file_camera.h"
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "img_converters.h"
+
+static const char *TAG = "who_file_camera";
+
+#define FB_GET_TIMEOUT_MS 2000  // same as esp_camera_fb_get()
+#define PATH_SIZE 256
+
+static who_file_camera_config_t s_config;
+static char s_dir[PATH_SIZE];
+static char **s_files = NULL;
+static int s_file_count = 0;
+static int s_next = 0;
+static camera_fb_t *s_fbs = NULL;
+static QueueHandle_t s_free = NULL;     /*<! buffers not handed out */
+static uint8_t *s_jpeg = NULL;          /*<! compressed file being decoded */
+static size_t s_jpeg_size = 0;
+static int64_t s_period_us = 0;
+static int64_t s_due_us = 0;            /*<! when the next frame is captured */
+static who_file_camera_stats_t s_stats = {0};
+static camera_fb_source_t s_source;
+
+static bool is_jpeg(const char *name)
+{
+    const char *dot = strrchr(name, '.');
+    return dot && (!strcasecmp(dot, ".jpg") || !strcasecmp(dot, ".jpeg"));
+}
+
+static int compare_names(const void *a, const void *b)
+{
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+static bool list_files(const char *dir)
+{
+    DIR *d = opendir(dir);
+    if (!d)
+        return false;
+    int capacity = 0;
+    struct dirent *ent;
+    while ((ent = readdir(d)) != NULL)
+    {
+        if (ent->d_name[0] == '.')
+            continue;
+        if (s_file_count == capacity)
+        {
+            capacity = capacity ? capacity * 2 : 64;
+            char **files = (char **)realloc(s_files, capacity * sizeof(char *));
+            if (!files)
+                break;
+            s_files = files;
+        }
+        s_files[s_file_count] = strdup(ent->d_name);
+        if (s_files[s_file_count])
+            s_file_count++;
+    }
+    closedir(d);
+    qsort(s_files, s_file_count, sizeof(char *), compare_names);
+    return s_file_count > 0;
+}
+
+// Frame size from the SOFn segment.
+static bool jpeg_size(const uint8_t *data, size_t len, int *width, int *height)
+{
+    if (len < 4 || data[0] != 0xFF || data[1] != 0xD8)
+        return false;
+    size_t i = 2;
+    while (i + 9 < len && data[i] == 0xFF)
+    {
+        uint8_t marker = data[i + 1];
+        if (marker >= 0xC0 && marker <= 0xC3)
+        {
+            *height = (data[i + 5] << 8) | data[i + 6];
+            *width = (data[i + 7] << 8) | data[i + 8];
+            return true;
+        }
+        i += 2 + ((data[i + 2] << 8) | data[i + 3]);
+    }
+    return false;
+}
+
+static bool load_file(const char *name, camera_fb_t *fb)
+{
+    char path[PATH_SIZE];
+    snprintf(path, sizeof(path), "%s/%s", s_dir, name);
+    FILE *f = fopen(path, "rb");
+    if (!f)
+        return false;
+    fseek(f, 0, SEEK_END);
+    long len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    bool ok = false;
+    if (len > 0 && is_jpeg(name))
+    {
+        if ((size_t)len > s_jpeg_size)
+        {
+            heap_caps_free(s_jpeg);
+            s_jpeg = (uint8_t *)heap_caps_malloc(len, MALLOC_CAP_SPIRAM);
+            if (!s_jpeg)
+                s_jpeg = (uint8_t *)heap_caps_malloc(len, MALLOC_CAP_8BIT);
+            s_jpeg_size = s_jpeg ? len : 0;
+        }
+        int width = 0, height = 0;
+        ok = s_jpeg && fread(s_jpeg, 1, len, f) == (size_t)len &&
+             jpeg_size(s_jpeg, len, &width, &height) &&
+             width == s_config.width && height == s_config.height &&
+             jpg2rgb_rect(s_jpeg, len, 0, 0, width, height, JPG_SCALE_NONE, PIXFORMAT_RGB565, fb->buf);
+    }
+    else if (len > 0)
+    {
+        ok = (size_t)len == fb->len && fread(fb->buf, 1, len, f) == (size_t)len;
+    }
+    fclose(f);
+    if (!ok)
+        ESP_LOGW(TAG, "Skipping %s: unreadable or not %dx%d", path, s_config.width, s_config.height);
+    return ok;
+}
+
+// Next file that loads, false once every pass is done.
+static bool load_next(camera_fb_t *fb)
+{
+    int misses = 0;
+    while (!s_stats.finished)
+    {
+        if (s_config.loops > 0 && (int)s_stats.loops >= s_config.loops)
+        {
+            s_stats.finished = true;
+            break;
+        }
+        const char *name = s_files[s_next];
+        if (++s_next == s_file_count)
+        {
+            s_next = 0;
+            s_stats.loops++;
+        }
+        if (load_file(name, fb))
+            return true;
+        s_stats.skipped++;
+        if (++misses == s_file_count)
+        {
+            ESP_LOGE(TAG, "No file in %s loads", s_dir);
+            s_stats.finished = true;
+        }
+    }
+    return false;
+}
+
+static camera_fb_t *file_fb_get(void *ctx)
+{
+    camera_fb_t *fb = NULL;
+    if (s_stats.finished)
+    {
+        // Like a sensor that stopped sending: wait out the timeout.
+        usleep(FB_GET_TIMEOUT_MS * 1000);
+        return NULL;
+    }
+    if (xQueueReceive(s_free, &fb, pdMS_TO_TICKS(FB_GET_TIMEOUT_MS)) != pdTRUE)
+        return NULL;
+    if (!load_next(fb))
+    {
+        xQueueSend(s_free, &fb, 0);
+        ESP_LOGI(TAG, "📼 Replay of %s done: %u frames, %u late, %u skipped",
+                 s_dir, (unsigned)s_stats.served, (unsigned)s_stats.late, (unsigned)s_stats.skipped);
+        return NULL;
+    }
+
+    // The file is read ahead of its slot, like the sensor exposing while the
+    // previous frame is processed. usleep() and not vTaskDelay(): the host
+    // replay scales task delays away, the frame rate has to hold anyway.
+    int64_t now = esp_timer_get_time();
+    int64_t captured = now;
+    if (s_period_us)
+    {
+        if (now < s_due_us)
+        {
+            usleep(s_due_us - now);
+        }
+        else if (now - s_due_us >= s_period_us)
+        {
+            // Every buffer was held past the slot, the sensor would have
+            // skipped frames: restart the schedule from here.
+            s_stats.late++;
+            s_due_us = now;
+        }
+        captured = s_due_us;
+        s_due_us += s_period_us;
+    }
+    fb->timestamp.tv_sec = captured / 1000000;
+    fb->timestamp.tv_usec = captured % 1000000;
+    s_stats.served++;
+    return fb;
+}
+
+static void file_fb_return(void *ctx, camera_fb_t *fb)
+{
+    xQueueSend(s_free, &fb, 0);
+}
+
+// Undoes a start that failed half way, so that it can be tried again.
+static esp_err_t release_all(esp_err_t err)
+{
+    if (s_fbs)
+    {
+        for (int i = 0; i < s_config.fb_count; i++)
+            heap_caps_free(s_fbs[i].buf);
+        free(s_fbs);
+        s_fbs = NULL;
+    }
+    if (s_free)
+    {
+        vQueueDelete(s_free);
+        s_free = NULL;
+    }
+    for (int i = 0; i < s_file_count; i++)
+        free(s_files[i]);
+    free(s_files);
+    s_files = NULL;
+    s_file_count = 0;
+    return err;
+}
+
+esp_err_t who_file_camera_start(const who_file_camera_config_t *config)
+{
+    if (s_free)
+        return ESP_ERR_INVALID_STATE;
+
+    s_config = *config;
+    if (s_config.fb_count < 1)
+        s_config.fb_count = 1;
+    snprintf(s_dir, sizeof(s_dir), "%s", config->dir);
+    s_config.dir = s_dir;
+    if (!list_files(s_dir))
+    {
+        ESP_LOGE(TAG, "No frame files in %s", s_dir);
+        return release_all(ESP_ERR_NOT_FOUND);
+    }
+
+    size_t size = (size_t)s_config.width * s_config.height * 2;
+    s_fbs = (camera_fb_t *)calloc(s_config.fb_count, sizeof(camera_fb_t));
+    s_free = xQueueCreate(s_config.fb_count, sizeof(camera_fb_t *));
+    if (!s_fbs || !s_free)
+        return release_all(ESP_ERR_NO_MEM);
+    for (int i = 0; i < s_config.fb_count; i++)
+    {
+        camera_fb_t *fb = &s_fbs[i];
+        fb->buf = (uint8_t *)heap_caps_malloc(size, MALLOC_CAP_SPIRAM);
+        if (!fb->buf)
+            fb->buf = (uint8_t *)heap_caps_malloc(size, MALLOC_CAP_8BIT);
+        if (!fb->buf)
+            return release_all(ESP_ERR_NO_MEM);
+        fb->len = size;
+        fb->width = s_config.width;
+        fb->height = s_config.height;
+        fb->format = PIXFORMAT_RGB565;
+        xQueueSend(s_free, &fb, 0);
+    }
+
+    s_period_us = s_config.fps > 0 ? (int64_t)(1000000.0f / s_config.fps) : 0;
+    s_due_us = esp_timer_get_time();
+    s_source.fb_get = file_fb_get;
+    s_source.fb_return = file_fb_return;
+    s_source.ctx = NULL;
+    esp_camera_set_fb_source(&s_source);
+    ESP_LOGI(TAG, "📼 Serving %d files from %s at %.1f fps, %dx%d RGB565",
+             s_file_count, s_dir, s_config.fps, s_config.width, s_config.height);
+    return ESP_OK;
+}
+
+void who_file_camera_get_stats(who_file_camera_stats_t *stats)
+{
+    *stats = s_stats;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "esp_camera.h"
+
+/**
+ * @brief Recorded frames to serve in place of the sensor.
+ */
+typedef struct
+{
+    const char *dir;        /*<! directory of .jpg/.jpeg or raw RGB565 files, served in name order */
+    int width;              /*<! frame width, raw files are width x height x 2 bytes */
+    int height;             /*<! frame height, files of another size are skipped */
+    float fps;              /*<! frames per second, 0 = as fast as buffers come back */
+    int fb_count;           /*<! frame buffers, like camera_config_t.fb_count */
+    int loops;              /*<! passes over the directory, 0 = forever */
+} who_file_camera_config_t;
+
+/**
+ * @brief File camera counters.
+ */
+typedef struct
+{
+    uint32_t served;        /*<! frames handed out */
+    uint32_t late;          /*<! frames served after their slot, every buffer was held */
+    uint32_t skipped;       /*<! files that could not be read, decoded or had another size */
+    uint32_t loops;         /*<! completed passes over the directory */
+    bool finished;          /*<! every pass done, esp_camera_fb_get() returns NULL */
+} who_file_camera_stats_t;
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+    /**
+     * @brief Serve esp_camera_fb_get() from the files of a directory, at the
+     *        configured frame rate and stamped with the time each frame is
+     *        due, the way the driver stamps the first DMA buffer. JPEGs are
+     *        decoded to RGB565. Call before register_camera(), which then
+     *        leaves the sensor alone.
+     *
+     * @return ESP_OK, ESP_ERR_NOT_FOUND without frame files,
+     *         ESP_ERR_NO_MEM when the buffers cannot be allocated
+     */
+    esp_err_t who_file_camera_start(const who_file_camera_config_t *config);
+
+    /**
+     * @brief Get a copy of the counters.
+     */
+    void who_file_camera_get_stats(who_file_camera_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,174 @@
+#include "who_frame.h"
+
+#include "freertos/queue.h"
+#include "esp_log.h"
+
+static const char *TAG = "who_frame";
+
+typedef struct
+{
+    camera_fb_t *fb;
+    int refs;
+} entry_t;
+
+typedef struct
+{
+    QueueHandle_t queue;    /*<! one frame, handed over by who_frame_publish() */
+    bool busy;              /*<! owned by a who_frame_wait() call */
+    bool waiting;           /*<! not handed a frame yet */
+} reader_t;
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static entry_t s_entries[WHO_FRAME_MAX_FRAMES];
+static reader_t s_readers[WHO_FRAME_MAX_READERS];
+static who_frame_stats_t s_stats = {0};
+
+bool who_frame_init(void)
+{
+    for (int i = 0; i < WHO_FRAME_MAX_READERS; i++)
+    {
+        if (s_readers[i].queue)
+            continue;
+        s_readers[i].queue = xQueueCreate(1, sizeof(camera_fb_t *));
+        if (!s_readers[i].queue)
+        {
+            ESP_LOGE(TAG, "Failed to allocate reader queues");
+            return false;
+        }
+    }
+    return true;
+}
+
+// Called with s_lock held.
+static entry_t *find_entry(const camera_fb_t *fb)
+{
+    for (int i = 0; i < WHO_FRAME_MAX_FRAMES; i++)
+    {
+        if (s_entries[i].fb == fb)
+            return &s_entries[i];
+    }
+    return NULL;
+}
+
+void who_frame_publish(camera_fb_t *fb)
+{
+    QueueHandle_t handoff[WHO_FRAME_MAX_READERS];
+    int handoff_count = 0;
+
+    portENTER_CRITICAL(&s_lock);
+    s_stats.published++;
+    entry_t *entry = find_entry(NULL);
+    if (entry)
+    {
+        entry->fb = fb;
+        entry->refs = 1;
+        s_stats.held++;
+        for (int i = 0; i < WHO_FRAME_MAX_READERS; i++)
+        {
+            if (!s_readers[i].waiting)
+                continue;
+            s_readers[i].waiting = false;
+            entry->refs++;
+            handoff[handoff_count++] = s_readers[i].queue;
+        }
+        s_stats.shared += handoff_count;
+    }
+    else
+    {
+        // Single owner, exactly like before frames were shared.
+        s_stats.untracked++;
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    // A reader's queue is empty while it waits, see who_frame_wait().
+    for (int i = 0; i < handoff_count; i++)
+        xQueueSend(handoff[i], &fb, 0);
+}
+
+camera_fb_t *who_frame_wait(TickType_t timeout)
+{
+    reader_t *reader = NULL;
+    portENTER_CRITICAL(&s_lock);
+    for (int i = 0; i < WHO_FRAME_MAX_READERS; i++)
+    {
+        if (s_readers[i].queue && !s_readers[i].busy)
+        {
+            reader = &s_readers[i];
+            reader->busy = true;
+            reader->waiting = true;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&s_lock);
+    if (!reader)
+    {
+        ESP_LOGW(TAG, "Too many readers waiting for a frame");
+        return NULL;
+    }
+
+    camera_fb_t *fb = NULL;
+    if (xQueueReceive(reader->queue, &fb, timeout) != pdTRUE)
+    {
+        // A frame published between the timeout and here is on its way.
+        portENTER_CRITICAL(&s_lock);
+        bool handed = !reader->waiting;
+        reader->waiting = false;
+        if (!handed)
+            s_stats.timeouts++;
+        portEXIT_CRITICAL(&s_lock);
+        if (!handed || xQueueReceive(reader->queue, &fb, portMAX_DELAY) != pdTRUE)
+            fb = NULL;
+    }
+
+    portENTER_CRITICAL(&s_lock);
+    reader->busy = false;
+    portEXIT_CRITICAL(&s_lock);
+    return fb;
+}
+
+void who_frame_retain(camera_fb_t *fb)
+{
+    portENTER_CRITICAL(&s_lock);
+    entry_t *entry = find_entry(fb);
+    if (!entry && (entry = find_entry(NULL)) != NULL)
+    {
+        // Never published: the caller's reference plus the new one.
+        entry->fb = fb;
+        entry->refs = 1;
+        s_stats.held++;
+    }
+    if (entry)
+        entry->refs++;
+    portEXIT_CRITICAL(&s_lock);
+    if (!entry)
+        ESP_LOGE(TAG, "No entry left to share a frame");
+}
+
+void who_frame_release(camera_fb_t *fb)
+{
+    bool last = true;
+    portENTER_CRITICAL(&s_lock);
+    entry_t *entry = find_entry(fb);
+    if (entry && --entry->refs > 0)
+    {
+        last = false;
+    }
+    else if (entry)
+    {
+        entry->fb = NULL;
+        s_stats.held--;
+    }
+    if (last)
+        s_stats.returned++;
+    portEXIT_CRITICAL(&s_lock);
+
+    if (last)
+        esp_camera_fb_return(fb);
+}
+
+void who_frame_get_stats(who_frame_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "freertos/FreeRTOS.h"
+#include "esp_camera.h"
+
+#define WHO_FRAME_MAX_FRAMES 8   /*<! frames referenced at once, at least fb_count */
+#define WHO_FRAME_MAX_READERS 4  /*<! readers waiting for a frame at once */
+
+/**
+ * @brief Frame sharing counters.
+ */
+typedef struct
+{
+    uint32_t published;     /*<! frames handed out by the camera task */
+    uint32_t shared;        /*<! references handed to readers waiting for a frame */
+    uint32_t returned;      /*<! frames given back to the driver */
+    uint32_t timeouts;      /*<! readers that gave up waiting */
+    uint32_t untracked;     /*<! frames published while every entry was in use */
+    uint32_t held;          /*<! frames referenced right now */
+} who_frame_stats_t;
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+    /**
+     * @brief Set up the reader handoff. Frames are never copied: every holder
+     *        of a reference reads the driver's frame buffer, and the last
+     *        who_frame_release() gives it back to the driver.
+     *
+     * @return false when the reader queues cannot be allocated
+     */
+    bool who_frame_init(void);
+
+    /**
+     * @brief Start sharing a frame just taken from the driver. The caller
+     *        holds one reference, readers blocked in who_frame_wait() get one
+     *        each.
+     */
+    void who_frame_publish(camera_fb_t *fb);
+
+    /**
+     * @brief Wait for the next published frame, e.g. for the /capture handler
+     *        or an evidence snapshot. Nothing is pinned while nobody waits.
+     *
+     * @param timeout ticks to wait
+     * @return frame holding one reference for the caller, NULL on timeout
+     */
+    camera_fb_t *who_frame_wait(TickType_t timeout);
+
+    /**
+     * @brief Take another reference, e.g. before forwarding the frame to a
+     *        queue while still reading it.
+     */
+    void who_frame_retain(camera_fb_t *fb);
+
+    /**
+     * @brief Drop a reference. The last one returns the frame to the driver,
+     *        as does releasing a frame that was never published.
+     */
+    void who_frame_release(camera_fb_t *fb);
+
+    /**
+     * @brief Get a copy of the counters.
+     */
+    void who_frame_get_stats(who_frame_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
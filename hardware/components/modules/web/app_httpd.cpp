@@ -25,6 +25,7 @@
 #include "sdkconfig.h"
 
 #include "who_camera.h"
+#include "who_frame.h"
 
 // Forward declarations for GPS functions
 extern "C" {
@@ -102,11 +103,103 @@ httpd_handle_t camera_httpd = NULL;
 
 
 
+#define CAPTURE_CHUNK_SIZE 4096       // bytes of JPEG per HTTP chunk while encoding
+#define CAPTURE_MIN_FREE_HEAP 40000    // headroom left for the TCP stack and the other tasks
+
+typedef struct
+{
+    httpd_req_t *req;
+    uint8_t *buf;           /*<! CAPTURE_CHUNK_SIZE bytes */
+    size_t len;             /*<! bytes waiting in buf */
+    size_t sent;            /*<! bytes handed to the server */
+    int64_t first_us;       /*<! when the first chunk went out */
+    esp_err_t err;
+} jpg_chunking_t;
+
+static void jpg_flush_chunk(jpg_chunking_t *j)
+{
+    if (j->len && j->err == ESP_OK)
+    {
+        j->err = httpd_resp_send_chunk(j->req, (const char *)j->buf, j->len);
+        if (j->err == ESP_OK && !j->sent)
+            j->first_us = esp_timer_get_time();
+        if (j->err == ESP_OK)
+            j->sent += j->len;
+    }
+    j->len = 0;
+}
+
+// jpge hands its output over in 512 byte pieces, they go out in chunks.
+static size_t jpg_encode_stream(void *arg, size_t index, const void *data, size_t len)
+{
+    jpg_chunking_t *j = (jpg_chunking_t *)arg;
+    const uint8_t *src = (const uint8_t *)data;
+    size_t left = len;
+    while (left && j->err == ESP_OK)
+    {
+        size_t n = CAPTURE_CHUNK_SIZE - j->len;
+        if (n > left)
+            n = left;
+        memcpy(j->buf + j->len, src, n);
+        j->len += n;
+        src += n;
+        left -= n;
+        if (j->len == CAPTURE_CHUNK_SIZE)
+            jpg_flush_chunk(j);
+    }
+    // A failed send cannot stop the encoder, the rest is dropped.
+    return len;
+}
+
+// Heap frame2jpg_cb() takes for a frame. RGB565 and YUV422 are encoded
+// straight from the frame buffer, one MCU of six 8x8 blocks at a time; the
+// other formats go through a scan line into the encoder's lines of MCUs.
+static size_t jpeg_encode_heap(const camera_fb_t *frame)
+{
+    switch (frame->format) {
+    case PIXFORMAT_RGB565:
+    case PIXFORMAT_YUV422:
+        return 6 * 64 * sizeof(int32_t);
+    case PIXFORMAT_GRAYSCALE:
+        return (size_t)((frame->width + 7) & ~7) * 8 + frame->width;
+    default:
+        return (size_t)((frame->width + 15) & ~15) * 3 * 16 + (size_t)frame->width * 3;
+    }
+}
+
+// Encodes the frame while sending it: besides one chunk only the encoder's
+// working buffer, see jpeg_encode_heap(), is allocated, never the whole
+// JPEG. Once the first chunk is out the response can no longer turn into a
+// 500, *started says so.
+static esp_err_t send_jpeg_chunked(httpd_req_t *req, camera_fb_t *frame, bool *started)
+{
+    int64_t start_us = esp_timer_get_time();
+    jpg_chunking_t j = {req, NULL, 0, 0, 0, ESP_OK};
+    j.buf = (uint8_t *)malloc(CAPTURE_CHUNK_SIZE);
+    if (!j.buf)
+        return ESP_ERR_NO_MEM;
+
+    bool encoded = frame2jpg_cb(frame, 80, jpg_encode_stream, &j);
+    if (encoded)
+        jpg_flush_chunk(&j);
+    free(j.buf);
+    *started = j.sent > 0;
+    if (!encoded || j.err != ESP_OK)
+        return ESP_FAIL;
+
+    esp_err_t res = httpd_resp_send_chunk(req, NULL, 0);
+    ESP_LOGI(TAG, "📸 Capture streamed: %u bytes, first byte after %lld ms, done in %lld ms",
+             (unsigned)j.sent, (long long)(j.first_us - start_us) / 1000,
+             (long long)(esp_timer_get_time() - start_us) / 1000);
+    return res;
+}
+
 static esp_err_t capture_handler(httpd_req_t *req)
 {
     log_memory_usage("capture_handler START");
     camera_fb_t *frame = NULL;
     esp_err_t res = ESP_OK;
+    bool started = false;
     
 #ifdef CONFIG_LED_ILLUMINATOR_ENABLED
     // Turn on LED flash for capture
@@ -115,7 +208,7 @@ static esp_err_t capture_handler(httpd_req_t *req)
     
     // Check available memory before processing
     uint32_t free_heap = esp_get_free_heap_size();
-    if (free_heap < 100000) {  // Less than 100KB free
+    if (free_heap < CAPTURE_MIN_FREE_HEAP) {
         ESP_LOGW(TAG, "⚠️ Low memory for capture: %d bytes", free_heap);
 #ifdef CONFIG_LED_ILLUMINATOR_ENABLED
         enable_led(false);
@@ -124,8 +217,13 @@ static esp_err_t capture_handler(httpd_req_t *req)
         return ESP_FAIL;
     }
 
-    // Use shorter timeout to prevent hanging
-    if (xQueueReceive(xQueueFrameI, &frame, pdMS_TO_TICKS(5000)))  // 5 second timeout
+    // Use shorter timeout to prevent hanging. Without a frame queue the
+    // next camera frame is shared with the detector, not taken from it.
+    if (xQueueFrameI)
+        xQueueReceive(xQueueFrameI, &frame, pdMS_TO_TICKS(5000));  // 5 second timeout
+    else
+        frame = who_frame_wait(pdMS_TO_TICKS(5000));
+    if (frame)
     {
         if (frame && frame->buf && frame->len > 0)
         {
@@ -148,50 +246,44 @@ static esp_err_t capture_handler(httpd_req_t *req)
             }
             else
             {
-                // Convert to JPEG - more memory intensive
+                // Convert to JPEG while sending it
                 log_memory_usage("capture_handler BEFORE_CONVERSION");
                 
-                // Check memory again before conversion
+                // The encoder's working buffer and one chunk.
+                size_t needed = jpeg_encode_heap(frame) + CAPTURE_CHUNK_SIZE;
                 free_heap = esp_get_free_heap_size();
-                if (free_heap < 150000) {  // Need more memory for conversion
-                    ESP_LOGW(TAG, "⚠️ Insufficient memory for JPEG conversion: %d bytes", free_heap);
+                if (free_heap < needed + CAPTURE_MIN_FREE_HEAP) {
+                    ESP_LOGW(TAG, "⚠️ Insufficient memory for JPEG conversion: %d bytes, need %u",
+                             free_heap, (unsigned)needed);
                     res = ESP_FAIL;
                 } else {
-                    // Convert to JPEG using simpler method (no streaming)
-                    uint8_t *jpg_buf = NULL;
-                    size_t jpg_len = 0;
-                    if (frame2jpg(frame, 80, &jpg_buf, &jpg_len)) {
-                        res = httpd_resp_send(req, (const char *)jpg_buf, jpg_len);
-                        free(jpg_buf);  // Free the allocated JPEG buffer
-                    } else {
-                        res = ESP_FAIL;
-                    }
+                    res = send_jpeg_chunked(req, frame, &started);
                 }
                 
                 log_memory_usage("capture_handler AFTER_CONVERSION");
             }
-
-            // Always return frame to prevent memory leak
-            if (xQueueFrameO)
-            {
-                xQueueSend(xQueueFrameO, &frame, pdMS_TO_TICKS(1000));  // 1 second timeout
-            }
-            else if (gReturnFB)
-            {
-                esp_camera_fb_return(frame);
-            }
-            else
-            {
-                free(frame);
-            }
-            
-            log_memory_usage("capture_handler FRAME_RETURNED");
         }
         else
         {
             ESP_LOGE(TAG, "❌ Invalid frame received (null or empty)");
             res = ESP_FAIL;
         }
+
+        // Always return frame to prevent memory leak, empty ones too
+        if (xQueueFrameO)
+        {
+            xQueueSend(xQueueFrameO, &frame, pdMS_TO_TICKS(1000));  // 1 second timeout
+        }
+        else if (gReturnFB)
+        {
+            who_frame_release(frame);
+        }
+        else
+        {
+            free(frame);
+        }
+
+        log_memory_usage("capture_handler FRAME_RETURNED");
     }
     else
     {
@@ -203,7 +295,9 @@ static esp_err_t capture_handler(httpd_req_t *req)
     if (res != ESP_OK)
     {
         ESP_LOGE(TAG, "❌ Capture handler failed");
-        httpd_resp_send_500(req);
+        // Part of the image is out, closing the connection is all that is left.
+        if (!started)
+            httpd_resp_send_500(req);
     }
     
 #ifdef CONFIG_LED_ILLUMINATOR_ENABLED
@@ -262,6 +356,12 @@ static esp_err_t cmd_handler(httpd_req_t *req)
     int val = atoi(value);
     ESP_LOGI(TAG, "%s = %d", variable, val);
     sensor_t *s = esp_camera_sensor_get();
+    if (!s)
+    {
+        // Frames come from a recorded source, there is no sensor to set.
+        httpd_resp_send_404(req);
+        return ESP_FAIL;
+    }
     int res = 0;
 
     if (!strcmp(variable, "framesize"))
@@ -375,6 +475,11 @@ static esp_err_t status_handler(httpd_req_t *req)
     static char json_response[1024];
 
     sensor_t *s = esp_camera_sensor_get();
+    if (!s)
+    {
+        httpd_resp_send_404(req);
+        return ESP_FAIL;
+    }
     char *p = json_response;
     *p++ = '{';
 
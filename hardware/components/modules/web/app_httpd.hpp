@@ -5,4 +5,12 @@
 #include "freertos/task.h"
 #include "freertos/semphr.h"
 
+/**
+ * @brief Start the HTTP server.
+ *
+ * @param frame_i   frames for /capture, NULL shares the next camera frame
+ *                  with the detector through who_frame_wait()
+ * @param frame_o   where captured frames go next, NULL releases them
+ * @param return_fb release frames to the camera driver instead of free()
+ */
 void register_httpd(const QueueHandle_t frame_i, const QueueHandle_t frame_o, const bool return_fb);
@@ -1,6 +1,7 @@
 #include "csv_uploader.h"
 #include "csv_logger.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "esp_http_client.h"
 #include "esp_crt_bundle.h"
 #include "esp_wifi.h"
@@ -18,6 +19,10 @@ static csv_uploader_config_t s_config;
 static TaskHandle_t s_upload_task = NULL;
 static SemaphoreHandle_t s_trigger_sem = NULL;
 static bool s_running = false;
+// 64-bit, so written and read only under s_trigger_lock.
+static portMUX_TYPE s_trigger_lock = portMUX_INITIALIZER_UNLOCKED;
+static int64_t s_trigger_time = 0;
+static csv_uploader_lag_cb_t s_lag_cb = NULL;
 
 // Enhanced error handling and offline buffering
 static csv_uploader_status_t s_status = {0};
@@ -342,10 +347,22 @@ static void upload_task(void* pvParameters)
     
     while (s_running) {
         // Wait for trigger or timeout
+        int64_t wait_start = esp_timer_get_time();
+        int64_t lag;
         if (xSemaphoreTake(s_trigger_sem, pdMS_TO_TICKS(s_config.upload_interval_seconds * 1000)) == pdTRUE) {
             ESP_LOGI(TAG, "Upload triggered manually");
+            // A trigger given while uploading was pending before the wait
+            portENTER_CRITICAL(&s_trigger_lock);
+            int64_t trigger_time = s_trigger_time;
+            portEXIT_CRITICAL(&s_trigger_lock);
+            int64_t ready = trigger_time > wait_start ? trigger_time : wait_start;
+            lag = esp_timer_get_time() - ready;
         } else {
             ESP_LOGD(TAG, "Upload interval timeout - checking for pending logs");
+            lag = esp_timer_get_time() - wait_start - s_config.upload_interval_seconds * 1000000LL;
+        }
+        if (s_lag_cb) {
+            s_lag_cb(lag);
         }
         
         if (!s_running) break;
@@ -502,9 +519,18 @@ esp_err_t csv_uploader_trigger_now(void)
         return ESP_ERR_INVALID_STATE;
     }
     
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&s_trigger_lock);
+    s_trigger_time = now;
+    portEXIT_CRITICAL(&s_trigger_lock);
     xSemaphoreGive(s_trigger_sem);
     ESP_LOGI(TAG, "Manual upload triggered");
     return ESP_OK;
 }
 
+void csv_uploader_set_lag_callback(csv_uploader_lag_cb_t cb)
+{
+    s_lag_cb = cb;
+}
+
 // Removed unused: csv_uploader_stop, csv_uploader_get_status, csv_uploader_reset_status
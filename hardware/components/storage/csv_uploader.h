@@ -35,6 +35,18 @@ esp_err_t csv_uploader_start(void);
  */
 esp_err_t csv_uploader_trigger_now(void);
 
+/**
+ * Called by the upload task on every wake-up with how late it ran: time since
+ * the trigger, or past the upload interval. Large lags mean the task is
+ * starved of CPU.
+ */
+typedef void (*csv_uploader_lag_cb_t)(int64_t lag_us);
+
+/**
+ * Set the wake-up lag callback, NULL to remove it
+ */
+void csv_uploader_set_lag_callback(csv_uploader_lag_cb_t cb);
+
 // Removed unused: csv_uploader_stop, csv_uploader_get_status, csv_uploader_reset_status
 // Status struct kept for internal use only
 typedef struct {
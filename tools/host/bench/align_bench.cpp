@@ -0,0 +1,236 @@
+// Fixed-point face alignment (who_face_align) against a float reference
+// that follows face_recognition_tool::align_face(): similarity transform
+// through heap matrices and a generic inverse, float bilinear warp.
+//
+//   who_align_bench [--faces N] [--seed S] <frame.jpg|dir>...
+//
+// The keypoints are the MFN template under random scale, rotation, shift
+// and a few pixels of jitter, the frames are real camera pictures.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "replay.hpp"
+#include "who_face_align.hpp"
+#include "dl_image.hpp"
+
+static const float TEMPLATE[10] = {
+    38.2946f, 51.6963f, 41.5493f, 92.3655f, 56.0252f,
+    71.7366f, 73.5318f, 51.5014f, 70.7299f, 92.2041f,
+};
+
+typedef std::vector<std::vector<float>> matrix_t;
+
+static matrix_t matrix(int rows, int cols)
+{
+    return matrix_t(rows, std::vector<float>(cols, 0.0f));
+}
+
+// Gauss-Jordan with partial pivoting, the way a generic Matrix::inverse() works.
+static matrix_t inverse(const matrix_t &m)
+{
+    int n = m.size();
+    matrix_t a = m;
+    matrix_t inv = matrix(n, n);
+    for (int i = 0; i < n; i++)
+        inv[i][i] = 1.0f;
+    for (int c = 0; c < n; c++)
+    {
+        int pivot = c;
+        for (int r = c + 1; r < n; r++)
+            if (fabsf(a[r][c]) > fabsf(a[pivot][c]))
+                pivot = r;
+        std::swap(a[c], a[pivot]);
+        std::swap(inv[c], inv[pivot]);
+        float d = a[c][c];
+        for (int k = 0; k < n; k++)
+        {
+            a[c][k] /= d;
+            inv[c][k] /= d;
+        }
+        for (int r = 0; r < n; r++)
+        {
+            if (r == c)
+                continue;
+            float f = a[r][c];
+            for (int k = 0; k < n; k++)
+            {
+                a[r][k] -= f * a[c][k];
+                inv[r][k] -= f * inv[c][k];
+            }
+        }
+    }
+    return inv;
+}
+
+// Keypoints -> template similarity by normal equations, then inverted.
+static matrix_t reference_transform(const std::vector<int> &kp)
+{
+    matrix_t ata = matrix(4, 4);
+    std::vector<float> atb(4, 0.0f);
+    for (int i = 0; i < 10; i += 2)
+    {
+        float rows[2][4] = {{(float)kp[i], -(float)kp[i + 1], 1, 0},
+                            {(float)kp[i + 1], (float)kp[i], 0, 1}};
+        float rhs[2] = {TEMPLATE[i], TEMPLATE[i + 1]};
+        for (int r = 0; r < 2; r++)
+            for (int j = 0; j < 4; j++)
+            {
+                atb[j] += rows[r][j] * rhs[r];
+                for (int k = 0; k < 4; k++)
+                    ata[j][k] += rows[r][j] * rows[r][k];
+            }
+    }
+    matrix_t ata_inv = inverse(ata);
+    float x[4] = {0};
+    for (int j = 0; j < 4; j++)
+        for (int k = 0; k < 4; k++)
+            x[j] += ata_inv[j][k] * atb[k];
+
+    matrix_t m = matrix(3, 3);
+    m[0] = {x[0], -x[1], x[2]};
+    m[1] = {x[1], x[0], x[3]};
+    m[2] = {0, 0, 1};
+    return inverse(m);
+}
+
+static void reference_warp(const uint16_t *frame, int height, int width, const matrix_t &m, uint8_t *out)
+{
+    for (int i = 0; i < WHO_ALIGN_SIZE; i++)
+    {
+        for (int j = 0; j < WHO_ALIGN_SIZE; j++, out += 3)
+        {
+            float x = m[0][0] * j + m[0][1] * i + m[0][2];
+            float y = m[1][0] * j + m[1][1] * i + m[1][2];
+            if (x < 0 || y < 0 || x >= width - 1 || y >= height - 1)
+            {
+                out[0] = out[1] = out[2] = 0;
+                continue;
+            }
+            int x0 = (int)x, y0 = (int)y;
+            float fx = x - x0, fy = y - y0;
+            const uint16_t *src = frame + y0 * width + x0;
+            uint8_t c00[3], c01[3], c10[3], c11[3];
+            dl::image::convert_pixel_rgb565_to_rgb888(src[0], c00);
+            dl::image::convert_pixel_rgb565_to_rgb888(src[1], c01);
+            dl::image::convert_pixel_rgb565_to_rgb888(src[width], c10);
+            dl::image::convert_pixel_rgb565_to_rgb888(src[width + 1], c11);
+            for (int c = 0; c < 3; c++)
+            {
+                float v = (c00[c] * (1 - fx) + c01[c] * fx) * (1 - fy) + (c10[c] * (1 - fx) + c11[c] * fx) * fy;
+                out[c] = (uint8_t)lrintf(v);
+            }
+        }
+    }
+}
+
+static std::vector<int> random_keypoints(std::mt19937 &rng, int height, int width)
+{
+    std::uniform_real_distribution<float> scale_d(0.4f, 1.2f);
+    std::uniform_real_distribution<float> angle_d(-0.45f, 0.45f);
+    std::uniform_real_distribution<float> jitter_d(-2.0f, 2.0f);
+    float s = scale_d(rng), a = angle_d(rng);
+    float side = WHO_ALIGN_SIZE * s;
+    std::uniform_real_distribution<float> cx_d(side / 2, width - side / 2);
+    std::uniform_real_distribution<float> cy_d(side / 2, height - side / 2);
+    float cx = cx_d(rng), cy = cy_d(rng);
+
+    std::vector<int> kp(10);
+    for (int i = 0; i < 10; i += 2)
+    {
+        float u = (TEMPLATE[i] - WHO_ALIGN_SIZE / 2) * s;
+        float v = (TEMPLATE[i + 1] - WHO_ALIGN_SIZE / 2) * s;
+        kp[i] = (int)lrintf(cx + u * cosf(a) - v * sinf(a) + jitter_d(rng));
+        kp[i + 1] = (int)lrintf(cy + u * sinf(a) + v * cosf(a) + jitter_d(rng));
+    }
+    return kp;
+}
+
+int main(int argc, char **argv)
+{
+    int faces = 200;
+    unsigned seed = 1;
+    std::vector<std::string> inputs;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--faces") && i + 1 < argc)
+            faces = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--seed") && i + 1 < argc)
+            seed = atoi(argv[++i]);
+        else
+            inputs.push_back(argv[i]);
+    }
+    std::vector<std::string> paths = replay_list_frames(inputs);
+    if (paths.empty())
+    {
+        fprintf(stderr, "usage: %s [--faces N] [--seed S] <frame.jpg|dir>...\n", argv[0]);
+        return 1;
+    }
+
+    std::mt19937 rng(seed);
+    std::vector<uint8_t> fixed(WHO_ALIGN_SIZE * WHO_ALIGN_SIZE * 3), reference(fixed.size()), yuv(fixed.size());
+    double fixed_us = 0, reference_us = 0, yuv_us = 0;
+    uint64_t sum_diff = 0, off_by_more = 0, channels = 0, yuv_sum_diff = 0;
+    int max_diff = 0, aligned = 0;
+    for (const std::string &path : paths)
+    {
+        replay_frame_t frame;
+        if (!replay_load_frame(path, 0, 0, &frame))
+        {
+            fprintf(stderr, "skipping %s\n", path.c_str());
+            continue;
+        }
+        const uint16_t *pixels = (const uint16_t *)frame.rgb565.data();
+        camera_fb_t *yuv_frame = replay_make_frame(frame, PIXFORMAT_YUV422, 0);
+        if (!yuv_frame)
+            return 1;
+        for (int n = 0; n < faces; n++)
+        {
+            std::vector<int> kp = random_keypoints(rng, frame.height, frame.width);
+
+            auto t0 = std::chrono::steady_clock::now();
+            who_align_transform_t transform;
+            who_align_get_transform(kp.data(), &transform);
+            who_align_warp(pixels, frame.height, frame.width, &transform, fixed.data());
+            auto t1 = std::chrono::steady_clock::now();
+            reference_warp(pixels, frame.height, frame.width, reference_transform(kp), reference.data());
+            auto t2 = std::chrono::steady_clock::now();
+            who_align_warp_format(yuv_frame->buf, PIXFORMAT_YUV422, frame.height, frame.width, &transform, yuv.data());
+            auto t3 = std::chrono::steady_clock::now();
+            yuv_us += std::chrono::duration<double, std::micro>(t3 - t2).count();
+
+            fixed_us += std::chrono::duration<double, std::micro>(t1 - t0).count();
+            reference_us += std::chrono::duration<double, std::micro>(t2 - t1).count();
+            for (size_t i = 0; i < fixed.size(); i++)
+            {
+                int diff = abs((int)fixed[i] - (int)reference[i]);
+                sum_diff += diff;
+                off_by_more += diff > 1;
+                max_diff = diff > max_diff ? diff : max_diff;
+                yuv_sum_diff += abs((int)yuv[i] - (int)fixed[i]);
+            }
+            channels += fixed.size();
+            aligned++;
+        }
+        free(yuv_frame);
+    }
+    if (!aligned)
+        return 1;
+
+    printf("faces: %d over %zu frames\n", aligned, paths.size());
+    printf("float reference: %8.1f us/face\n", reference_us / aligned);
+    printf("fixed point:     %8.1f us/face (%.2fx)\n", fixed_us / aligned, reference_us / fixed_us);
+    printf("difference: mean %.4f, max %d, %.4f%% of channels off by more than 1\n",
+           (double)sum_diff / channels, max_diff, 100.0 * off_by_more / channels);
+    // Chroma is shared by pixel pairs in YUV422, so this is not all rounding.
+    printf("from YUV422:     %8.1f us/face, mean difference to RGB565 %.2f\n",
+           yuv_us / aligned, (double)yuv_sum_diff / channels);
+    return 0;
+}
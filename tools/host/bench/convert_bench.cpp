@@ -0,0 +1,255 @@
+// Line converters of conversions/line_convert.c against the per-pixel code
+// they replaced in to_jpg, to_bmp and who_luma.
+//
+//   who_convert_bench [--repeat N] <frame.jpg|dir>...
+//
+// Every frame is converted line by line, the way the encoders consume it,
+// from its RGB565 pixels, the YUV422 the sensor would send for them and
+// the RGB888 a JPEG decoder produces. Outputs are compared byte for byte.
+// Both sides are built without auto-vectorization: the board has no SIMD,
+// host timings only rank the scalar code.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "replay.hpp"
+#include "img_line_convert.h"
+#include "yuv.h"
+#include "dl_image.hpp"
+
+typedef void (*line_fn_t)(const uint8_t *src, uint8_t *dst, size_t n);
+
+typedef struct
+{
+    const char *name;
+    int src_bpp;        /*<! source bytes per pixel, selects the input plane */
+    int dst_bpp;
+    line_fn_t before;
+    line_fn_t after;
+} bench_case_t;
+
+// convert_line_format() of to_jpg.cpp, RGB565 branch.
+static void old_rgb565_to_rgb888(const uint8_t *src, uint8_t *dst, size_t n)
+{
+    int o = 0;
+    for (size_t i = 0; i < n * 2; i += 2)
+    {
+        dst[o++] = src[i] & 0xF8;
+        dst[o++] = (src[i] & 0x07) << 5 | (src[i + 1] & 0xE0) >> 3;
+        dst[o++] = (src[i + 1] & 0x1F) << 3;
+    }
+}
+
+// fmt2rgb888() / fmt2bmp() of to_bmp.c.
+static void old_rgb565_to_bgr888(const uint8_t *src, uint8_t *dst, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        uint8_t hb = *src++;
+        uint8_t lb = *src++;
+        *dst++ = (lb & 0x1F) << 3;
+        *dst++ = (hb & 0x07) << 5 | (lb & 0xE0) >> 3;
+        *dst++ = hb & 0xF8;
+    }
+}
+
+static void old_yuv422_to_rgb888(const uint8_t *src, uint8_t *dst, size_t n)
+{
+    uint8_t r, g, b;
+    for (size_t i = 0; i < n * 2; i += 4)
+    {
+        yuv2rgb(src[i], src[i + 1], src[i + 3], &r, &g, &b);
+        *dst++ = r;
+        *dst++ = g;
+        *dst++ = b;
+        yuv2rgb(src[i + 2], src[i + 1], src[i + 3], &r, &g, &b);
+        *dst++ = r;
+        *dst++ = g;
+        *dst++ = b;
+    }
+}
+
+static void old_yuv422_to_bgr888(const uint8_t *src, uint8_t *dst, size_t n)
+{
+    uint8_t r, g, b;
+    for (size_t i = 0; i < n * 2; i += 4)
+    {
+        yuv2rgb(src[i], src[i + 1], src[i + 3], &r, &g, &b);
+        *dst++ = b;
+        *dst++ = g;
+        *dst++ = r;
+        yuv2rgb(src[i + 2], src[i + 1], src[i + 3], &r, &g, &b);
+        *dst++ = b;
+        *dst++ = g;
+        *dst++ = r;
+    }
+}
+
+// yuv2rgb() and packing, what a YUV422 -> RGB565 path did per pixel.
+static void old_yuv422_to_rgb565(const uint8_t *src, uint8_t *dst, size_t n)
+{
+    uint8_t r, g, b;
+    for (size_t i = 0; i < n * 2; i += 2)
+    {
+        yuv2rgb(src[i], src[(i & ~3) + 1], src[(i & ~3) + 3], &r, &g, &b);
+        uint16_t c = ((r & 0xF8) << 8) | ((g & 0xFC) << 3) | (b >> 3);
+        *dst++ = c >> 8;
+        *dst++ = c & 0xff;
+    }
+}
+
+// _rgb565_write() of to_bmp.c, in camera byte order (it wrote the low
+// byte first before).
+static void old_rgb888_to_rgb565(const uint8_t *src, uint8_t *dst, size_t n)
+{
+    for (size_t i = 0; i < n; i++, src += 3)
+    {
+        uint16_t c = ((src[0] & 0xF8) << 8) | ((src[1] & 0xFC) << 3) | (src[2] >> 3);
+        *dst++ = c >> 8;
+        *dst++ = c & 0xff;
+    }
+}
+
+// luma_rgb565() of who_luma.cpp.
+static void old_rgb565_to_gray(const uint8_t *src, uint8_t *dst, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+        dst[i] = dl::image::convert_pixel_rgb565_to_gray(((const uint16_t *)src)[i]);
+}
+
+// luma_yuv422() of who_luma.cpp.
+static void old_yuv422_to_y(const uint8_t *src, uint8_t *dst, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+        dst[i] = src[i * 2];
+}
+
+static const bench_case_t CASES[] = {
+    {"rgb565->rgb888", 2, 3, old_rgb565_to_rgb888, line_rgb565_to_rgb888},
+    {"rgb565->bgr888", 2, 3, old_rgb565_to_bgr888, line_rgb565_to_bgr888},
+    {"rgb565->gray", 2, 1, old_rgb565_to_gray, line_rgb565_to_gray},
+    {"rgb888->rgb565", 3, 2, old_rgb888_to_rgb565, line_rgb888_to_rgb565},
+    {"yuv422->rgb888", -2, 3, old_yuv422_to_rgb888, line_yuv422_to_rgb888},
+    {"yuv422->bgr888", -2, 3, old_yuv422_to_bgr888, line_yuv422_to_bgr888},
+    {"yuv422->rgb565", -2, 2, old_yuv422_to_rgb565, line_yuv422_to_rgb565},
+    {"yuv422->y", -2, 1, old_yuv422_to_y, line_yuv422_to_y},
+};
+
+typedef struct
+{
+    int width;
+    int height;
+    std::vector<uint8_t> rgb565;
+    std::vector<uint8_t> yuv422;
+    std::vector<uint8_t> rgb888;
+} planes_t;
+
+static const std::vector<uint8_t> &plane(const planes_t &p, int src_bpp)
+{
+    return src_bpp == 3 ? p.rgb888 : (src_bpp == 2 ? p.rgb565 : p.yuv422);
+}
+
+// One pass over every frame, in ns.
+static double run(line_fn_t fn, const std::vector<planes_t> &frames, int src_bpp, int dst_bpp,
+                  std::vector<std::vector<uint8_t>> *out, size_t *pixels)
+{
+    out->resize(frames.size());
+    *pixels = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t f = 0; f < frames.size(); f++)
+    {
+        const planes_t &p = frames[f];
+        // YUV422 pairs pixels, sensors only send even widths.
+        if (src_bpp < 0 && (p.width & 1))
+            continue;
+        *pixels += (size_t)p.width * p.height;
+        const uint8_t *src = plane(p, src_bpp).data();
+        size_t src_stride = (size_t)p.width * (src_bpp < 0 ? -src_bpp : src_bpp);
+        size_t dst_stride = (size_t)p.width * dst_bpp;
+        (*out)[f].resize(dst_stride * p.height);
+        uint8_t *dst = (*out)[f].data();
+        for (int y = 0; y < p.height; y++)
+            fn(src + y * src_stride, dst + y * dst_stride, p.width);
+    }
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char **argv)
+{
+    int repeat = 20;
+    std::vector<std::string> paths;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--repeat") && i + 1 < argc)
+            repeat = atoi(argv[++i]);
+        else
+            paths.push_back(argv[i]);
+    }
+    if (paths.empty() || repeat < 1)
+    {
+        fprintf(stderr, "usage: %s [--repeat N] <frame.jpg|dir>...\n", argv[0]);
+        return 2;
+    }
+
+    std::vector<planes_t> frames;
+    size_t pixels = 0;
+    for (const std::string &path : replay_list_frames(paths))
+    {
+        replay_frame_t frame;
+        if (!replay_load_frame(path, 320, 240, &frame))
+            continue;
+        camera_fb_t *fb = replay_make_frame(frame, PIXFORMAT_YUV422, 0);
+        if (!fb)
+        {
+            fprintf(stderr, "out of memory\n");
+            return 1;
+        }
+        planes_t p;
+        p.width = frame.width;
+        p.height = frame.height;
+        p.rgb565 = frame.rgb565;
+        p.yuv422.assign(fb->buf, fb->buf + fb->len);
+        p.rgb888.resize((size_t)p.width * p.height * 3);
+        line_rgb565_to_rgb888(p.rgb565.data(), p.rgb888.data(), (size_t)p.width * p.height);
+        free(fb);
+        pixels += (size_t)p.width * p.height;
+        frames.push_back(std::move(p));
+    }
+    if (frames.empty())
+    {
+        fprintf(stderr, "no frames\n");
+        return 1;
+    }
+
+    printf("%u frames, %u pixels, best of %d passes\n\n", (unsigned)frames.size(), (unsigned)pixels, repeat);
+    printf("%-16s %10s %10s %8s %12s\n", "conversion", "old ns/px", "new ns/px", "speedup", "diff bytes");
+    bool exact = true;
+    for (const bench_case_t &c : CASES)
+    {
+        // Best of the interleaved passes, the least disturbed by the host.
+        std::vector<std::vector<uint8_t>> before, after;
+        size_t n = 0;
+        double before_ns = 0, after_ns = 0;
+        for (int r = 0; r < repeat; r++)
+        {
+            double b = run(c.before, frames, c.src_bpp, c.dst_bpp, &before, &n);
+            double a = run(c.after, frames, c.src_bpp, c.dst_bpp, &after, &n);
+            before_ns = r ? std::min(before_ns, b) : b;
+            after_ns = r ? std::min(after_ns, a) : a;
+        }
+        size_t diff = 0;
+        for (size_t f = 0; f < frames.size(); f++)
+            for (size_t i = 0; i < before[f].size(); i++)
+                diff += before[f][i] != after[f][i];
+        exact &= diff == 0;
+        printf("%-16s %10.2f %10.2f %7.2fx %12u\n", c.name, before_ns / n, after_ns / n,
+               after_ns > 0 ? before_ns / after_ns : 0.0, (unsigned)diff);
+    }
+    return exact ? 0 : 1;
+}
@@ -0,0 +1,202 @@
+// Detection on the half resolution luminance image (who_luma) against the
+// RGB565 path on the same frames, with the models the firmware runs.
+//
+//   who_detect_compare [--min-face N] [--max-face N] [--format yuv422|gray] <frame.jpg|dir>...
+//
+// Each frame is detected twice: MSR01 + MNP01 on the RGB565 frame with the
+// resize scale who_detect_init() picks for min-face, and on the luminance of
+// the frame converted to the capture format, at half the face size. Faces
+// of the luminance path are scaled back to frame coordinates and matched to
+// the RGB565 faces by IoU.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <list>
+#include <string>
+#include <vector>
+
+#include "replay.hpp"
+#include "who_luma.hpp"
+#include "human_face_detect_msr01.hpp"
+#include "human_face_detect_mnp01.hpp"
+
+#define MSR01_MIN_FACE 16   // see who_face_detect.cpp
+#define MATCH_IOU 0.5f
+
+typedef struct
+{
+    int box[4];
+    int keypoint[10];
+} face_t;
+
+typedef struct
+{
+    uint32_t reference;     /*<! faces of the RGB565 path */
+    uint32_t luma;          /*<! faces of the luminance path */
+    uint32_t matched;
+    double iou;             /*<! sum over matched faces */
+    double keypoint_px;     /*<! sum of mean keypoint distances over matched faces */
+    double reference_us;
+    double luma_us;         /*<! including the luminance image */
+} compare_t;
+
+static float resize_scale(int min_face)
+{
+    return std::min(1.0f, std::max(0.1f, (float)MSR01_MIN_FACE / min_face));
+}
+
+static double now_us(void)
+{
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static std::vector<face_t> detect(HumanFaceDetectMSR01 &msr01, HumanFaceDetectMNP01 &mnp01,
+                                  uint16_t *image, int height, int width, int shift)
+{
+    std::vector<face_t> faces;
+    std::list<dl::detect::result_t> &candidates = msr01.infer(image, {height, width, 3});
+    if (candidates.empty())
+        return faces;
+    for (const dl::detect::result_t &res : mnp01.infer(image, {height, width, 3}, candidates))
+    {
+        face_t face = {};
+        for (size_t i = 0; i < 4 && i < res.box.size(); i++)
+            face.box[i] = res.box[i] << shift;
+        for (size_t i = 0; i < 10 && i < res.keypoint.size(); i++)
+            face.keypoint[i] = res.keypoint[i] << shift;
+        faces.push_back(face);
+    }
+    return faces;
+}
+
+static float iou(const face_t &a, const face_t &b)
+{
+    int ix = std::min(a.box[2], b.box[2]) - std::max(a.box[0], b.box[0]);
+    int iy = std::min(a.box[3], b.box[3]) - std::max(a.box[1], b.box[1]);
+    if (ix <= 0 || iy <= 0)
+        return 0.0f;
+    float inter = (float)ix * iy;
+    float uni = (float)(a.box[2] - a.box[0]) * (a.box[3] - a.box[1]) +
+                (float)(b.box[2] - b.box[0]) * (b.box[3] - b.box[1]) - inter;
+    return uni > 0 ? inter / uni : 0.0f;
+}
+
+static void match(const std::vector<face_t> &reference, const std::vector<face_t> &luma, compare_t *c)
+{
+    std::vector<bool> used(luma.size(), false);
+    for (const face_t &r : reference)
+    {
+        int best = -1;
+        float best_iou = MATCH_IOU;
+        for (size_t i = 0; i < luma.size(); i++)
+        {
+            float v = iou(r, luma[i]);
+            if (!used[i] && v >= best_iou)
+            {
+                best_iou = v;
+                best = i;
+            }
+        }
+        if (best < 0)
+            continue;
+        used[best] = true;
+        c->matched++;
+        c->iou += best_iou;
+        double distance = 0;
+        for (int k = 0; k < 10; k += 2)
+            distance += hypot(r.keypoint[k] - luma[best].keypoint[k], r.keypoint[k + 1] - luma[best].keypoint[k + 1]);
+        c->keypoint_px += distance / 5;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int min_face = 40;
+    int max_face = 200;
+    pixformat_t format = PIXFORMAT_GRAYSCALE;
+    std::vector<std::string> paths;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--min-face") && i + 1 < argc)
+            min_face = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--max-face") && i + 1 < argc)
+            max_face = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--format") && i + 1 < argc)
+            format = !strcmp(argv[++i], "yuv422") ? PIXFORMAT_YUV422 : PIXFORMAT_GRAYSCALE;
+        else
+            paths.push_back(argv[i]);
+    }
+    if (paths.empty() || min_face <= 1)
+    {
+        fprintf(stderr, "usage: %s [--min-face N] [--max-face N] [--format yuv422|gray] <frame.jpg|dir>...\n", argv[0]);
+        return 2;
+    }
+
+    // Same thresholds as task_detect_handler.
+    HumanFaceDetectMSR01 msr01_rgb(0.20F, 0.3F, 10, resize_scale(min_face));
+    HumanFaceDetectMSR01 msr01_luma(0.20F, 0.3F, 10, resize_scale(min_face / 2));
+    HumanFaceDetectMNP01 mnp01(0.25F, 0.3F, 10);
+
+    compare_t c = {};
+    int frames = 0;
+    for (const std::string &path : replay_list_frames(paths))
+    {
+        replay_frame_t frame;
+        if (!replay_load_frame(path, 320, 240, &frame))
+            continue;
+        camera_fb_t *fb = replay_make_frame(frame, format, 0);
+        if (!fb || !who_luma_init(frame.height, frame.width))
+        {
+            fprintf(stderr, "out of memory\n");
+            return 1;
+        }
+
+        double start = now_us();
+        std::vector<face_t> reference = detect(msr01_rgb, mnp01, (uint16_t *)frame.rgb565.data(), frame.height, frame.width, 0);
+        double middle = now_us();
+        uint16_t *image = (uint16_t *)who_luma_downscale(fb->buf, fb->format, frame.height, frame.width);
+        std::vector<face_t> luma = detect(msr01_luma, mnp01, image, frame.height / 2, frame.width / 2, 1);
+        double end = now_us();
+        free(fb);
+
+        // Faces outside the configured size range are dropped by both paths.
+        auto out_of_range = [&](const face_t &f) {
+            int side = std::max(f.box[2] - f.box[0], f.box[3] - f.box[1]);
+            return side < min_face || side > max_face;
+        };
+        reference.erase(std::remove_if(reference.begin(), reference.end(), out_of_range), reference.end());
+        luma.erase(std::remove_if(luma.begin(), luma.end(), out_of_range), luma.end());
+
+        compare_t frame_c = {};
+        match(reference, luma, &frame_c);
+        printf("%-50s rgb565 %2d  luma %2d  matched %2d\n", path.c_str(), (int)reference.size(), (int)luma.size(), (int)frame_c.matched);
+        c.reference += reference.size();
+        c.luma += luma.size();
+        c.matched += frame_c.matched;
+        c.iou += frame_c.iou;
+        c.keypoint_px += frame_c.keypoint_px;
+        c.reference_us += middle - start;
+        c.luma_us += end - middle;
+        frames++;
+    }
+    if (!frames)
+    {
+        fprintf(stderr, "no frames\n");
+        return 1;
+    }
+
+    printf("\nframes: %d, faces %d-%d px, luminance from %s\n", frames, min_face, max_face,
+           format == PIXFORMAT_YUV422 ? "YUV422" : "GRAYSCALE");
+    printf("rgb565: %u faces, %.0f us/frame\n", (unsigned)c.reference, c.reference_us / frames);
+    printf("luma:   %u faces, %.0f us/frame\n", (unsigned)c.luma, c.luma_us / frames);
+    printf("recall against rgb565: %.1f%%, extra faces: %u\n",
+           c.reference ? 100.0 * c.matched / c.reference : 100.0, (unsigned)(c.luma - c.matched));
+    if (c.matched)
+        printf("matched faces: mean IoU %.3f, mean keypoint distance %.2f px\n", c.iou / c.matched, c.keypoint_px / c.matched);
+    return 0;
+}
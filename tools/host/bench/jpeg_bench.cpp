@@ -0,0 +1,289 @@
+// JPEG encoding of camera frames: fmt2jpg_cb(), which feeds RGB565 and
+// YUV422 straight into the encoder's MCUs, against the RGB888 scan lines
+// convert_image() used to push through jpeg_encoder::process_scanline().
+//
+//   who_jpeg_bench [--repeat N] <frame.jpg|dir>...
+//
+// RGB565 output has to be byte for byte the same. YUV422 now skips the
+// round trip through RGB, so both outputs are decoded and scored by PSNR
+// against the frame the YUV422 was made from; the new one must not lose
+// more than 0.1 dB. Throughput is in MB of camera frame per second.
+//
+// The YUV422 frames are BT.601 video range, which is what yuv2rgb() and
+// the frame path take sensor YUV for. yuv2rgb() also swaps the U and V
+// terms of green, which the old path inherits.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "replay.hpp"
+#include "img_converters.h"
+#include "img_line_convert.h"
+#include "jpge.h"
+
+extern "C" {
+#include "tjpgd.h"
+}
+
+typedef void (*line_fn_t)(const uint8_t *src, uint8_t *dst, size_t n);
+
+typedef struct
+{
+    const char *name;
+    pixformat_t format;
+    line_fn_t to_rgb888;    /*<! what convert_line_format() did with a line */
+} bench_format_t;
+
+static const bench_format_t FORMATS[] = {
+    {"rgb565", PIXFORMAT_RGB565, line_rgb565_to_rgb888},
+    {"yuv422", PIXFORMAT_YUV422, line_yuv422_to_rgb888},
+};
+
+static const int QUALITIES[] = {20, 50, 80, 95};
+
+typedef struct
+{
+    int width;
+    int height;
+    std::vector<uint8_t> pixels[2];     /*<! RGB565 and YUV422, as FORMATS */
+} bench_frame_t;
+
+// Y0 U Y1 V, chroma averaged over the pair.
+static void rgb565_to_yuv422(const std::vector<uint8_t> &rgb565, std::vector<uint8_t> *yuv422)
+{
+    size_t pixels = rgb565.size() / 2;
+    std::vector<uint8_t> rgb(pixels * 3);
+    line_rgb565_to_rgb888(rgb565.data(), rgb.data(), pixels);
+    yuv422->resize(pixels * 2);
+    for (size_t i = 0; i + 1 < pixels; i += 2)
+    {
+        const uint8_t *p = &rgb[i * 3];
+        int r = (p[0] + p[3] + 1) >> 1, g = (p[1] + p[4] + 1) >> 1, b = (p[2] + p[5] + 1) >> 1;
+        uint8_t *o = &(*yuv422)[i * 2];
+        o[0] = 16 + ((66 * p[0] + 129 * p[1] + 25 * p[2] + 128) >> 8);
+        o[1] = 128 + ((-38 * r - 74 * g + 112 * b + 128) >> 8);
+        o[2] = 16 + ((66 * p[3] + 129 * p[4] + 25 * p[5] + 128) >> 8);
+        o[3] = 128 + ((112 * r - 94 * g - 18 * b + 128) >> 8);
+    }
+}
+
+class vector_stream : public jpge::output_stream
+{
+public:
+    std::vector<uint8_t> *out;
+
+    explicit vector_stream(std::vector<uint8_t> *o) : out(o) {}
+    virtual bool put_buf(const void *data, int len)
+    {
+        if (data)
+            out->insert(out->end(), (const uint8_t *)data, (const uint8_t *)data + len);
+        return true;
+    }
+    virtual jpge::uint get_size() const { return out->size(); }
+};
+
+static size_t append(void *arg, size_t /*index*/, const void *data, size_t len)
+{
+    std::vector<uint8_t> *out = (std::vector<uint8_t> *)arg;
+    if (data)
+        out->insert(out->end(), (const uint8_t *)data, (const uint8_t *)data + len);
+    return len;
+}
+
+// convert_image() before the frame path: one RGB888 line per scanline.
+static bool encode_scanlines(const bench_format_t &f, const bench_frame_t &frame, int quality, std::vector<uint8_t> *out)
+{
+    jpge::params params;
+    params.m_quality = quality;
+    params.m_subsampling = jpge::H2V2;
+    vector_stream stream(out);
+    jpge::jpeg_encoder encoder;
+    if (!encoder.init(&stream, frame.width, frame.height, 3, params))
+        return false;
+    std::vector<uint8_t> line((size_t)frame.width * 3);
+    const uint8_t *src = frame.pixels[&f - FORMATS].data();
+    for (int y = 0; y < frame.height; y++)
+    {
+        f.to_rgb888(src + (size_t)y * frame.width * 2, line.data(), frame.width);
+        if (!encoder.process_scanline(line.data()))
+            return false;
+    }
+    return encoder.process_scanline(NULL);
+}
+
+static bool encode_frame(const bench_format_t &f, const bench_frame_t &frame, int quality, std::vector<uint8_t> *out)
+{
+    std::vector<uint8_t> &src = const_cast<std::vector<uint8_t> &>(frame.pixels[&f - FORMATS]);
+    return fmt2jpg_cb(src.data(), src.size(), frame.width, frame.height, f.format, quality, append, out);
+}
+
+typedef bool (*encode_fn_t)(const bench_format_t &f, const bench_frame_t &frame, int quality, std::vector<uint8_t> *out);
+
+// One pass over every frame, in ns. Odd widths are left out of YUV422,
+// which pairs pixels.
+static double run(encode_fn_t fn, const bench_format_t &f, const std::vector<bench_frame_t> &frames, int quality,
+                  std::vector<std::vector<uint8_t>> *out, size_t *bytes)
+{
+    out->assign(frames.size(), std::vector<uint8_t>());
+    *bytes = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < frames.size(); i++)
+    {
+        if (f.format == PIXFORMAT_YUV422 && (frames[i].width & 1))
+            continue;
+        (*out)[i].reserve(64 * 1024);
+        if (!fn(f, frames[i], quality, &(*out)[i]))
+        {
+            fprintf(stderr, "%s q%d: encoding failed\n", f.name, quality);
+            exit(1);
+        }
+        *bytes += frames[i].pixels[&f - FORMATS].size();
+    }
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+}
+
+typedef struct
+{
+    const std::vector<uint8_t> *jpeg;
+    size_t offset;
+    int width;
+    std::vector<uint8_t> *rgb888;
+} decoder_t;
+
+static UINT decode_read(JDEC *jd, BYTE *buf, UINT len)
+{
+    decoder_t *d = (decoder_t *)jd->device;
+    len = std::min<size_t>(len, d->jpeg->size() - std::min(d->offset, d->jpeg->size()));
+    if (buf && len)
+        memcpy(buf, d->jpeg->data() + d->offset, len);
+    d->offset += len;
+    return len;
+}
+
+static UINT decode_write(JDEC *jd, void *bitmap, JRECT *rect)
+{
+    decoder_t *d = (decoder_t *)jd->device;
+    size_t n = (size_t)(rect->right - rect->left + 1) * 3;
+    const uint8_t *src = (const uint8_t *)bitmap;
+    for (int y = rect->top; y <= rect->bottom; y++, src += n)
+        memcpy(d->rgb888->data() + ((size_t)y * d->width + rect->left) * 3, src, n);
+    return 1;
+}
+
+// PSNR of a decoded JPEG against the source frame. Decoded to RGB888: a
+// round trip through RGB565 would hide exact matches in its buckets and
+// blow up one level differences across them.
+static double psnr(const bench_frame_t &frame, const std::vector<uint8_t> &jpeg)
+{
+    static uint8_t work[8192];
+    size_t pixels = (size_t)frame.width * frame.height;
+    std::vector<uint8_t> decoded(pixels * 3), ref(pixels * 3);
+    decoder_t d = {&jpeg, 0, frame.width, &decoded};
+    JDEC jd;
+    if (jd_prepare(&jd, decode_read, work, sizeof(work), &d) != JDR_OK || jd_decomp(&jd, decode_write, 0) != JDR_OK)
+        return 0;
+    line_rgb565_to_rgb888(frame.pixels[0].data(), ref.data(), pixels);
+
+    double se = 0;
+    for (size_t i = 0; i < ref.size(); i++)
+        se += (double)(decoded[i] - ref[i]) * (decoded[i] - ref[i]);
+    return se > 0 ? 10 * log10(255.0 * 255.0 * ref.size() / se) : 99;
+}
+
+int main(int argc, char **argv)
+{
+    int repeat = 10;
+    std::vector<std::string> paths;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--repeat") && i + 1 < argc)
+            repeat = atoi(argv[++i]);
+        else
+            paths.push_back(argv[i]);
+    }
+    if (paths.empty() || repeat < 1)
+    {
+        fprintf(stderr, "usage: %s [--repeat N] <frame.jpg|dir>...\n", argv[0]);
+        return 2;
+    }
+
+    std::vector<bench_frame_t> frames;
+    for (const std::string &path : replay_list_frames(paths))
+    {
+        replay_frame_t frame;
+        if (!replay_load_frame(path, 320, 240, &frame))
+            continue;
+        bench_frame_t f;
+        f.width = frame.width;
+        f.height = frame.height;
+        f.pixels[0] = frame.rgb565;
+        rgb565_to_yuv422(frame.rgb565, &f.pixels[1]);
+        frames.push_back(std::move(f));
+    }
+    if (frames.empty())
+    {
+        fprintf(stderr, "no frames\n");
+        return 1;
+    }
+
+    printf("%u frames, best of %d passes\n\n", (unsigned)frames.size(), repeat);
+    printf("%-8s %4s %10s %10s %8s %10s %10s %16s\n", "format", "q", "old MB/s", "new MB/s", "speedup",
+           "old bytes", "new bytes", "diff / PSNR dB");
+    bool ok = true;
+    for (const bench_format_t &f : FORMATS)
+    {
+        for (int quality : QUALITIES)
+        {
+            // Best of the interleaved passes, the least disturbed by the host.
+            std::vector<std::vector<uint8_t>> before, after;
+            size_t bytes = 0;
+            double before_ns = 0, after_ns = 0;
+            for (int r = 0; r < repeat; r++)
+            {
+                double b = run(encode_scanlines, f, frames, quality, &before, &bytes);
+                double a = run(encode_frame, f, frames, quality, &after, &bytes);
+                before_ns = r ? std::min(before_ns, b) : b;
+                after_ns = r ? std::min(after_ns, a) : a;
+            }
+            size_t before_size = 0, after_size = 0, diff = 0;
+            double before_db = 0, after_db = 0;
+            int scored = 0;
+            for (size_t i = 0; i < frames.size(); i++)
+            {
+                if (before[i].empty())
+                    continue;
+                before_size += before[i].size();
+                after_size += after[i].size();
+                diff += before[i] != after[i];
+                before_db += psnr(frames[i], before[i]);
+                after_db += psnr(frames[i], after[i]);
+                scored++;
+            }
+            before_db /= scored;
+            after_db /= scored;
+
+            char verdict[32];
+            if (f.format == PIXFORMAT_RGB565)
+            {
+                snprintf(verdict, sizeof(verdict), "%u differ", (unsigned)diff);
+                ok &= diff == 0;
+            }
+            else
+            {
+                snprintf(verdict, sizeof(verdict), "%.2f / %.2f", before_db, after_db);
+                ok &= after_db >= before_db - 0.1;
+            }
+            printf("%-8s %4d %10.2f %10.2f %7.2fx %10u %10u %16s\n", f.name, quality,
+                   bytes / before_ns * 1e3, bytes / after_ns * 1e3, after_ns > 0 ? before_ns / after_ns : 0.0,
+                   (unsigned)before_size, (unsigned)after_size, verdict);
+        }
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,159 @@
+// Image pyramid of who_pyramid.cpp against a plain per-channel 2x2 mean.
+//
+//   who_pyramid_bench [--repeat N] [--levels N] <frame.jpg|dir>...
+//
+// Every frame is built as the RGB565 detection image and as the gray one
+// who_luma hands over for YUV422 and GRAYSCALE capture, each level checked
+// byte for byte against the reference computed from the level above. The
+// build time is per pixel of the image, what the pipeline pays once a frame
+// for the motion gate, MSR01 and the track thumbnails.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "replay.hpp"
+#include "img_line_convert.h"
+#include "who_pyramid.hpp"
+
+// Channels of an RGB565 pixel in camera byte order.
+static void unpack(uint16_t pixel, int *r, int *g, int *b)
+{
+    const uint8_t *p = (const uint8_t *)&pixel;
+    *r = p[0] >> 3;
+    *g = ((p[0] & 0x07) << 3) | (p[1] >> 5);
+    *b = p[1] & 0x1F;
+}
+
+static uint16_t pack(int r, int g, int b)
+{
+    uint16_t pixel;
+    uint8_t *p = (uint8_t *)&pixel;
+    p[0] = (uint8_t)((r << 3) | (g >> 3));
+    p[1] = (uint8_t)(((g & 0x07) << 5) | b);
+    return pixel;
+}
+
+static void reference_halve(const std::vector<uint16_t> &src, int src_width, int height, int width,
+                            std::vector<uint16_t> *dst)
+{
+    dst->resize((size_t)height * width);
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            int r = 2, g = 2, b = 2;
+            for (int i = 0; i < 4; i++)
+            {
+                int pr, pg, pb;
+                unpack(src[(size_t)(y * 2 + i / 2) * src_width + x * 2 + i % 2], &pr, &pg, &pb);
+                r += pr;
+                g += pg;
+                b += pb;
+            }
+            (*dst)[(size_t)y * width + x] = pack(r >> 2, g >> 2, b >> 2);
+        }
+    }
+}
+
+// Gray levels as RGB565, like who_luma_downscale() writes them.
+static std::vector<uint16_t> gray_image(const replay_frame_t &frame)
+{
+    size_t pixels = (size_t)frame.width * frame.height;
+    std::vector<uint8_t> gray(pixels);
+    line_rgb565_to_gray(frame.rgb565.data(), gray.data(), pixels);
+    std::vector<uint16_t> out(pixels);
+    for (size_t i = 0; i < pixels; i++)
+        out[i] = pack(gray[i] >> 3, gray[i] >> 2, gray[i] >> 3);
+    return out;
+}
+
+int main(int argc, char **argv)
+{
+    int repeat = 20;
+    int levels = 3;
+    std::vector<std::string> paths;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--repeat") && i + 1 < argc)
+            repeat = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--levels") && i + 1 < argc)
+            levels = atoi(argv[++i]);
+        else
+            paths.push_back(argv[i]);
+    }
+    if (paths.empty() || repeat < 1 || levels < 1 || levels > WHO_PYRAMID_MAX_LEVELS)
+    {
+        fprintf(stderr, "usage: %s [--repeat N] [--levels 1-%d] <frame.jpg|dir>...\n", argv[0],
+                WHO_PYRAMID_MAX_LEVELS);
+        return 2;
+    }
+
+    printf("%d levels, best of %d builds\n\n", levels, repeat);
+    printf("%-40s %-6s %9s %8s %10s %8s %10s\n", "frame", "image", "size", "levels", "arena B", "ns/px",
+           "diff px");
+    bool exact = true;
+    int frames = 0;
+    for (const std::string &path : replay_list_frames(paths))
+    {
+        replay_frame_t frame;
+        if (!replay_load_frame(path, 320, 240, &frame))
+            continue;
+        frames++;
+        std::vector<uint16_t> rgb565((const uint16_t *)frame.rgb565.data(),
+                                     (const uint16_t *)frame.rgb565.data() + (size_t)frame.width * frame.height);
+        const std::vector<uint16_t> images[2] = {rgb565, gray_image(frame)};
+        const char *names[2] = {"rgb565", "gray"};
+        for (int k = 0; k < 2; k++)
+        {
+            const std::vector<uint16_t> &image = images[k];
+            if (!who_pyramid_init(frame.height, frame.width, levels))
+            {
+                fprintf(stderr, "out of memory\n");
+                return 1;
+            }
+            double best = 0;
+            int built = 0;
+            for (int r = 0; r < repeat; r++)
+            {
+                auto start = std::chrono::steady_clock::now();
+                built = who_pyramid_build(image.data(), frame.height, frame.width);
+                double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+                best = r ? std::min(best, ns) : ns;
+            }
+
+            size_t diff = 0;
+            std::vector<uint16_t> above = image, ref;
+            int above_width = frame.width;
+            for (int l = 1; l < built; l++)
+            {
+                const who_pyramid_level_t *level = who_pyramid_level(l);
+                reference_halve(above, above_width, level->shape.height, level->shape.width, &ref);
+                for (size_t i = 0; i < ref.size(); i++)
+                    diff += level->image[i] != ref[i];
+                above.swap(ref);
+                above_width = level->shape.width;
+            }
+            exact &= diff == 0 && built == levels + 1;
+
+            who_pyramid_stats_t stats;
+            who_pyramid_get_stats(&stats);
+            char size[16];
+            snprintf(size, sizeof(size), "%dx%d", frame.width, frame.height);
+            std::string name = path.size() > 40 ? "..." + path.substr(path.size() - 37) : path;
+            printf("%-40s %-6s %9s %8d %10u %8.2f %10u\n", name.c_str(), names[k], size, built - 1,
+                   (unsigned)stats.arena_bytes, best / ((double)frame.width * frame.height), (unsigned)diff);
+        }
+    }
+    if (!frames)
+    {
+        fprintf(stderr, "no frames\n");
+        return 1;
+    }
+    return exact ? 0 : 1;
+}
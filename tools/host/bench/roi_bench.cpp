@@ -0,0 +1,237 @@
+// Region decoding of JPEG frames: jpg2rgb_rect(), which only runs IDCT and
+// color conversion on the MCUs under the rectangle and stops after its last
+// MCU row, against a full jpg2rgb565() decode the crop is cut out of.
+//
+//   who_roi_bench [--repeat N] <frame.jpg|dir>...
+//
+// Every frame is encoded at quality 80, then cut at a few face sized and
+// edge touching rectangles, at every scale, to RGB565 and RGB888. The crops
+// must match, byte for byte, the same rectangle of a whole frame decoded
+// straight with tjpgd.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "replay.hpp"
+#include "img_converters.h"
+#include "img_line_convert.h"
+
+extern "C" {
+#include "tjpgd.h"
+}
+
+typedef struct
+{
+    const char *name;
+    // Fractions of the frame, snapped to even pixels.
+    float x, y, w, h;
+} bench_rect_t;
+
+static const bench_rect_t RECTS[] = {
+    {"face", 0.35f, 0.25f, 0.30f, 0.40f},
+    {"top-left", 0.0f, 0.0f, 0.25f, 0.25f},
+    {"bottom-right", 0.70f, 0.70f, 0.30f, 0.30f},
+    {"band", 0.0f, 0.45f, 1.0f, 0.10f},
+    {"frame", 0.0f, 0.0f, 1.0f, 1.0f},
+};
+
+static const jpg_scale_t SCALES[] = {JPG_SCALE_NONE, JPG_SCALE_2X, JPG_SCALE_4X, JPG_SCALE_8X};
+
+typedef struct
+{
+    int width;
+    int height;
+    std::vector<uint8_t> jpeg;
+    std::vector<uint8_t> rgb888[4];     /*<! whole frame at each scale, R G B */
+} bench_frame_t;
+
+typedef struct
+{
+    const std::vector<uint8_t> *jpeg;
+    size_t offset;
+    int width;
+    std::vector<uint8_t> *rgb888;
+} decoder_t;
+
+static UINT decode_read(JDEC *jd, BYTE *buf, UINT len)
+{
+    decoder_t *d = (decoder_t *)jd->device;
+    len = std::min<size_t>(len, d->jpeg->size() - std::min(d->offset, d->jpeg->size()));
+    if (buf && len)
+        memcpy(buf, d->jpeg->data() + d->offset, len);
+    d->offset += len;
+    return len;
+}
+
+static UINT decode_write(JDEC *jd, void *bitmap, JRECT *rect)
+{
+    decoder_t *d = (decoder_t *)jd->device;
+    size_t n = (size_t)(rect->right - rect->left + 1) * 3;
+    const uint8_t *src = (const uint8_t *)bitmap;
+    for (int y = rect->top; y <= rect->bottom; y++, src += n)
+        memcpy(d->rgb888->data() + ((size_t)y * d->width + rect->left) * 3, src, n);
+    return 1;
+}
+
+// The whole frame at 1 / 2^scale, the reference the crops are cut from.
+static bool decode_full(const std::vector<uint8_t> &jpeg, int scale, int *width, int *height, std::vector<uint8_t> *rgb888)
+{
+    static uint8_t work[8192];
+    decoder_t d = {&jpeg, 0, 0, rgb888};
+    JDEC jd;
+    if (jd_prepare(&jd, decode_read, work, sizeof(work), &d) != JDR_OK)
+        return false;
+    *width = jd.width;
+    *height = jd.height;
+    d.width = (jd.width + (1 << scale) - 1) >> scale;
+    rgb888->assign((size_t)d.width * ((jd.height + (1 << scale) - 1) >> scale) * 3, 0);
+    return jd_decomp(&jd, decode_write, scale) == JDR_OK;
+}
+
+static size_t append(void *arg, size_t /*index*/, const void *data, size_t len)
+{
+    std::vector<uint8_t> *out = (std::vector<uint8_t> *)arg;
+    if (data)
+        out->insert(out->end(), (const uint8_t *)data, (const uint8_t *)data + len);
+    return len;
+}
+
+// The rectangle of a reference frame, in the layout jpg2rgb_rect() writes.
+static void crop(const bench_frame_t &frame, int scale, int x, int y, int w, int h, pixformat_t format,
+                 std::vector<uint8_t> *out)
+{
+    int stride = (frame.width + (1 << scale) - 1) >> scale;
+    size_t bpp = format == PIXFORMAT_RGB565 ? 2 : 3;
+    out->resize((size_t)w * h * bpp);
+    for (int row = 0; row < h; row++)
+    {
+        const uint8_t *src = frame.rgb888[scale].data() + ((size_t)(y + row) * stride + x) * 3;
+        uint8_t *dst = out->data() + (size_t)row * w * bpp;
+        if (format == PIXFORMAT_RGB565)
+        {
+            line_rgb888_to_rgb565(src, dst, w);
+            continue;
+        }
+        for (int i = 0; i < w * 3; i += 3)
+        {
+            dst[i] = src[i + 2];
+            dst[i + 1] = src[i + 1];
+            dst[i + 2] = src[i];
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int repeat = 10;
+    std::vector<std::string> paths;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--repeat") && i + 1 < argc)
+            repeat = atoi(argv[++i]);
+        else
+            paths.push_back(argv[i]);
+    }
+    if (paths.empty() || repeat < 1)
+    {
+        fprintf(stderr, "usage: %s [--repeat N] <frame.jpg|dir>...\n", argv[0]);
+        return 2;
+    }
+
+    std::vector<bench_frame_t> frames;
+    for (const std::string &path : replay_list_frames(paths))
+    {
+        replay_frame_t frame;
+        if (!replay_load_frame(path, 320, 240, &frame))
+            continue;
+        bench_frame_t f;
+        f.width = frame.width;
+        f.height = frame.height;
+        if (!fmt2jpg_cb(frame.rgb565.data(), frame.rgb565.size(), f.width, f.height, PIXFORMAT_RGB565, 80, append,
+                        &f.jpeg))
+        {
+            fprintf(stderr, "%s: encoding failed\n", path.c_str());
+            return 1;
+        }
+        for (int s = 0; s < 4; s++)
+        {
+            int w, h;
+            if (!decode_full(f.jpeg, s, &w, &h, &f.rgb888[s]))
+            {
+                fprintf(stderr, "%s: decoding failed\n", path.c_str());
+                return 1;
+            }
+        }
+        frames.push_back(std::move(f));
+    }
+    if (frames.empty())
+    {
+        fprintf(stderr, "no frames\n");
+        return 1;
+    }
+
+    printf("%u frames, best of %d passes, RGB565 timings\n\n", (unsigned)frames.size(), repeat);
+    printf("%-14s %5s %12s %12s %8s %10s\n", "rect", "scale", "full us", "rect us", "speedup", "differ");
+    bool exact = true;
+    std::vector<uint8_t> full, out, ref;
+    for (const bench_rect_t &r : RECTS)
+    {
+        for (jpg_scale_t scale : SCALES)
+        {
+            double full_ns = 0, rect_ns = 0;
+            size_t differ = 0;
+            for (const bench_frame_t &f : frames)
+            {
+                int x = (int)(r.x * f.width) & ~1, y = (int)(r.y * f.height) & ~1;
+                int w = std::min((int)(r.w * f.width + 1) & ~1, f.width - x);
+                int h = std::min((int)(r.h * f.height + 1) & ~1, f.height - y);
+                // The output rectangle, in scaled pixels.
+                int sx = x >> scale, sy = y >> scale, sw = w >> scale, sh = h >> scale;
+                if (!sw || !sh)
+                    continue;
+
+                for (pixformat_t format : {PIXFORMAT_RGB565, PIXFORMAT_RGB888})
+                {
+                    out.assign((size_t)sw * sh * (format == PIXFORMAT_RGB565 ? 2 : 3), 0);
+                    if (!jpg2rgb_rect(f.jpeg.data(), f.jpeg.size(), x, y, w, h, scale, format, out.data()))
+                    {
+                        fprintf(stderr, "%s %dx%d at %d,%d scale %d: decoding failed\n", r.name, w, h, x, y, scale);
+                        return 1;
+                    }
+                    crop(f, scale, sx, sy, sw, sh, format, &ref);
+                    differ += out != ref;
+                }
+
+                // Best of the interleaved passes, the least disturbed by the host.
+                size_t full_size = (size_t)((f.width + (1 << scale) - 1) >> scale) *
+                                   ((f.height + (1 << scale) - 1) >> scale) * 2;
+                full.resize(full_size);
+                double best_full = 0, best_rect = 0;
+                for (int i = 0; i < repeat; i++)
+                {
+                    auto t0 = std::chrono::steady_clock::now();
+                    jpg2rgb565(f.jpeg.data(), f.jpeg.size(), full.data(), scale);
+                    auto t1 = std::chrono::steady_clock::now();
+                    jpg2rgb_rect(f.jpeg.data(), f.jpeg.size(), x, y, w, h, scale, PIXFORMAT_RGB565, out.data());
+                    auto t2 = std::chrono::steady_clock::now();
+                    double a = std::chrono::duration<double, std::nano>(t1 - t0).count();
+                    double b = std::chrono::duration<double, std::nano>(t2 - t1).count();
+                    best_full = i ? std::min(best_full, a) : a;
+                    best_rect = i ? std::min(best_rect, b) : b;
+                }
+                full_ns += best_full;
+                rect_ns += best_rect;
+            }
+            exact &= differ == 0;
+            printf("%-14s %5d %12.1f %12.1f %7.2fx %10u\n", r.name, 1 << scale, full_ns / 1e3, rect_ns / 1e3,
+                   rect_ns > 0 ? full_ns / rect_ns : 0.0, (unsigned)differ);
+        }
+    }
+    return exact ? 0 : 1;
+}
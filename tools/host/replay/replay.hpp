@@ -0,0 +1,65 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <string>
+#include <vector>
+
+#include "esp_camera.h"
+
+/**
+ * @brief One recorded frame, decoded to RGB565 in camera byte order.
+ */
+typedef struct
+{
+    std::string path;
+    int width;
+    int height;
+    std::vector<uint8_t> rgb565;
+} replay_frame_t;
+
+/**
+ * @brief Load a recorded frame from disk.
+ *
+ * .jpg/.jpeg files are decoded with the esp32-camera JPEG decoder, any other
+ * file is taken as raw RGB565 of the given size.
+ *
+ * @param path       file to load
+ * @param raw_width  width of raw RGB565 files
+ * @param raw_height height of raw RGB565 files
+ * @param frame      output frame
+ * @return false when the file cannot be read or decoded
+ */
+bool replay_load_frame(const std::string &path, int raw_width, int raw_height, replay_frame_t *frame);
+
+/**
+ * @brief Expand directories into the frame files they contain, sorted by name.
+ */
+std::vector<std::string> replay_list_frames(const std::vector<std::string> &paths);
+
+/**
+ * @brief Copy a frame into a freshly allocated camera_fb_t, the way the
+ *        camera driver hands it out. Released by esp_camera_fb_return().
+ *
+ * @param frame        source frame
+ * @param format       PIXFORMAT_RGB565, or PIXFORMAT_YUV422 / PIXFORMAT_GRAYSCALE
+ *                     converted the way the sensor would deliver them
+ * @param timestamp_us capture timestamp to stamp on the buffer
+ */
+camera_fb_t *replay_make_frame(const replay_frame_t &frame, pixformat_t format, int64_t timestamp_us);
+
+/**
+ * @brief Number of frames the pipeline has handed back so far.
+ */
+uint32_t replay_frames_returned(void);
+
+/**
+ * @brief Block until the pipeline has handed back at least count frames.
+ */
+void replay_wait_returned(uint32_t count);
+
+/**
+ * @brief Number of csv_logger_log_face() calls made by the pipeline.
+ */
+uint32_t replay_faces_logged(void);
@@ -0,0 +1,249 @@
+#include "replay.hpp"
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+
+#include "esp_log.h"
+#include "img_converters.h"
+#include "dl_image.hpp"
+
+extern "C" {
+#include "tjpgd.h"
+}
+
+static const char *TAG = "replay_frames";
+
+// Work pool for tjpgd, with room for the decoder's tables at any pointer
+// size.
+#define JPG_WORK_SIZE 8192
+
+typedef struct
+{
+    const std::vector<uint8_t> *input;
+    size_t offset;
+    replay_frame_t *frame;
+} jpg_decoder_t;
+
+static bool has_suffix(const std::string &s, const char *suffix)
+{
+    size_t n = strlen(suffix);
+    if (s.size() < n)
+        return false;
+    return strcasecmp(s.c_str() + s.size() - n, suffix) == 0;
+}
+
+static bool is_jpeg(const std::string &path)
+{
+    return has_suffix(path, ".jpg") || has_suffix(path, ".jpeg");
+}
+
+static bool read_file(const std::string &path, std::vector<uint8_t> *data)
+{
+    FILE *f = fopen(path.c_str(), "rb");
+    if (!f)
+        return false;
+
+    fseek(f, 0, SEEK_END);
+    long len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    data->resize(len > 0 ? len : 0);
+    bool ok = len > 0 && fread(data->data(), 1, len, f) == (size_t)len;
+    fclose(f);
+    return ok;
+}
+
+static UINT jpg_read(JDEC *decoder, BYTE *buf, UINT len)
+{
+    jpg_decoder_t *jpeg = (jpg_decoder_t *)decoder->device;
+    size_t avail = jpeg->input->size() - std::min(jpeg->offset, jpeg->input->size());
+    len = std::min<size_t>(len, avail);
+    if (buf && len)
+        memcpy(buf, jpeg->input->data() + jpeg->offset, len);
+    jpeg->offset += len;
+    return len;
+}
+
+// Same packing as _rgb565_write() in conversions/to_bmp.c: high byte first,
+// which is how the sensor delivers PIXFORMAT_RGB565.
+static UINT jpg_write_rgb565(JDEC *decoder, void *bitmap, JRECT *rect)
+{
+    jpg_decoder_t *jpeg = (jpg_decoder_t *)decoder->device;
+    replay_frame_t *frame = jpeg->frame;
+    const uint8_t *data = (const uint8_t *)bitmap;
+
+    for (int y = rect->top; y <= rect->bottom; y++)
+    {
+        uint8_t *o = frame->rgb565.data() + ((size_t)y * frame->width + rect->left) * 2;
+        for (int x = rect->left; x <= rect->right; x++)
+        {
+            uint8_t r = data[0], g = data[1], b = data[2];
+            uint16_t c = ((r & 0xF8) << 8) | ((g & 0xFC) << 3) | (b >> 3);
+            o[0] = c >> 8;
+            o[1] = c & 0xff;
+            o += 2;
+            data += 3;
+        }
+    }
+    return 1;
+}
+
+static bool decode_jpeg(const std::vector<uint8_t> &data, replay_frame_t *frame)
+{
+    static uint8_t work[JPG_WORK_SIZE];
+    JDEC decoder;
+    jpg_decoder_t jpeg = {&data, 0, frame};
+
+    if (jd_prepare(&decoder, jpg_read, work, sizeof(work), &jpeg) != JDR_OK)
+        return false;
+
+    frame->width = decoder.width;
+    frame->height = decoder.height;
+    frame->rgb565.assign((size_t)frame->width * frame->height * 2, 0);
+    return jd_decomp(&decoder, jpg_write_rgb565, 0) == JDR_OK;
+}
+
+bool replay_load_frame(const std::string &path, int raw_width, int raw_height, replay_frame_t *frame)
+{
+    std::vector<uint8_t> data;
+    if (!read_file(path, &data))
+    {
+        ESP_LOGE(TAG, "cannot read %s", path.c_str());
+        return false;
+    }
+
+    frame->path = path;
+    if (is_jpeg(path))
+    {
+        if (!decode_jpeg(data, frame))
+        {
+            ESP_LOGE(TAG, "cannot decode %s", path.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    size_t expected = (size_t)raw_width * raw_height * 2;
+    if (data.size() != expected)
+    {
+        ESP_LOGE(TAG, "%s: %u bytes, expected %u for %dx%d RGB565",
+                 path.c_str(), (unsigned)data.size(), (unsigned)expected, raw_width, raw_height);
+        return false;
+    }
+    frame->width = raw_width;
+    frame->height = raw_height;
+    frame->rgb565.swap(data);
+    return true;
+}
+
+std::vector<std::string> replay_list_frames(const std::vector<std::string> &paths)
+{
+    std::vector<std::string> files;
+    for (const std::string &path : paths)
+    {
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0)
+        {
+            ESP_LOGW(TAG, "%s does not exist", path.c_str());
+            continue;
+        }
+        if (!S_ISDIR(st.st_mode))
+        {
+            files.push_back(path);
+            continue;
+        }
+
+        std::vector<std::string> entries;
+        DIR *dir = opendir(path.c_str());
+        if (!dir)
+            continue;
+        while (struct dirent *ent = readdir(dir))
+        {
+            if (ent->d_name[0] == '.')
+                continue;
+            entries.push_back(path + "/" + ent->d_name);
+        }
+        closedir(dir);
+        std::sort(entries.begin(), entries.end());
+        files.insert(files.end(), entries.begin(), entries.end());
+    }
+    return files;
+}
+
+// BT.601 video range, what yuv_table and fmt2rgb888() decode.
+static void rgb565_to_yuv(uint16_t pixel, int *y, int *u, int *v)
+{
+    uint8_t bgr[3];
+    dl::image::convert_pixel_rgb565_to_rgb888(pixel, bgr);
+    int b = bgr[0], g = bgr[1], r = bgr[2];
+    *y = ((66 * r + 129 * g + 25 * b + 128) >> 8) + 16;
+    *u = ((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128;
+    *v = ((112 * r - 94 * g - 18 * b + 128) >> 8) + 128;
+}
+
+static size_t frame_size(const replay_frame_t &frame, pixformat_t format)
+{
+    return (size_t)frame.width * frame.height * (format == PIXFORMAT_GRAYSCALE ? 1 : 2);
+}
+
+static void convert_frame(const replay_frame_t &frame, pixformat_t format, uint8_t *out)
+{
+    const uint16_t *src = (const uint16_t *)frame.rgb565.data();
+    int pixels = frame.width * frame.height;
+    if (format == PIXFORMAT_GRAYSCALE)
+    {
+        for (int i = 0; i < pixels; i++)
+        {
+            int y, u, v;
+            rgb565_to_yuv(src[i], &y, &u, &v);
+            out[i] = (uint8_t)y;
+        }
+    }
+    else if (format == PIXFORMAT_YUV422)
+    {
+        // Y0 U Y1 V, chroma averaged over pairs within a row. A last odd
+        // column (sensors have none) keeps Y and U.
+        for (int i = 0; i < pixels; i++)
+        {
+            int y0, u0, v0, y1, u1, v1;
+            rgb565_to_yuv(src[i], &y0, &u0, &v0);
+            out[i * 2] = (uint8_t)y0;
+            if ((i % frame.width) + 1 == frame.width)
+            {
+                out[i * 2 + 1] = (uint8_t)u0;
+                continue;
+            }
+            rgb565_to_yuv(src[i + 1], &y1, &u1, &v1);
+            out[i * 2 + 1] = (uint8_t)((u0 + u1 + 1) / 2);
+            out[i * 2 + 2] = (uint8_t)y1;
+            out[i * 2 + 3] = (uint8_t)((v0 + v1 + 1) / 2);
+            i++;
+        }
+    }
+    else
+    {
+        memcpy(out, frame.rgb565.data(), frame.rgb565.size());
+    }
+}
+
+camera_fb_t *replay_make_frame(const replay_frame_t &frame, pixformat_t format, int64_t timestamp_us)
+{
+    size_t size = frame_size(frame, format);
+    camera_fb_t *fb = (camera_fb_t *)malloc(sizeof(camera_fb_t) + size);
+    if (!fb)
+        return NULL;
+
+    fb->buf = (uint8_t *)(fb + 1);
+    fb->len = size;
+    fb->width = frame.width;
+    fb->height = frame.height;
+    fb->format = format;
+    fb->timestamp.tv_sec = timestamp_us / 1000000;
+    fb->timestamp.tv_usec = timestamp_us % 1000000;
+    convert_frame(frame, format, fb->buf);
+    return fb;
+}
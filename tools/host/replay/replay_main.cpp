@@ -0,0 +1,378 @@
+// Offline replay of the face pipeline.
+//
+// Feeds recorded frames through register_human_face_recognition() exactly
+// like who_camera does on the board, then prints the per-stage latency
+// percentiles collected by who_pipeline_stats.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "host_shim.h"
+
+#include "replay.hpp"
+#include "who_human_face_recognition.hpp"
+#include "who_pipeline_stats.hpp"
+#include "who_motion_gate.hpp"
+#include "who_pyramid.hpp"
+#include "who_face_roi.hpp"
+#include "who_face_gallery.hpp"
+#include "who_face_quality.hpp"
+#include "who_face_ring.hpp"
+#include "who_frame_scheduler.hpp"
+#include "who_face_detect.hpp"
+#include "who_face_track.hpp"
+#include "who_frame.h"
+#include "who_camera.h"
+#include "who_file_camera.h"
+
+static const char *TAG = "replay";
+
+typedef struct
+{
+    int raw_width = 320;
+    int raw_height = 240;
+    float fps = 0.0f;
+    int loops = 1;
+    bool realtime = false;
+    int log_level = ESP_LOG_WARN;
+    int readers = 0;
+    bool camera = false;
+    std::vector<std::string> paths;
+} replay_args_t;
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+            "usage: %s [options] <frame file or directory>...\n"
+            "  --size WxH     size of raw RGB565 frames (default 320x240)\n"
+            "  --fps N        feed frames at N fps like the camera, 0 = as fast as\n"
+            "                 the pipeline accepts them (default 0)\n"
+            "  --loops N      replay the sequence N times (default 1)\n"
+            "  --realtime     keep the firmware vTaskDelay() sleeps\n"
+            "  --readers N    threads sharing frames with the detector like the\n"
+            "                 /capture handler (default 0)\n"
+            "  --camera       serve one directory of WxH frames through who_file_camera\n"
+            "                 and the real camera task instead of feeding the queue\n"
+            "  --log-level N  0=none .. 5=verbose (default 2, warnings)\n",
+            argv0);
+}
+
+static bool parse_args(int argc, char **argv, replay_args_t *args)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        const char *a = argv[i];
+        bool has_value = i + 1 < argc;
+        if (!strcmp(a, "--size") && has_value)
+        {
+            if (sscanf(argv[++i], "%dx%d", &args->raw_width, &args->raw_height) != 2)
+                return false;
+        }
+        else if (!strcmp(a, "--fps") && has_value)
+            args->fps = atof(argv[++i]);
+        else if (!strcmp(a, "--loops") && has_value)
+            args->loops = atoi(argv[++i]);
+        else if (!strcmp(a, "--realtime"))
+            args->realtime = true;
+        else if (!strcmp(a, "--readers") && has_value)
+            args->readers = atoi(argv[++i]);
+        else if (!strcmp(a, "--camera"))
+            args->camera = true;
+        else if (!strcmp(a, "--log-level") && has_value)
+            args->log_level = atoi(argv[++i]);
+        else if (a[0] == '-')
+            return false;
+        else
+            args->paths.push_back(a);
+    }
+    return !args->paths.empty() && args->loops > 0 && (!args->camera || args->paths.size() == 1);
+}
+
+static void print_summary(int64_t wall_us, uint32_t frames, uint32_t dropped)
+{
+    printf("\n%-10s %8s %10s %10s %10s %10s %10s\n", "stage", "n", "mean_us", "p50_us", "p95_us", "p99_us", "max_us");
+    for (int i = 0; i < WHO_STAGE_MAX; i++)
+    {
+        who_stage_summary_t s;
+        if (!who_stats_get((who_stage_t)i, &s))
+            continue;
+        printf("%-10s %8u %10lld %10lld %10lld %10lld %10lld\n",
+               who_stats_stage_name((who_stage_t)i), (unsigned)s.count,
+               (long long)s.mean_us, (long long)s.p50_us, (long long)s.p95_us,
+               (long long)s.p99_us, (long long)s.max_us);
+    }
+    printf("\nframes: %u (%u dropped), pipeline fps: %.2f, wall fps: %.2f, faces logged: %u\n",
+           (unsigned)frames, (unsigned)dropped, who_stats_get_fps(),
+           wall_us > 0 ? frames * 1000000.0 / wall_us : 0.0,
+           (unsigned)replay_faces_logged());
+    who_detect_stats_t detect;
+    who_detect_get_stats(&detect);
+    printf("detector: %u passes, %u faces, %u over capacity\n",
+           (unsigned)detect.runs, (unsigned)detect.faces, (unsigned)detect.truncated);
+    printf("cascade: MNP01 ran %u times, skipped %u (all reused) / %u (below floor), %u faces reused, %u candidates capped, %u out of size range\n",
+           (unsigned)detect.mnp01_runs, (unsigned)detect.mnp01_skipped, (unsigned)detect.below_floor,
+           (unsigned)detect.reused, (unsigned)detect.capped, (unsigned)detect.out_of_range);
+#if CONFIG_WHO_PYRAMID_LEVELS
+    who_pyramid_stats_t pyramid;
+    who_pyramid_get_stats(&pyramid);
+    printf("pyramid: %u frames, %u levels in %u bytes%s\n", (unsigned)pyramid.builds, (unsigned)pyramid.levels,
+           (unsigned)pyramid.arena_bytes, pyramid.in_psram ? " of PSRAM" : "");
+#endif
+#if CONFIG_WHO_MOTION_GATE
+    who_motion_stats_t motion;
+    who_motion_gate_get_stats(&motion);
+    printf("motion gate: %u/%u frames gated, %u moving, %u refreshes\n",
+           (unsigned)motion.gated, (unsigned)motion.frames,
+           (unsigned)motion.moving, (unsigned)motion.refreshes);
+#endif
+#if CONFIG_WHO_ROI_REDETECT
+    who_roi_stats_t roi;
+    who_roi_get_stats(&roi);
+    printf("roi: %u crop passes (%u lost), %u full-frame passes\n",
+           (unsigned)roi.roi_passes, (unsigned)roi.lost, (unsigned)roi.full_passes);
+#endif
+#if CONFIG_WHO_QUALITY_GATE
+    who_quality_stats_t quality;
+    who_quality_get_stats(&quality);
+    printf("quality: %u/%u faces passed, rejected:", (unsigned)quality.outcomes[WHO_QUALITY_OK], (unsigned)quality.checked);
+    for (int i = WHO_QUALITY_OK + 1; i < WHO_QUALITY_MAX; i++)
+        printf(" %s %u", who_quality_name((who_quality_t)i), (unsigned)quality.outcomes[i]);
+    printf(", last sharpness %u\n", (unsigned)quality.last_sharpness);
+#endif
+    who_sched_stats_t sched;
+    who_sched_get_stats(&sched);
+    printf("scheduler: %u active / %u idle / %u backoff frames, %u switches, %u starvation reports\n",
+           (unsigned)sched.frames[WHO_SCHED_ACTIVE], (unsigned)sched.frames[WHO_SCHED_IDLE],
+           (unsigned)sched.frames[WHO_SCHED_BACKOFF], (unsigned)sched.switches,
+           (unsigned)sched.starvation_reports);
+    who_face_ring_stats_t ring;
+    who_face_ring_get_stats(&ring);
+    printf("handoff: %u faces in %u batches to recognition, %u batches dropped (recognition behind)\n",
+           (unsigned)ring.faces, (unsigned)ring.published, (unsigned)ring.dropped);
+    // Both tasks are idle once frames, ring and tracks have drained.
+    who_track_detect_stats_t track;
+    who_track_get_detect_stats(&track);
+    who_track_sample_stats_t samples;
+    who_track_get_sample_stats(&samples);
+    printf("tracks: %u started, %u embeddings, %u faces skipped, decided %u mature / %u lost, %u splits\n",
+           (unsigned)track.tracks, (unsigned)samples.samples, (unsigned)samples.skipped,
+           (unsigned)samples.matured, (unsigned)samples.ended, (unsigned)samples.splits);
+    printf("decided tracks: %u faces not aligned, %u re-recognized after an appearance change, %u faces without a track\n",
+           (unsigned)track.cached, (unsigned)track.refreshed, (unsigned)samples.untracked);
+    who_camera_stats_t camera;
+    who_camera_get_stats(&camera);
+    printf("frame age:");
+    for (int i = 0; i < WHO_CAMERA_AGE_BUCKETS; i++)
+    {
+        if (who_camera_age_bucket_ms(i))
+            printf(" <%dms %u", who_camera_age_bucket_ms(i), (unsigned)camera.age[i]);
+        else
+            printf(" more %u", (unsigned)camera.age[i]);
+    }
+    printf(", oldest admitted %u ms, dropped:", (unsigned)camera.max_age_ms);
+    for (int i = 0; i < WHO_CAMERA_DROP_MAX; i++)
+        printf(" %s %u", who_camera_drop_name((who_camera_drop_t)i), (unsigned)camera.drops[i]);
+    printf(", queued behind 0/1/2/3+: %u/%u/%u/%u\n",
+           (unsigned)camera.queue[0], (unsigned)camera.queue[1], (unsigned)camera.queue[2], (unsigned)camera.queue[3]);
+    who_frame_stats_t shared;
+    who_frame_get_stats(&shared);
+    printf("frames: %u published, %u shared with readers, %u returned, %u held, %u reader timeouts\n",
+           (unsigned)shared.published, (unsigned)shared.shared, (unsigned)shared.returned,
+           (unsigned)shared.held, (unsigned)shared.timeouts);
+    who_gallery_stats_t gallery;
+    who_gallery_get_stats(&gallery);
+    printf("gallery: %u/%d entries, %u hits, %u misses, %u lru / %u ttl evictions\n",
+           (unsigned)gallery.size, who_gallery_capacity(), (unsigned)gallery.hits,
+           (unsigned)gallery.misses, (unsigned)gallery.evicted_lru, (unsigned)gallery.evicted_ttl);
+#if CONFIG_WHO_GALLERY_COMPARE_FLOAT
+    printf("int8 vs float: %u/%u lookups disagree, max similarity error %.4f\n",
+           (unsigned)gallery.mismatches, (unsigned)gallery.compared, gallery.max_error);
+#endif
+}
+
+// Feeds the frames to the detector queue the way who_camera does.
+static bool run_feeder(const replay_args_t &args, const std::vector<replay_frame_t> &frames,
+                       QueueHandle_t xQueueAIFrame, uint32_t *sent, uint32_t *dropped)
+{
+    int64_t period_us = args.fps > 0 ? (int64_t)(1000000.0f / args.fps) : 0;
+    int64_t next_us = esp_timer_get_time();
+
+    for (int loop = 0; loop < args.loops; loop++)
+    {
+        for (const replay_frame_t &frame : frames)
+        {
+            if (period_us)
+            {
+                int64_t now = esp_timer_get_time();
+                if (next_us > now)
+                    usleep(next_us - now);
+                next_us += period_us;
+            }
+
+            camera_fb_t *fb = replay_make_frame(frame, WHO_CAMERA_PIXFORMAT, esp_timer_get_time());
+            if (!fb)
+            {
+                ESP_LOGE(TAG, "out of memory");
+                return false;
+            }
+
+            who_frame_publish(fb);
+            if (period_us)
+            {
+                // Camera semantics: a full queue drops the frame instead of waiting.
+                if (xQueueSend(xQueueAIFrame, &fb, 0) != pdTRUE)
+                {
+                    who_frame_release(fb);
+                    (*dropped)++;
+                }
+            }
+            else
+            {
+                xQueueSend(xQueueAIFrame, &fb, portMAX_DELAY);
+            }
+            (*sent)++;
+        }
+    }
+    return true;
+}
+
+// Serves the directory through esp_camera_fb_get() to the firmware's own
+// camera task, which drops frames when the detector queue is full.
+static bool run_camera(const replay_args_t &args, QueueHandle_t xQueueAIFrame, uint32_t *sent, uint32_t *dropped)
+{
+    if (WHO_CAMERA_PIXFORMAT != PIXFORMAT_RGB565)
+    {
+        ESP_LOGE(TAG, "--camera serves RGB565 frames only");
+        return false;
+    }
+    who_file_camera_config_t config = {};
+    config.dir = args.paths[0].c_str();
+    config.width = args.raw_width;
+    config.height = args.raw_height;
+    config.fps = args.fps;
+    config.fb_count = 2;    // CONFIG_CAMERA_FB_COUNT default
+    config.loops = args.loops;
+    if (who_file_camera_start(&config) != ESP_OK)
+        return false;
+    register_camera(WHO_CAMERA_PIXFORMAT, FRAMESIZE_QVGA, config.fb_count, xQueueAIFrame);
+
+    who_file_camera_stats_t file = {};
+    do
+    {
+        usleep(1000);
+        who_file_camera_get_stats(&file);
+    } while (!file.finished);
+    // The last frame may still be between esp_camera_fb_get() and the queue.
+    who_camera_stats_t camera = {};
+    do
+    {
+        usleep(1000);
+        who_camera_get_stats(&camera);
+    } while (camera.captured < file.served);
+
+    // Stale frames are counted once the queue has drained, see main().
+    uint32_t queue_drops = camera.drops[WHO_CAMERA_DROP_EVICTED] + camera.drops[WHO_CAMERA_DROP_FULL];
+    *sent = camera.captured;
+    *dropped = queue_drops;
+    printf("camera: %u frames served from files (%u late, %u skipped), %u dropped by the camera task\n",
+           (unsigned)file.served, (unsigned)file.late, (unsigned)file.skipped, (unsigned)queue_drops);
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    replay_args_t args;
+    if (!parse_args(argc, argv, &args))
+    {
+        usage(argv[0]);
+        return 2;
+    }
+
+    host_set_default_log_level(args.log_level);
+    host_set_delay_scale(args.realtime ? 1.0f : 0.0f);
+
+    std::vector<replay_frame_t> frames;
+    if (!args.camera)
+    {
+        for (const std::string &path : replay_list_frames(args.paths))
+        {
+            replay_frame_t frame;
+            if (replay_load_frame(path, args.raw_width, args.raw_height, &frame))
+                frames.push_back(std::move(frame));
+        }
+        if (frames.empty())
+        {
+            ESP_LOGE(TAG, "no frames to replay");
+            return 1;
+        }
+        printf("replaying %u frames x %d\n", (unsigned)frames.size(), args.loops);
+    }
+
+    // Same depth as xQueueAIFrame in app_main.cpp.
+    QueueHandle_t xQueueAIFrame = xQueueCreate(2, sizeof(camera_fb_t *));
+    register_human_face_recognition(xQueueAIFrame, NULL, NULL, NULL, true);
+    who_frame_init();
+
+    // Readers hold each frame they get for a while, the way /capture holds
+    // it while sending; the detector keeps going meanwhile.
+    std::atomic<bool> feeding(true);
+    std::vector<std::thread> readers;
+    for (int i = 0; i < args.readers; i++)
+    {
+        readers.emplace_back([&feeding] {
+            while (feeding)
+            {
+                camera_fb_t *fb = who_frame_wait(pdMS_TO_TICKS(100));
+                if (!fb)
+                    continue;
+                usleep(2000);
+                who_frame_release(fb);
+            }
+        });
+    }
+
+    int64_t start_us = esp_timer_get_time();
+    uint32_t sent = 0;
+    uint32_t dropped = 0;
+    bool ok = args.camera ? run_camera(args, xQueueAIFrame, &sent, &dropped)
+                          : run_feeder(args, frames, xQueueAIFrame, &sent, &dropped);
+    if (!ok)
+        return 1;
+
+    feeding = false;
+    for (std::thread &reader : readers)
+        reader.join();
+    replay_wait_returned(sent);
+    // Every frame is back: the ones dequeued too old never reach the handler.
+    who_camera_stats_t camera = {};
+    who_camera_get_stats(&camera);
+    dropped += camera.drops[WHO_CAMERA_DROP_STALE];
+    // Frames are released before the handler records their total time.
+    who_stage_summary_t frame_stats = {};
+    while (!who_stats_get(WHO_STAGE_FRAME, &frame_stats) || frame_stats.count < sent - dropped)
+        usleep(1000);
+    // Faces handed to the recognition task may still be in flight.
+    who_face_ring_stats_t ring = {};
+    do
+    {
+        usleep(1000);
+        who_face_ring_get_stats(&ring);
+    } while (ring.consumed < ring.published);
+    // Tracks still collecting are decided once they are lost.
+    while (who_track_pending())
+        usleep(1000);
+
+    print_summary(esp_timer_get_time() - start_us, sent, dropped);
+    return 0;
+}
@@ -0,0 +1,118 @@
+// Host stand-ins for the firmware collaborators of task_process_handler.
+// They keep the pipeline code unmodified while making its side effects
+// (frame release, CSV logging) observable by the replay driver.
+
+#include "replay.hpp"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <condition_variable>
+#include <mutex>
+
+#include "csv_logger.h"
+#include "csv_uploader.h"
+#include "esp_camera.h"
+#include "esp_log.h"
+#include "gps_neo7m.hpp"
+
+static const char *TAG = "replay_stubs";
+
+static std::mutex s_lock;
+static std::condition_variable s_returned_cv;
+static uint32_t s_returned = 0;
+static uint32_t s_logged = 0;
+
+uint32_t replay_frames_returned(void)
+{
+    std::lock_guard<std::mutex> lk(s_lock);
+    return s_returned;
+}
+
+void replay_wait_returned(uint32_t count)
+{
+    std::unique_lock<std::mutex> lk(s_lock);
+    s_returned_cv.wait(lk, [count] { return s_returned >= count; });
+}
+
+uint32_t replay_faces_logged(void)
+{
+    std::lock_guard<std::mutex> lk(s_lock);
+    return s_logged;
+}
+
+// There is no sensor on the host: frames come from the replay feeder, or
+// from a frame source (who_file_camera) read by the real camera task.
+static const camera_fb_source_t *s_fb_source = NULL;
+
+esp_err_t esp_camera_init(const camera_config_t *config)
+{
+    (void)config;
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+sensor_t *esp_camera_sensor_get()
+{
+    return NULL;
+}
+
+void esp_camera_set_fb_source(const camera_fb_source_t *source)
+{
+    s_fb_source = source;
+}
+
+const camera_fb_source_t *esp_camera_get_fb_source()
+{
+    return s_fb_source;
+}
+
+camera_fb_t *esp_camera_fb_get()
+{
+    return s_fb_source ? s_fb_source->fb_get(s_fb_source->ctx) : NULL;
+}
+
+// Frames of the replay feeder are owned by it: the pixel buffer is allocated
+// together with the camera_fb_t, see replay_make_frame().
+void esp_camera_fb_return(camera_fb_t *fb)
+{
+    if (s_fb_source)
+        s_fb_source->fb_return(s_fb_source->ctx, fb);
+    else
+        free(fb);
+    std::lock_guard<std::mutex> lk(s_lock);
+    s_returned++;
+    s_returned_cv.notify_all();
+}
+
+gps_data_t gps_get_current_data(void)
+{
+    gps_data_t data = {};
+    strncpy(data.timestamp, "1970-01-01T00:00:00Z", sizeof(data.timestamp) - 1);
+    return data;
+}
+
+esp_err_t csv_logger_log_face(int face_id, float *face_embedding, int embedding_size, csv_gps_data_t gps_data, uint8_t *image_buf, size_t image_len)
+{
+    (void)face_embedding, (void)gps_data, (void)image_buf, (void)image_len;
+    {
+        std::lock_guard<std::mutex> lk(s_lock);
+        s_logged++;
+    }
+    ESP_LOGD(TAG, "logged face ID %d (%d-d embedding)", face_id, embedding_size);
+    return ESP_OK;
+}
+
+esp_err_t csv_uploader_trigger_now(void)
+{
+    return ESP_OK;
+}
+
+void csv_uploader_set_lag_callback(csv_uploader_lag_cb_t cb)
+{
+    (void)cb;
+}
+
+extern "C" bool power_mgmt_is_trip_time(void)
+{
+    return true;
+}
@@ -0,0 +1,199 @@
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "host_shim.h"
+
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+static const auto s_boot = std::chrono::steady_clock::now();
+static std::mutex s_log_lock;
+static std::map<std::string, esp_log_level_t> s_log_levels;
+static esp_log_level_t s_default_level = ESP_LOG_INFO;
+
+struct esp_timer
+{
+    esp_timer_create_args_t args;
+};
+
+// Size of every RAM-backed partition, the "fr" face ID partition is 128 KiB
+// in examples/human_face_detection/web/partitions.csv.
+#define HOST_PARTITION_SIZE (128 * 1024)
+
+struct host_partition
+{
+    esp_partition_t info;
+    std::vector<uint8_t> data;
+};
+
+static std::mutex s_partition_lock;
+static std::map<std::string, host_partition *> s_partitions;
+
+extern "C" {
+
+const char *esp_err_to_name(esp_err_t code)
+{
+    switch (code)
+    {
+    case ESP_OK:
+        return "ESP_OK";
+    case ESP_FAIL:
+        return "ESP_FAIL";
+    case ESP_ERR_NO_MEM:
+        return "ESP_ERR_NO_MEM";
+    case ESP_ERR_INVALID_ARG:
+        return "ESP_ERR_INVALID_ARG";
+    case ESP_ERR_INVALID_STATE:
+        return "ESP_ERR_INVALID_STATE";
+    case ESP_ERR_INVALID_SIZE:
+        return "ESP_ERR_INVALID_SIZE";
+    case ESP_ERR_NOT_FOUND:
+        return "ESP_ERR_NOT_FOUND";
+    case ESP_ERR_NOT_SUPPORTED:
+        return "ESP_ERR_NOT_SUPPORTED";
+    case ESP_ERR_TIMEOUT:
+        return "ESP_ERR_TIMEOUT";
+    default:
+        return "UNKNOWN_ERROR";
+    }
+}
+
+void host_set_default_log_level(int level)
+{
+    std::lock_guard<std::mutex> lk(s_log_lock);
+    s_default_level = (esp_log_level_t)level;
+}
+
+void esp_log_level_set(const char *tag, esp_log_level_t level)
+{
+    std::lock_guard<std::mutex> lk(s_log_lock);
+    if (std::string(tag) == "*")
+        s_default_level = level;
+    else
+        s_log_levels[tag] = level;
+}
+
+void esp_log_write(esp_log_level_t level, const char *tag, const char *format, ...)
+{
+    static const char letters[] = "NEWIDV";
+
+    std::lock_guard<std::mutex> lk(s_log_lock);
+    auto it = s_log_levels.find(tag);
+    esp_log_level_t limit = it == s_log_levels.end() ? s_default_level : it->second;
+    if (level > limit)
+        return;
+
+    fprintf(stderr, "%c (%lld) %s: ", letters[level], (long long)(esp_timer_get_time() / 1000), tag);
+    va_list args;
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+    fputc('\n', stderr);
+}
+
+int64_t esp_timer_get_time(void)
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - s_boot).count();
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *create_args, esp_timer_handle_t *out_handle)
+{
+    *out_handle = new esp_timer{*create_args};
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us)
+{
+    (void)timer, (void)timeout_us;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer)
+{
+    (void)timer;
+    return ESP_OK;
+}
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype, const char *label)
+{
+    std::lock_guard<std::mutex> lk(s_partition_lock);
+    std::string key = label ? label : "";
+    host_partition *&p = s_partitions[key];
+    if (!p)
+    {
+        p = new host_partition();
+        p->info.type = type;
+        p->info.subtype = subtype;
+        p->info.size = HOST_PARTITION_SIZE;
+        snprintf(p->info.label, sizeof(p->info.label), "%s", key.c_str());
+        p->data.assign(HOST_PARTITION_SIZE, 0xff);
+    }
+    return &p->info;
+}
+
+static host_partition *partition_of(const esp_partition_t *partition, size_t offset, size_t size)
+{
+    if (!partition || offset + size > partition->size)
+        return NULL;
+    return s_partitions[partition->label];
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *partition, size_t src_offset, void *dst, size_t size)
+{
+    std::lock_guard<std::mutex> lk(s_partition_lock);
+    host_partition *p = partition_of(partition, src_offset, size);
+    if (!p)
+        return ESP_ERR_INVALID_SIZE;
+    memcpy(dst, p->data.data() + src_offset, size);
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t *partition, size_t dst_offset, const void *src, size_t size)
+{
+    std::lock_guard<std::mutex> lk(s_partition_lock);
+    host_partition *p = partition_of(partition, dst_offset, size);
+    if (!p)
+        return ESP_ERR_INVALID_SIZE;
+    // NOR flash semantics: writes can only clear bits.
+    const uint8_t *in = (const uint8_t *)src;
+    for (size_t i = 0; i < size; i++)
+        p->data[dst_offset + i] &= in[i];
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t *partition, size_t offset, size_t size)
+{
+    std::lock_guard<std::mutex> lk(s_partition_lock);
+    host_partition *p = partition_of(partition, offset, size);
+    if (!p)
+        return ESP_ERR_INVALID_SIZE;
+    memset(p->data.data() + offset, 0xff, size);
+    return ESP_OK;
+}
+
+void esp_restart(void)
+{
+    fprintf(stderr, "esp_restart() called\n");
+    abort();
+}
+
+uint32_t esp_get_free_heap_size(void)
+{
+    return 4 * 1024 * 1024;
+}
+
+uint32_t esp_get_minimum_free_heap_size(void)
+{
+    return 4 * 1024 * 1024;
+}
+
+} // extern "C"
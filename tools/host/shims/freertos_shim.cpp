@@ -0,0 +1,275 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "host_shim.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using clock_type = std::chrono::steady_clock;
+
+static float s_delay_scale = 1.0f;
+static const clock_type::time_point s_boot = clock_type::now();
+static std::recursive_mutex s_critical;
+
+struct host_queue
+{
+    std::mutex lock;
+    std::condition_variable not_empty;
+    std::condition_variable not_full;
+    std::deque<std::vector<uint8_t>> items;
+    size_t length;
+    size_t item_size;
+};
+
+struct host_task
+{
+    std::mutex lock;
+    std::condition_variable notified;
+    uint32_t notify_count = 0;
+    BaseType_t core_id = 0;
+    TaskFunction_t fn = NULL;
+    void *params = NULL;
+};
+
+// Tasks are never deleted, neither are their handles.
+static thread_local host_task *s_current_task = NULL;
+
+struct host_semaphore
+{
+    std::mutex lock;
+    std::condition_variable cv;
+    bool available;
+};
+
+template <typename Pred>
+static bool wait_for(std::condition_variable &cv, std::unique_lock<std::mutex> &lk, TickType_t ticks, Pred pred)
+{
+    if (ticks == portMAX_DELAY)
+    {
+        cv.wait(lk, pred);
+        return true;
+    }
+    return cv.wait_for(lk, std::chrono::milliseconds(ticks * portTICK_PERIOD_MS), pred);
+}
+
+extern "C" {
+
+void host_set_delay_scale(float scale)
+{
+    s_delay_scale = scale;
+}
+
+void vPortEnterCritical(portMUX_TYPE *mux)
+{
+    (void)mux;
+    s_critical.lock();
+}
+
+void vPortExitCritical(portMUX_TYPE *mux)
+{
+    (void)mux;
+    s_critical.unlock();
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    // The main thread and foreign threads get a handle on first use.
+    if (!s_current_task)
+        s_current_task = new host_task();
+    return s_current_task;
+}
+
+BaseType_t xPortGetCoreID(void)
+{
+    return xTaskGetCurrentTaskHandle()->core_id;
+}
+
+static void task_entry(host_task *task)
+{
+    s_current_task = task;
+    task->fn(task->params);
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack_depth,
+                                   void *params, UBaseType_t priority, TaskHandle_t *created_task,
+                                   BaseType_t core_id)
+{
+    (void)name, (void)stack_depth, (void)priority;
+    host_task *task = new host_task();
+    task->core_id = core_id == tskNO_AFFINITY ? 0 : core_id;
+    task->fn = fn;
+    task->params = params;
+    if (created_task)
+        *created_task = task;
+    std::thread(task_entry, task).detach();
+    return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack_depth,
+                       void *params, UBaseType_t priority, TaskHandle_t *created_task)
+{
+    return xTaskCreatePinnedToCore(fn, name, stack_depth, params, priority, created_task, tskNO_AFFINITY);
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+    (void)task;
+    // Only a task deleting itself is supported; park the thread forever.
+    for (;;)
+        std::this_thread::sleep_for(std::chrono::hours(1));
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    int64_t us = (int64_t)((float)ticks * portTICK_PERIOD_MS * 1000.0f * s_delay_scale);
+    if (us > 0)
+        std::this_thread::sleep_for(std::chrono::microseconds(us));
+    else
+        std::this_thread::yield();
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(clock_type::now() - s_boot).count();
+    return (TickType_t)(ms / portTICK_PERIOD_MS);
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    std::unique_lock<std::mutex> lk(task->lock);
+    task->notify_count++;
+    task->notified.notify_one();
+    return pdPASS;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks_to_wait)
+{
+    host_task *task = xTaskGetCurrentTaskHandle();
+    std::unique_lock<std::mutex> lk(task->lock);
+    if (!wait_for(task->notified, lk, ticks_to_wait, [task] { return task->notify_count > 0; }))
+        return 0;
+    uint32_t count = task->notify_count;
+    task->notify_count = clear_on_exit ? 0 : count - 1;
+    return count;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size)
+{
+    host_queue *q = new host_queue();
+    q->length = length;
+    q->item_size = item_size;
+    return q;
+}
+
+void vQueueDelete(QueueHandle_t queue)
+{
+    delete queue;
+}
+
+static BaseType_t queue_put(QueueHandle_t q, const void *item, TickType_t ticks, bool front)
+{
+    std::unique_lock<std::mutex> lk(q->lock);
+    if (!wait_for(q->not_full, lk, ticks, [q] { return q->items.size() < q->length; }))
+        return pdFALSE;
+
+    const uint8_t *p = (const uint8_t *)item;
+    std::vector<uint8_t> copy(p, p + q->item_size);
+    if (front)
+        q->items.push_front(std::move(copy));
+    else
+        q->items.push_back(std::move(copy));
+    q->not_empty.notify_one();
+    return pdTRUE;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks_to_wait)
+{
+    return queue_put(queue, item, ticks_to_wait, false);
+}
+
+BaseType_t xQueueSendToFront(QueueHandle_t queue, const void *item, TickType_t ticks_to_wait)
+{
+    return queue_put(queue, item, ticks_to_wait, true);
+}
+
+BaseType_t xQueueOverwrite(QueueHandle_t queue, const void *item)
+{
+    std::unique_lock<std::mutex> lk(queue->lock);
+    const uint8_t *p = (const uint8_t *)item;
+    queue->items.clear();
+    queue->items.emplace_back(p, p + queue->item_size);
+    queue->not_empty.notify_one();
+    return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *buffer, TickType_t ticks_to_wait)
+{
+    std::unique_lock<std::mutex> lk(queue->lock);
+    if (!wait_for(queue->not_empty, lk, ticks_to_wait, [queue] { return !queue->items.empty(); }))
+        return pdFALSE;
+
+    memcpy(buffer, queue->items.front().data(), queue->item_size);
+    queue->items.pop_front();
+    queue->not_full.notify_one();
+    return pdTRUE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue)
+{
+    std::unique_lock<std::mutex> lk(queue->lock);
+    return (UBaseType_t)queue->items.size();
+}
+
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t queue)
+{
+    std::unique_lock<std::mutex> lk(queue->lock);
+    return (UBaseType_t)(queue->length - queue->items.size());
+}
+
+static SemaphoreHandle_t semaphore_create(bool available)
+{
+    host_semaphore *s = new host_semaphore();
+    s->available = available;
+    return s;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    return semaphore_create(true);
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+    return semaphore_create(false);
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t sem)
+{
+    delete sem;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks_to_wait)
+{
+    std::unique_lock<std::mutex> lk(sem->lock);
+    if (!wait_for(sem->cv, lk, ticks_to_wait, [sem] { return sem->available; }))
+        return pdFALSE;
+    sem->available = false;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem)
+{
+    std::unique_lock<std::mutex> lk(sem->lock);
+    sem->available = true;
+    sem->cv.notify_one();
+    return pdTRUE;
+}
+
+} // extern "C"
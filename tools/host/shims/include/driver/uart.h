@@ -0,0 +1,5 @@
+#pragma once
+
+#include "esp_err.h"
+
+typedef int uart_port_t;
@@ -0,0 +1,3 @@
+#pragma once
+
+// Empty: to_jpg.cpp includes it for the ESP32 target but uses nothing from it.
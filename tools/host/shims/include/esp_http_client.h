@@ -0,0 +1,4 @@
+#pragma once
+
+// Not used by the code compiled on the host, included for completeness only.
+#include "esp_err.h"
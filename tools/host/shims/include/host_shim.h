@@ -0,0 +1,25 @@
+#pragma once
+
+// Knobs of the host shims that have no counterpart in ESP-IDF.
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Scale applied to every vTaskDelay(). 1.0 keeps firmware timing,
+ *        0.0 turns the sleeps into yields so the replay runs flat out.
+ */
+void host_set_delay_scale(float scale);
+
+/**
+ * @brief Lowest level printed by ESP_LOGx for tags without an explicit
+ *        esp_log_level_set() entry.
+ */
+void host_set_default_log_level(int level);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,63 @@
+#pragma once
+
+// Host build configuration. Mirrors the options the firmware is built with
+// (examples/human_face_detection/web/sdkconfig) where they matter to the
+// code compiled here.
+#define CONFIG_MFN_V1 1
+#define CONFIG_S8 1
+#define CONFIG_CAMERA_MODULE_AI_THINKER 1
+#define CONFIG_CAMERA_MAX_FRAME_AGE_MS 300
+
+#define CONFIG_WHO_PIPELINE_RING_SLOTS 2
+#if !CONFIG_WHO_DETECT_INPUT_YUV422 && !CONFIG_WHO_DETECT_INPUT_GRAYSCALE
+#define CONFIG_WHO_DETECT_INPUT_RGB565 1
+#endif
+#define CONFIG_WHO_PIPELINE_BATCH_FACES 4
+#define CONFIG_WHO_DETECT_MIN_FACE_SIZE 40
+#define CONFIG_WHO_DETECT_MAX_FACE_SIZE 200
+#define CONFIG_WHO_DETECT_MNP01_TOP_K 4
+#define CONFIG_WHO_DETECT_FLOOR_PERCENT 25
+#define CONFIG_WHO_DETECT_REUSE_PASSES 2
+#define CONFIG_WHO_DETECT_REUSE_IOU_PERCENT 70
+#define CONFIG_WHO_PIPELINE_DETECT_CORE 1
+#define CONFIG_WHO_PIPELINE_RECOGNIZE_CORE 0
+
+#define CONFIG_WHO_SCHED_ACTIVE_PERIOD_MS 0
+#define CONFIG_WHO_SCHED_IDLE_PERIOD_MS 250
+#define CONFIG_WHO_SCHED_IDLE_AFTER_MS 2000
+#define CONFIG_WHO_SCHED_STARVATION_MS 200
+#define CONFIG_WHO_SCHED_BACKOFF_MS 50
+#define CONFIG_WHO_SCHED_BACKOFF_HOLD_MS 2000
+
+#define CONFIG_WHO_PYRAMID_LEVELS 3
+#define CONFIG_WHO_PYRAMID_DETECT 1
+
+#define CONFIG_WHO_MOTION_GATE 1
+#define CONFIG_WHO_MOTION_STRIDE 8
+#define CONFIG_WHO_MOTION_PIXEL_THRESHOLD 5
+#define CONFIG_WHO_MOTION_POINT_THRESHOLD 12
+#define CONFIG_WHO_MOTION_REFRESH_FRAMES 30
+
+#define CONFIG_WHO_ROI_REDETECT 1
+#define CONFIG_WHO_ROI_PADDING_PERCENT 50
+#define CONFIG_WHO_ROI_FULL_FRAME_INTERVAL 10
+#define CONFIG_WHO_ROI_MAX_AREA_PERCENT 50
+
+#define CONFIG_WHO_ALIGN_FIXED_POINT 1
+#define CONFIG_WHO_TRACK_SAMPLES 3
+#define CONFIG_WHO_TRACK_IOU_PERCENT 30
+#define CONFIG_WHO_TRACK_SPLIT_PERCENT 25
+#define CONFIG_WHO_TRACK_REFRESH_DIFF 24
+#define CONFIG_WHO_TRACK_LOST_MS 1000
+#define CONFIG_WHO_TRACK_MAX 8
+
+#define CONFIG_WHO_QUALITY_GATE 1
+#define CONFIG_WHO_QUALITY_MIN_SCORE_PERCENT 40
+#define CONFIG_WHO_QUALITY_MIN_FACE_SIZE 40
+#define CONFIG_WHO_QUALITY_MIN_EYE_DISTANCE 16
+#define CONFIG_WHO_QUALITY_MAX_YAW_PERCENT 35
+#define CONFIG_WHO_QUALITY_MIN_SHARPNESS 40
+
+#define CONFIG_WHO_GALLERY_CAPACITY 64
+#define CONFIG_WHO_GALLERY_TTL_S 3600
+#define CONFIG_WHO_GALLERY_COMPARE_FLOAT 1  // host only, the replay reports int8 vs float
@@ -0,0 +1,3 @@
+#pragma once
+
+// Empty: to_jpg.cpp includes it but uses nothing from it.
@@ -0,0 +1,153 @@
+// Tracker with more faces in a frame than it has tracks.
+//
+//   who_track_test
+//
+// The faces left without a track get ID -1, which is also the ID of a free
+// slot: neither side may count them into a free track or accumulator, and
+// recognition still has to decide each of them, from its one sample.
+
+#include <stdio.h>
+#include <string.h>
+
+#include <vector>
+
+#include "who_face_track.hpp"
+
+#define MAX_TRACKS 2
+#define DIM 8
+#define SAMPLES 3
+#define HEIGHT 120
+#define WIDTH 160
+
+static int s_failures = 0;
+
+#define CHECK(cond)                                                           \
+    do                                                                        \
+    {                                                                         \
+        if (!(cond))                                                          \
+        {                                                                     \
+            fprintf(stderr, "%s:%d: %s failed\n", __FILE__, __LINE__, #cond); \
+            s_failures++;                                                     \
+        }                                                                     \
+    } while (0)
+
+// Four faces side by side, far enough apart for no two to overlap.
+static void frame_faces(who_faces_t *faces, int count)
+{
+    memset(faces, 0, sizeof(*faces));
+    faces->count = count;
+    for (int f = 0; f < count; f++)
+    {
+        int *box = faces->face[f].box;
+        box[0] = 4 + f * 38;
+        box[1] = 30;
+        box[2] = box[0] + 32;
+        box[3] = box[1] + 40;
+    }
+}
+
+// A unit embedding per face, orthogonal to the others.
+static void embedding(int face, float *out)
+{
+    for (int i = 0; i < DIM; i++)
+        out[i] = i == face ? 2.0f : 0.0f;
+}
+
+int main()
+{
+    std::vector<uint16_t> frame((size_t)HEIGHT * WIDTH, 0x1234);
+    CHECK(who_track_init(MAX_TRACKS, DIM, SAMPLES, 30, 50, 0, 1000000));
+
+    who_faces_t faces;
+    frame_faces(&faces, 4);
+    int ids[WHO_DETECT_MAX_FACES];
+    int64_t now = 0;
+    for (int round = 0; round < SAMPLES; round++, now += 33000)
+    {
+        who_track_assign(&faces, now, ids);
+        CHECK(ids[0] >= 0 && ids[1] >= 0 && ids[0] != ids[1]);
+        CHECK(ids[2] == -1 && ids[3] == -1);
+
+        // Untracked faces are always wanted and never counted.
+        for (int f = 0; f < faces.count; f++)
+        {
+            int id = ids[f];
+            CHECK(who_track_wants_face(&id, frame.data(), HEIGHT, WIDTH, faces.face[f]));
+            CHECK(id == ids[f]);
+            who_track_mark_published(id, frame.data(), HEIGHT, WIDTH, faces.face[f]);
+        }
+    }
+
+    // One embedding each: the untracked faces are decided at once, each with
+    // its own embedding, the tracks wait for the rest of their samples.
+    float emb[DIM];
+    for (int f = 0; f < faces.count; f++)
+    {
+        CHECK(who_track_wants_sample(ids[f], now));
+        embedding(f, emb);
+        who_track_add_sample(ids[f], emb, 1.0f, now);
+    }
+    CHECK(who_track_pending());
+
+    who_track_decision_t decision;
+    bool seen[4] = {};
+    int decided = 0;
+    while (who_track_next_decision(now, &decision))
+    {
+        CHECK(decision.track_id == -1);
+        CHECK(decision.samples == 1 && decision.ended);
+        int face = -1;
+        for (int i = 0; i < DIM; i++)
+        {
+            if (decision.embedding[i] > 0.99f && decision.embedding[i] < 1.01f)
+                face = i;
+        }
+        CHECK(face == 2 || face == 3);
+        if (face >= 0)
+            seen[face] = true;
+        decided++;
+    }
+    CHECK(decided == 2 && seen[2] && seen[3]);
+
+    // The tracks, untouched by them, take the rest of their samples.
+    CHECK(who_track_pending());
+    for (int f = 0; f < 2; f++)
+    {
+        embedding(f, emb);
+        who_track_add_sample(ids[f], emb, 1.0f, now);
+        who_track_add_sample(ids[f], emb, 1.0f, now);
+    }
+    decided = 0;
+    while (who_track_next_decision(now, &decision))
+    {
+        CHECK(decision.track_id == ids[0] || decision.track_id == ids[1]);
+        CHECK(decision.samples == SAMPLES && !decision.ended);
+        decided++;
+    }
+    CHECK(decided == 2);
+    CHECK(!who_track_pending());
+
+    // The tracks were handed all their faces, the untracked faces are
+    // still wanted.
+    who_track_assign(&faces, now, ids);
+    int id = ids[0];
+    CHECK(!who_track_wants_face(&id, frame.data(), HEIGHT, WIDTH, faces.face[0]));
+    id = ids[2];
+    CHECK(who_track_wants_face(&id, frame.data(), HEIGHT, WIDTH, faces.face[2]));
+
+    who_track_detect_stats_t track;
+    who_track_get_detect_stats(&track);
+    CHECK(track.tracks == 2);
+    who_track_sample_stats_t samples;
+    who_track_get_sample_stats(&samples);
+    CHECK(samples.untracked == 2);
+    CHECK(samples.samples == 8);
+
+    if (s_failures)
+    {
+        fprintf(stderr, "%d checks failed\n", s_failures);
+        return 1;
+    }
+    printf("ok\n");
+    return 0;
+}